@@ -28,8 +28,10 @@
 #include "p_local.h"
 #include "w_wad.h"
 
+#include "m_bbox.h"
 #include "m_cheat.h"
 #include "m_controls.h"
+#include "m_linegrid.h"
 #include "m_misc.h"
 #include "i_system.h"
 #include "i_timer.h"
@@ -107,6 +109,9 @@
 #define CXMTOF(x)  (f_x + MTOF((x)-m_x))
 #define CYMTOF(y)  (f_y + (f_h - MTOF((y)-m_y)))
 
+// things further than this outside the window can't be seen
+#define THINGMARGIN	(32*FRACUNIT)
+
 // the following is crap
 #define LINE_NEVERSEE ML_DONTDRAW
 
@@ -513,6 +518,18 @@ void AM_clearMarks(void)
     markpointnum = 0;
 }
 
+//
+// Bounding box of a line, for the automap line grid.
+//
+static boolean AM_lineBox(int i, fixed_t *box)
+{
+    box[BOXTOP] = lines[i].bbox[BOXTOP];
+    box[BOXBOTTOM] = lines[i].bbox[BOXBOTTOM];
+    box[BOXLEFT] = lines[i].bbox[BOXLEFT];
+    box[BOXRIGHT] = lines[i].bbox[BOXRIGHT];
+    return true;
+}
+
 //
 // should be called at the start of every level
 // right now, i figure it out myself
@@ -534,6 +551,16 @@ void AM_LevelInit(void)
     scale_ftom = FixedDiv(FRACUNIT, scale_mtof);
 }
 
+//
+// Index the lines, so that only those near the window are drawn.
+// Called by P_SetupLevel, since the automap can be left up while
+// another level loads.
+//
+void AM_InitLineGrid(void)
+{
+    M_BuildLineGrid(numlines, AM_lineBox);
+}
+
 
 
 
@@ -1146,10 +1173,21 @@ void AM_drawGrid(int color)
 void AM_drawWalls(void)
 {
     int i;
+    int n, count;
+    const int *visible;
+    fixed_t box[4];
     static mline_t l;
 
-    for (i=0;i<numlines;i++)
+    // Only lines that can touch the window need to be clipped.
+    box[BOXTOP] = m_y2;
+    box[BOXBOTTOM] = m_y;
+    box[BOXLEFT] = m_x;
+    box[BOXRIGHT] = m_x2;
+    count = M_FindGridLines(numlines, box, &visible);
+
+    for (n=0;n<count;n++)
     {
+	i = visible[n];
 	l.a.x = lines[i].v1->x;
 	l.a.y = lines[i].v1->y;
 	l.b.x = lines[i].v2->x;
@@ -1323,6 +1361,15 @@ AM_drawThings
 	t = sectors[i].thinglist;
 	while (t)
 	{
+	    // Skip things too far outside the window for any part of
+	    // their triangles to show.
+	    if (t->x < m_x - THINGMARGIN || t->x > m_x2 + THINGMARGIN
+	     || t->y < m_y - THINGMARGIN || t->y > m_y2 + THINGMARGIN)
+	    {
+		t = t->snext;
+		continue;
+	    }
+
 	    AM_drawLineCharacter
 		(thintriangle_guy, arrlen(thintriangle_guy),
 		 16<<FRACBITS, t->angle, colors+lightlev, t->x, t->y);
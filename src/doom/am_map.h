@@ -42,6 +42,9 @@ void AM_Drawer (void);
 // if the level is completed while it is up.
 void AM_Stop (void);
 
+// Called by P_SetupLevel once the lines are loaded.
+void AM_InitLineGrid (void);
+
 
 extern cheatseq_t cheat_amap;
 
@@ -71,7 +71,11 @@
 
 #include "p_setup.h"
 #include "r_local.h"
+#include "r_bench.h"
+#include "r_stats.h"
+#include "r_thread.h"
 #include "statdump.h"
+#include "framehash.h"
 
 
 #include "d_main.h"
@@ -165,6 +169,84 @@ gamestate_t     wipegamestate = GS_DEMOSCREEN;
 extern  boolean setsizeneeded;
 extern  int             showMessages;
 void R_ExecuteSetViewSize (void);
+extern  boolean timingdemo;
+
+// With -detailgovernor, the time the 3D view may take,
+//  in microseconds, before dropping to low detail.
+static uint64_t		detailbudget = 0;
+
+// True while the governor has the view in low detail.
+static boolean		detaillowered = false;
+
+// Frames in a row over the budget, or with room to spare.
+static int		detailstreak = 0;
+
+#define SLOWDETAILFRAMES	5
+#define FASTDETAILFRAMES	TICRATE
+
+//
+// D_GovernDetail
+// Drops the view to low detail when it is taking too long to
+//  draw, and puts it back once it is drawing in well under half
+//  the budget.  Only the view is changed: detailLevel, as shown
+//  in the menu and saved, is left alone.
+//
+static void D_GovernDetail (uint64_t viewtime)
+{
+    // Timed demos are left as set, so they can be compared.
+    if (detailLevel != 0 || timingdemo)
+    {
+	detaillowered = false;
+	detailstreak = 0;
+	return;
+    }
+
+    // Wait for any change to the view size to be made.
+    if (setsizeneeded)
+	return;
+
+    // Put back to high detail by changing the screen size.
+    if (detaillowered && !detailshift)
+    {
+	detaillowered = false;
+	detailstreak = 0;
+    }
+
+    if (!detaillowered)
+    {
+	if (viewtime > detailbudget)
+	    detailstreak++;
+	else
+	    detailstreak = 0;
+
+	if (detailstreak >= SLOWDETAILFRAMES)
+	{
+	    printf ("D_GovernDetail: %i frames over %.1f ms, "
+		    "switching to low detail\n",
+		    detailstreak, detailbudget / 1000.0);
+	    R_SetViewSize (screenblocks, 1);
+	    detaillowered = true;
+	    detailstreak = 0;
+	}
+    }
+    else
+    {
+	if (viewtime < detailbudget / 2)
+	    detailstreak++;
+	else
+	    detailstreak = 0;
+
+	if (detailstreak >= FASTDETAILFRAMES)
+	{
+	    printf ("D_GovernDetail: %i frames under %.1f ms, "
+		    "switching back to high detail\n",
+		    detailstreak, detailbudget / 2000.0);
+	    R_SetViewSize (screenblocks, detailLevel);
+	    detaillowered = false;
+	    detailstreak = 0;
+	}
+    }
+}
 
 boolean D_Display (void)
 {
@@ -177,6 +259,7 @@ boolean D_Display (void)
     int				y;
     boolean			wipe;
     boolean			redrawsbar;
+    uint64_t			starttime;
 		
     redrawsbar = false;
     
@@ -234,10 +317,24 @@ boolean D_Display (void)
     
     // draw the view directly
     if (gamestate == GS_LEVEL && !automapactive && gametic)
-	R_RenderPlayerView (&players[displayplayer]);
+    {
+	if (detailbudget)
+	{
+	    starttime = I_GetTimeUS ();
+	    R_RenderPlayerView (&players[displayplayer]);
+	    D_GovernDetail (I_GetTimeUS () - starttime);
+	}
+	else
+	    R_RenderPlayerView (&players[displayplayer]);
+    }
+    else
+	R_DropPipelinedView ();
 
     if (gamestate == GS_LEVEL && gametic)
 	HU_Drawer ();
+
+    if (gamestate == GS_LEVEL && !automapactive && gametic)
+	R_DrawStatsOverlay ();
     
     // clean up border stuff
     if (gamestate != oldgamestate && gamestate != GS_LEVEL)
@@ -427,7 +524,10 @@ void D_RunFrame()
     // Update display, next frame, with current state if no profiling is on
     if (screenvisible && !nodrawers)
     {
-        if ((wipe = D_Display ()))
+        wipe = D_Display ();
+        FrameHashUpdate ();
+
+        if (wipe)
         {
             // start wipe on this frame
             wipe_EndScreen(0, 0, SCREENWIDTH, SCREENHEIGHT);
@@ -1881,6 +1981,8 @@ void D_DoomMain (void)
         DEH_printf("External statistics registered.\n");
     }
 
+    FrameHashInit();
+
     //!
     // @arg <x>
     // @category demo
@@ -1897,6 +1999,39 @@ void D_DoomMain (void)
 	autostart = true;
     }
 
+    //!
+    // @arg <ms>
+    // @category video
+    //
+    // Drop to low detail when the 3D view takes longer than ms
+    // milliseconds to draw for several frames in a row, and go back
+    // to high detail once it takes well under half that.  Every
+    // switch is printed.  Not used with -timedemo.
+    //
+
+    p = M_CheckParmWithArgs("-detailgovernor", 1);
+    if (p)
+    {
+	detailbudget = (uint64_t) (atof(myargv[p+1]) * 1000);
+    }
+
+    //!
+    // @arg <file>
+    // @category video
+    //
+    // Time the 3D view from each of the viewpoints listed in file,
+    // one per line as map, x, y, z and angle in degrees, with the
+    // game standing still, and print the fastest, median and 99th
+    // percentile frame times for each. With -renderstats, the
+    // counters for each view are printed too.
+    //
+
+    p = M_CheckParmWithArgs("-renderbench", 1);
+    if (p)
+    {
+	R_RenderBench (myargv[p+1]);  // never returns
+    }
+
     p = M_CheckParmWithArgs("-playdemo", 1);
     if (p)
     {
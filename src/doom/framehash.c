@@ -0,0 +1,228 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Hashes of each frame of a demo, for checking that changes to
+//     the renderer don't change what is drawn.
+//
+//     During demo playback, the screen is hashed with XXH64 once each
+//     tic, just after D_Display has drawn it, and written out as a line
+//     of the tic number and the hash. Comparing plays the demo against
+//     such a file and reports the frames that differ, saving a
+//     screenshot of the first one. With -timedemo, every tic is drawn, so every
+//     tic is checked; with -playdemo, only those that happen to be.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "doomstat.h"
+#include "deh_str.h"
+#include "i_system.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "v_video.h"
+#include "w_wad.h"
+#include "xxhash.h"
+#include "z_zone.h"
+
+#include "framehash.h"
+
+static FILE *hash_file = NULL;
+static boolean comparing = false;
+static const char *hash_filename;
+
+// Last tic hashed, so that only the first frame of each is.
+
+static int last_tic = -1;
+
+// Next line of the file being compared against.
+
+static boolean have_expected = false;
+static int expected_tic;
+static uint64_t expected_hash;
+
+static int frames_checked = 0;
+static int frames_differing = 0;
+static int first_differing_tic = -1;
+
+static void ReadExpected(void)
+{
+    char line[64];
+
+    have_expected = false;
+
+    while (fgets(line, sizeof(line), hash_file) != NULL)
+    {
+        if (sscanf(line, "%i %" SCNx64, &expected_tic, &expected_hash) == 2)
+        {
+            have_expected = true;
+            return;
+        }
+    }
+}
+
+static void SaveDifferingFrame(int tic)
+{
+    char filename[32];
+
+#ifdef HAVE_LIBPNG
+    M_snprintf(filename, sizeof(filename), "frame%06i.png", tic);
+    WritePNGfile(filename, I_VideoBuffer, SCREENWIDTH, SCREENHEIGHT,
+                 W_CacheLumpName(DEH_String("PLAYPAL"), PU_CACHE));
+#else
+    M_snprintf(filename, sizeof(filename), "frame%06i.pcx", tic);
+    WritePCXfile(filename, I_VideoBuffer, SCREENWIDTH, SCREENHEIGHT,
+                 W_CacheLumpName(DEH_String("PLAYPAL"), PU_CACHE));
+#endif
+
+    printf("FrameHash: frame at tic %i saved as %s\n", tic, filename);
+}
+
+static void CompareFrame(int tic, uint64_t hash)
+{
+    while (have_expected && expected_tic < tic)
+    {
+        ReadExpected();
+    }
+
+    if (!have_expected || expected_tic != tic)
+    {
+        return;
+    }
+
+    ++frames_checked;
+
+    if (hash != expected_hash)
+    {
+        ++frames_differing;
+
+        if (first_differing_tic < 0)
+        {
+            first_differing_tic = tic;
+            printf("FrameHash: frame at tic %i differs from %s: "
+                   "%016" PRIx64 ", expected %016" PRIx64 "\n",
+                   tic, hash_filename, hash, expected_hash);
+            SaveDifferingFrame(tic);
+        }
+    }
+}
+
+static void FrameHashShutdown(void)
+{
+    if (hash_file == NULL)
+    {
+        return;
+    }
+
+    fclose(hash_file);
+    hash_file = NULL;
+
+    if (comparing)
+    {
+        if (frames_differing > 0)
+        {
+            printf("FrameHash: %i of %i frames differ from %s, "
+                   "the first at tic %i\n",
+                   frames_differing, frames_checked, hash_filename,
+                   first_differing_tic);
+        }
+        else
+        {
+            printf("FrameHash: all %i frames match %s\n",
+                   frames_checked, hash_filename);
+        }
+    }
+}
+
+void FrameHashInit(void)
+{
+    int p;
+
+    //!
+    // @category demo
+    // @arg <file>
+    //
+    // While playing back a demo, write a hash of the screen for each
+    // tic drawn to the specified file, one line per tic. Use with
+    // -timedemo to include every tic.
+    //
+
+    p = M_CheckParmWithArgs("-framehashes", 1);
+
+    if (p > 0)
+    {
+        hash_filename = myargv[p + 1];
+        hash_file = fopen(hash_filename, "w");
+
+        if (hash_file == NULL)
+        {
+            I_Error("FrameHashInit: Unable to open %s", hash_filename);
+        }
+
+        I_AtExit(FrameHashShutdown, true);
+        return;
+    }
+
+    //!
+    // @category demo
+    // @arg <file>
+    //
+    // While playing back a demo, compare the screen for each tic
+    // drawn against the hashes in the specified file, written by
+    // -framehashes. The first frame that differs is saved as a
+    // screenshot, and the number that differ is printed on exit.
+    //
+
+    p = M_CheckParmWithArgs("-comparehashes", 1);
+
+    if (p > 0)
+    {
+        hash_filename = myargv[p + 1];
+        hash_file = fopen(hash_filename, "r");
+
+        if (hash_file == NULL)
+        {
+            I_Error("FrameHashInit: Unable to open %s", hash_filename);
+        }
+
+        comparing = true;
+        ReadExpected();
+        I_AtExit(FrameHashShutdown, true);
+    }
+}
+
+void FrameHashUpdate(void)
+{
+    uint64_t hash;
+
+    if (hash_file == NULL || !demoplayback || gametic == last_tic)
+    {
+        return;
+    }
+
+    last_tic = gametic;
+    hash = XXH64(I_VideoBuffer,
+                 SCREENWIDTH * SCREENHEIGHT * sizeof(*I_VideoBuffer), 0);
+
+    if (comparing)
+    {
+        CompareFrame(gametic, hash);
+    }
+    else
+    {
+        fprintf(hash_file, "%i %016" PRIx64 "\n", gametic, hash);
+    }
+}
@@ -0,0 +1,30 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Hashes of each frame of a demo, for checking that changes to
+//     the renderer don't change what is drawn.
+//
+
+#ifndef DOOM_FRAMEHASH_H
+#define DOOM_FRAMEHASH_H
+
+// Called by D_DoomMain, to handle -framehashes and -comparehashes.
+
+void FrameHashInit(void);
+
+// Called by D_RunFrame after each call to D_Display.
+
+void FrameHashUpdate(void);
+
+#endif /* #ifndef DOOM_FRAMEHASH_H */
@@ -655,6 +655,7 @@ void G_DoLoadLevel (void)
     } 
 		 
     P_SetupLevel (gameepisode, gamemap, 0, gameskill);    
+    R_StartPrecache ();
     displayplayer = consoleplayer;		// view the guy you are playing    
     gameaction = ga_nothing; 
     Z_CheckHeap ();
@@ -2270,6 +2271,8 @@ void G_TimeDemo (char* name)
     timingdemo = true; 
     singletics = true; 
 
+    R_StartViewTiming ();
+
     defdemoname = name; 
     gameaction = ga_playdemo; 
 } 
@@ -2302,6 +2305,8 @@ boolean G_CheckDemoStatus (void)
         timingdemo = false;
         demoplayback = false;
 
+        R_PrintViewTiming ();
+
 	I_Error ("timed %i gametics in %i realtics (%f fps)",
                  gametic, realtics, fps);
     } 
@@ -40,6 +40,10 @@
 
 #include "doomstat.h"
 
+#include "am_map.h"
+#include "r_bsp.h"
+#include "r_pvs.h"
+
 
 void	P_SpawnMapThing (mapthing_t*	mthing);
 
@@ -862,6 +866,13 @@ P_SetupLevel
     // build subsector connect matrix
     //	UNUSED P_ConnectSubsectors ();
 
+    // lay out the nodes and segs for the renderer, and
+    //  find what can be seen from where, with -pvs
+    R_SetupBSP ();
+    R_SetupPVS (lumpnum);
+
+    AM_InitLineGrid ();
+
     // preload graphics
     if (precache)
 	R_PrecacheLevel ();
@@ -0,0 +1,298 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Timing the renderer from fixed viewpoints, with -renderbench.
+//
+//	-timedemo times the playsim, the renderer and the rest of
+//	D_Display together.  Here, each viewpoint's map is loaded and
+//	the player put in place, then the game is left standing while
+//	R_RenderPlayerView draws the same view over and over, so only
+//	the renderer is timed.
+//
+//	The file lists one viewpoint per line:
+//
+//	    map  x  y  z  angle
+//
+//	as E1M1 or MAP01, then the position of the eye in map units
+//	and the direction faced in degrees, anticlockwise from east.
+//	Blank lines and lines starting with # are skipped.
+//
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "d_loop.h"
+
+#include "deh_str.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "v_video.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+#include "g_game.h"
+#include "p_local.h"
+
+#include "r_local.h"
+#include "r_bench.h"
+#include "r_stats.h"
+#include "r_thread.h"
+
+// Frames drawn, and not timed, before the timed ones,
+//  to get the level's graphics cached.
+#define WARMUPFRAMES	8
+
+#define DEFAULTFRAMES	200
+
+void R_ExecuteSetViewSize (void);
+
+
+static int CompareTimes (const void *a, const void *b)
+{
+    uint64_t	ta = *(const uint64_t *) a;
+    uint64_t	tb = *(const uint64_t *) b;
+
+    return ta < tb ? -1 : ta > tb;
+}
+
+
+//
+// R_ParseBenchMap
+// Sets episode and map from a lump name,
+//  or returns false if it isn't one of this game's maps.
+//
+static boolean R_ParseBenchMap (const char *name, int *episode, int *map)
+{
+    char	lumpname[9];
+
+    if (gamemode == commercial)
+    {
+	*episode = 1;
+
+	if (sscanf (name, "MAP%2d", map) != 1)
+	    return false;
+
+	DEH_snprintf (lumpname, sizeof(lumpname), "MAP%02d", *map);
+    }
+    else
+    {
+	if (sscanf (name, "E%1dM%1d", episode, map) != 2)
+	    return false;
+
+	DEH_snprintf (lumpname, sizeof(lumpname), "E%dM%d", *episode, *map);
+    }
+
+    return W_CheckNumForName (lumpname) >= 0;
+}
+
+
+//
+// R_PlaceBenchView
+// Puts the player at a viewpoint, without running the playsim.
+//
+static void R_PlaceBenchView (int x, int y, int z, int angle)
+{
+    player_t*	player;
+    mobj_t*	mo;
+
+    player = &players[consoleplayer];
+    mo = player->mo;
+
+    angle %= 360;
+
+    if (angle < 0)
+	angle += 360;
+
+    P_UnsetThingPosition (mo);
+    mo->x = x << FRACBITS;
+    mo->y = y << FRACBITS;
+    P_SetThingPosition (mo);
+
+    mo->angle = (angle_t) (((uint64_t) angle << 32) / 360);
+    player->viewz = z << FRACBITS;
+}
+
+
+//
+// R_PrintBenchStats
+// The counters for the last frame drawn, as shown by -renderstats.
+//
+static void R_PrintBenchStats (void)
+{
+    printf ("    nodes %i  rejects %i  culled %i  segs %i  drawsegs %i\n"
+	    "    planes %i  sprites %i  columns %i  spans %i  pixels %i\n",
+	    framestats.nodes, framestats.bboxrejects,
+	    framestats.nodesculled, framestats.segs, framestats.drawsegs,
+	    framestats.visplanes, framestats.vissprites,
+	    framestats.columns, framestats.spans, framestats.pixels);
+}
+
+
+//
+// R_RenderBench
+//
+void R_RenderBench (const char *filename)
+{
+    FILE*	file;
+    char	line[256];
+    char	mapname[16];
+    uint64_t*	times;
+    uint64_t	starttime;
+    double	p99;
+    double	worstp99;
+    int		worstline;
+    int		numframes;
+    int		numviews;
+    int		linenum;
+    int		episode;
+    int		map;
+    int		x;
+    int		y;
+    int		z;
+    int		angle;
+    int		i;
+    int		p;
+
+    if (netgame)
+	I_Error ("R_RenderBench: Can't be used in a network game");
+
+    file = fopen (filename, "r");
+
+    if (file == NULL)
+	I_Error ("R_RenderBench: Unable to open %s", filename);
+
+    numframes = DEFAULTFRAMES;
+
+    //!
+    // @arg <n>
+    // @category video
+    //
+    // With -renderbench, the number of frames to time at each
+    // viewpoint. The default is 200.
+    //
+
+    p = M_CheckParmWithArgs ("-renderbenchframes", 1);
+
+    if (p)
+    {
+	numframes = atoi (myargv[p + 1]);
+
+	if (numframes < 1)
+	    I_Error ("R_RenderBench: Invalid frame count %s", myargv[p + 1]);
+    }
+
+    times = Z_Malloc (numframes * sizeof(*times), PU_STATIC, NULL);
+
+    // Set up the screen as D_DoomLoop does.
+    I_SetWindowTitle (gamedescription);
+    I_GraphicsCheckCommandLine ();
+    I_InitGraphics ();
+    I_SetPalette (W_CacheLumpName (DEH_String ("PLAYPAL"), PU_CACHE));
+    V_RestoreBuffer ();
+    R_ExecuteSetViewSize ();
+
+    printf ("R_RenderBench: %i frames per view, times in ms\n", numframes);
+
+    numviews = 0;
+    linenum = 0;
+    worstline = 0;
+    worstp99 = 0;
+
+    while (fgets (line, sizeof(line), file) != NULL)
+    {
+	linenum++;
+
+	for (i=0 ; isspace ((unsigned char) line[i]) ; i++)
+	    ;
+
+	if (line[i] == '\0' || line[i] == '#')
+	    continue;
+
+	if (sscanf (line + i, "%15s %d %d %d %d",
+		    mapname, &x, &y, &z, &angle) != 5)
+	{
+	    I_Error ("R_RenderBench: %s line %i: expected "
+		     "map, x, y, z and angle", filename, linenum);
+	}
+
+	M_ForceUppercase (mapname);
+
+	if (!R_ParseBenchMap (mapname, &episode, &map))
+	{
+	    I_Error ("R_RenderBench: %s line %i: no map %s",
+		     filename, linenum, mapname);
+	}
+
+	// Only load the map when it changes.
+	if (gamestate != GS_LEVEL || episode != gameepisode || map != gamemap)
+	    G_InitNew (startskill, episode, map);
+
+	R_PlaceBenchView (x, y, z, angle);
+
+	for (i=0 ; i<WARMUPFRAMES ; i++)
+	    R_RenderPlayerView (&players[consoleplayer]);
+
+	for (i=0 ; i<numframes ; i++)
+	{
+	    starttime = I_GetTimeUS ();
+	    R_RenderPlayerView (&players[consoleplayer]);
+	    times[i] = I_GetTimeUS () - starttime;
+	}
+
+	// Show the view that was timed.
+	if (renderpipeline)
+	    R_FinishPipelinedView ();
+
+	I_FinishUpdate ();
+
+	qsort (times, numframes, sizeof(*times), CompareTimes);
+
+	p99 = times[(numframes * 99) / 100] / 1000.0;
+
+	printf ("%s line %i: %s %i %i %i %i: "
+		"min %.3f  median %.3f  p99 %.3f\n",
+		filename, linenum, mapname, x, y, z, angle,
+		times[0] / 1000.0, times[numframes / 2] / 1000.0, p99);
+
+	if (renderstats)
+	    R_PrintBenchStats ();
+
+	if (numviews == 0 || p99 > worstp99)
+	{
+	    worstp99 = p99;
+	    worstline = linenum;
+	}
+
+	numviews++;
+    }
+
+    fclose (file);
+    Z_Free (times);
+
+    if (numviews > 0)
+    {
+	printf ("R_RenderBench: %i views, slowest p99 %.3f ms at line %i\n",
+		numviews, worstp99, worstline);
+    }
+
+    I_Quit ();
+}
@@ -0,0 +1,28 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Timing the renderer from fixed viewpoints, with -renderbench.
+//
+
+
+#ifndef __R_BENCH__
+#define __R_BENCH__
+
+#include "doomtype.h"
+
+// Called by D_DoomMain in place of the game loop.
+//  Times the views listed in the file, then quits.
+void R_RenderBench (const char *filename) NORETURN;
+
+#endif
@@ -19,15 +19,21 @@
 
 
 
+#include <string.h>
+
 #include "doomdef.h"
 
 #include "m_bbox.h"
 
 #include "i_system.h"
+#include "z_zone.h"
 
 #include "r_main.h"
 #include "r_plane.h"
 #include "r_things.h"
+#include "r_stats.h"
+#include "r_pvs.h"
+#include "r_limits.h"
 
 // State.
 #include "doomstat.h"
@@ -43,8 +49,35 @@ line_t*		linedef;
 sector_t*	frontsector;
 sector_t*	backsector;
 
-drawseg_t	drawsegs[MAXDRAWSEGS];
+// With -growlimits, drawsegs can be moved to a bigger copy.
+static drawseg_t	fixeddrawsegs[MAXDRAWSEGS];
+drawseg_t*	drawsegs = fixeddrawsegs;
 drawseg_t*	ds_p;
+int		numdrawsegs = MAXDRAWSEGS;
+
+// How many drawsegs this frame may use.
+static int	maxdrawsegs;
+
+//
+// Copies of the nodes and segs, laid out so that the walk
+//  reads only what it needs, from consecutive memory.
+//  Set up by R_SetupBSP.  The playsim uses nodes and segs.
+//
+
+// Partition line of each node: x, y, dx, dy.
+static fixed_t*		bsppartitions;
+
+// Front then back child of each node.
+static int*		bspchildren;
+
+// Front then back bounding box of each node.
+static fixed_t*		bspboxes;
+
+// v1 x and y, then v2 x and y, of each seg.
+static fixed_t*		segcoords;
+
+// Back sides still to be walked, as node*2 + side.
+static int*		bspstack;
 
 
 void
@@ -61,6 +94,36 @@ R_StoreWallRange
 void R_ClearDrawSegs (void)
 {
     ds_p = drawsegs;
+    maxdrawsegs = growlimits ? numdrawsegs : MAXDRAWSEGS;
+}
+
+
+//
+// R_CheckDrawSegs
+// True if there is room for another drawseg,
+//  doubling them first if need be with -growlimits.
+//
+boolean R_CheckDrawSegs (void)
+{
+    drawseg_t*	newdrawsegs;
+    int		count;
+
+    count = ds_p - drawsegs;
+
+    if (count < maxdrawsegs)
+	return true;
+
+    if (!growlimits)
+	return false;
+
+    newdrawsegs = R_GrowPool (drawsegs, &numdrawsegs, sizeof(*newdrawsegs));
+    R_FreePool (drawsegs, fixeddrawsegs);
+
+    drawsegs = newdrawsegs;
+    ds_p = drawsegs + count;
+    maxdrawsegs = numdrawsegs;
+
+    return true;
 }
 
 
@@ -90,6 +153,65 @@ typedef	struct
 cliprange_t*	newend;
 cliprange_t	solidsegs[MAXSEGS];
 
+// The same as solidsegs, one bit for each column of the view,
+//  set once a solid wall covers it; and how many are still clear.
+static unsigned int	solidcolumns[(SCREENWIDTH + 31) / 32];
+static int		opencolumns;
+
+
+//
+// R_ColumnsSolid
+// True if every column from first to last is covered.
+//
+static boolean R_ColumnsSolid (int first, int last)
+{
+    unsigned int	mask;
+    int			i;
+
+    for (i = first >> 5 ; i <= last >> 5 ; i++)
+    {
+	mask = ~0u;
+
+	if (i == first >> 5)
+	    mask &= ~0u << (first & 31);
+	if (i == last >> 5)
+	    mask &= ~0u >> (31 - (last & 31));
+
+	if ((solidcolumns[i] & mask) != mask)
+	    return false;
+    }
+
+    return true;
+}
+
+
+//
+// R_StoreSolidRange
+// Draws columns first to last, none of them covered yet,
+//  and marks them as covered.
+//
+static void R_StoreSolidRange (int first, int last)
+{
+    unsigned int	mask;
+    int			i;
+
+    R_StoreWallRange (first, last);
+
+    for (i = first >> 5 ; i <= last >> 5 ; i++)
+    {
+	mask = ~0u;
+
+	if (i == first >> 5)
+	    mask &= ~0u << (first & 31);
+	if (i == last >> 5)
+	    mask &= ~0u >> (31 - (last & 31));
+
+	solidcolumns[i] |= mask;
+    }
+
+    opencolumns -= last - first + 1;
+}
+
 
 
 
@@ -107,6 +229,10 @@ R_ClipSolidWallSegment
     cliprange_t*	next;
     cliprange_t*	start;
 
+    // Already covered?
+    if (R_ColumnsSolid (first, last))
+	return;
+
     // Find the first range that touches the range
     //  (adjacent pixels are touching).
     start = solidsegs;
@@ -119,7 +245,7 @@ R_ClipSolidWallSegment
 	{
 	    // Post is entirely visible (above start),
 	    //  so insert a new clippost.
-	    R_StoreWallRange (first, last);
+	    R_StoreSolidRange (first, last);
 	    next = newend;
 	    newend++;
 	    
@@ -134,7 +260,7 @@ R_ClipSolidWallSegment
 	}
 		
 	// There is a fragment above *start.
-	R_StoreWallRange (first, start->first - 1);
+	R_StoreSolidRange (first, start->first - 1);
 	// Now adjust the clip size.
 	start->first = first;	
     }
@@ -147,7 +273,7 @@ R_ClipSolidWallSegment
     while (last >= (next+1)->first-1)
     {
 	// There is a fragment between two posts.
-	R_StoreWallRange (next->last + 1, (next+1)->first - 1);
+	R_StoreSolidRange (next->last + 1, (next+1)->first - 1);
 	next++;
 	
 	if (last <= next->last)
@@ -160,7 +286,7 @@ R_ClipSolidWallSegment
     }
 	
     // There is a fragment after *next.
-    R_StoreWallRange (next->last + 1, last);
+    R_StoreSolidRange (next->last + 1, last);
     // Adjust the clip size.
     start->last = last;
 	
@@ -199,6 +325,10 @@ R_ClipPassWallSegment
 {
     cliprange_t*	start;
 
+    // Already covered?
+    if (R_ColumnsSolid (first, last))
+	return;
+
     // Find the first range that touches the range
     //  (adjacent pixels are touching).
     start = solidsegs;
@@ -248,6 +378,9 @@ void R_ClearClipSegs (void)
     solidsegs[1].first = viewwidth;
     solidsegs[1].last = 0x7fffffff;
     newend = solidsegs+2;
+
+    memset (solidcolumns, 0, sizeof(solidcolumns));
+    opencolumns = viewwidth;
 }
 
 //
@@ -255,7 +388,7 @@ void R_ClearClipSegs (void)
 // Clips the given segment
 // and adds any visible pieces to the line list.
 //
-void R_AddLine (seg_t*	line)
+void R_AddLine (int num)
 {
     int			x1;
     int			x2;
@@ -263,12 +396,20 @@ void R_AddLine (seg_t*	line)
     angle_t		angle2;
     angle_t		span;
     angle_t		tspan;
+    seg_t*		line;
+    fixed_t*		coords;
     
-    curline = line;
+    curline = line = &segs[num];
+    coords = segcoords + num*4;
+    framestats.segs++;
+
+    // Nothing more can be seen.
+    if (!opencolumns)
+	return;
 
     // OPTIMIZE: quickly reject orthogonal back sides.
-    angle1 = R_PointToAngle (line->v1->x, line->v1->y);
-    angle2 = R_PointToAngle (line->v2->x, line->v2->y);
+    angle1 = R_PointToAngle (coords[0], coords[1]);
+    angle2 = R_PointToAngle (coords[2], coords[3]);
     
     // Clip to view edges.
     // OPTIMIZE: make constant out of 2*clipangle (FIELDOFVIEW).
@@ -393,8 +534,6 @@ boolean R_CheckBBox (fixed_t*	bspcoord)
     angle_t		span;
     angle_t		tspan;
     
-    cliprange_t*	start;
-
     int			sx1;
     int			sx2;
     
@@ -432,6 +571,11 @@ boolean R_CheckBBox (fixed_t*	bspcoord)
     // Sitting on a line?
     if (span >= ANG180)
 	return true;
+
+    // Nothing more can be seen.  Boxes the view is inside or
+    //  sitting on an edge of are still let through, as above.
+    if (!opencolumns)
+	return false;
     
     tspan = angle1 + clipangle;
 
@@ -470,19 +614,9 @@ boolean R_CheckBBox (fixed_t*	bspcoord)
     if (sx1 == sx2)
 	return false;			
     sx2--;
-	
-    start = solidsegs;
-    while (start->last < sx2)
-	start++;
-    
-    if (sx1 >= start->first
-	&& sx2 <= start->last)
-    {
-	// The clippost contains the new span.
-	return false;
-    }
 
-    return true;
+    // Is there an open column in the span?
+    return !R_ColumnsSolid (sx1, sx2);
 }
 
 
@@ -496,7 +630,7 @@ boolean R_CheckBBox (fixed_t*	bspcoord)
 void R_Subsector (int num)
 {
     int			count;
-    seg_t*		line;
+    int			line;
     subsector_t*	sub;
 	
 #ifdef RANGECHECK
@@ -506,11 +640,21 @@ void R_Subsector (int num)
 		 numsubsectors);
 #endif
 
+    // Out of sight, but its things may not be.
+    if (pvsinuse && pvssubsectors[num] != PVS_DRAW)
+    {
+	framestats.nodesculled++;
+
+	if (pvssubsectors[num] == PVS_SPRITES)
+	    R_AddSprites (subsectors[num].sector);
+	return;
+    }
+
     sscount++;
     sub = &subsectors[num];
     frontsector = sub->sector;
     count = sub->numlines;
-    line = &segs[sub->firstline];
+    line = sub->firstline;
 
     if (frontsector->floorheight < viewz)
     {
@@ -547,37 +691,182 @@ void R_Subsector (int num)
 
 
 
+//
+// R_PointOnPartition
+// As R_PointOnSide, for one of bsppartitions.
+//
+static inline int
+R_PointOnPartition
+( fixed_t		x,
+  fixed_t		y,
+  const fixed_t*	partition )
+{
+    fixed_t	px;
+    fixed_t	py;
+    fixed_t	pdx;
+    fixed_t	pdy;
+    fixed_t	dx;
+    fixed_t	dy;
+    fixed_t	left;
+    fixed_t	right;
+
+    px = partition[0];
+    py = partition[1];
+    pdx = partition[2];
+    pdy = partition[3];
+
+    if (!pdx)
+    {
+	if (x <= px)
+	    return pdy > 0;
+
+	return pdy < 0;
+    }
+    if (!pdy)
+    {
+	if (y <= py)
+	    return pdx < 0;
+
+	return pdx > 0;
+    }
+
+    dx = (x - px);
+    dy = (y - py);
+
+    // Try to quickly decide by looking at sign bits.
+    if ( (pdy ^ pdx ^ dx ^ dy)&0x80000000 )
+    {
+	if  ( (pdy ^ dx) & 0x80000000 )
+	{
+	    // (left is negative)
+	    return 1;
+	}
+	return 0;
+    }
+
+    left = FixedMul ( pdy>>FRACBITS , dx );
+    right = FixedMul ( dy , pdx>>FRACBITS );
+
+    if (right < left)
+    {
+	// front side
+	return 0;
+    }
+    // back side
+    return 1;
+}
+
+
 //
 // RenderBSPNode
 // Renders all subsectors below a given node,
-//  traversing subtree recursively.
+//  front spaces first, keeping the back spaces on bspstack
+//  until everything in front of them is done.
 // Just call with BSP root.
 void R_RenderBSPNode (int bspnum)
 {
-    node_t*	bsp;
+    int*	stack;
     int		side;
 
-    // Found a subsector?
-    if (bspnum & NF_SUBSECTOR)
+    stack = bspstack;
+
+    for (;;)
     {
-	if (bspnum == -1)			
-	    R_Subsector (0);
-	else
-	    R_Subsector (bspnum&(~NF_SUBSECTOR));
-	return;
-    }
-		
-    bsp = &nodes[bspnum];
-    
-    // Decide which side the view point is on.
-    side = R_PointOnSide (viewx, viewy, bsp);
+	// Divide front spaces down to a subsector.
+	while (!(bspnum & NF_SUBSECTOR))
+	{
+	    framestats.nodes++;
+
+	    // Nothing to be done under it?
+	    if (pvsinuse && !pvsnodes[bspnum])
+	    {
+		framestats.nodesculled++;
+		break;
+	    }
+
+	    // Decide which side the view point is on.
+	    side = R_PointOnPartition (viewx, viewy, bsppartitions + bspnum*4);
+
+	    *stack++ = bspnum*2 + (side^1);
+	    bspnum = bspchildren[bspnum*2 + side];
+	}
+
+	// Found a subsector?
+	if (bspnum & NF_SUBSECTOR)
+	{
+	    framestats.nodes++;
+
+	    if (bspnum == -1)
+		R_Subsector (0);
+	    else
+		R_Subsector (bspnum&(~NF_SUBSECTOR));
+	}
+
+	// Possibly divide the last back space left.
+	for (;;)
+	{
+	    if (stack == bspstack)
+		return;
+
+	    side = *--stack;
 
-    // Recursively divide front space.
-    R_RenderBSPNode (bsp->children[side]); 
+	    if (R_CheckBBox (bspboxes + side*4))
+	    {
+		bspnum = bspchildren[side];
+		break;
+	    }
 
-    // Possibly divide back space.
-    if (R_CheckBBox (bsp->bbox[side^1]))	
-	R_RenderBSPNode (bsp->children[side^1]);
+	    framestats.bboxrejects++;
+	}
+    }
 }
 
 
+//
+// R_SetupBSP
+// Makes the copies of the nodes and segs for the walk,
+//  once the level is loaded.
+//
+void R_SetupBSP (void)
+{
+    node_t*	node;
+    seg_t*	seg;
+    int		i;
+    int		j;
+    int		k;
+
+    bsppartitions = Z_Malloc ((numnodes + 1) * 4 * sizeof(*bsppartitions),
+			      PU_LEVEL, NULL);
+    bspchildren = Z_Malloc ((numnodes + 1) * 2 * sizeof(*bspchildren),
+			    PU_LEVEL, NULL);
+    bspboxes = Z_Malloc ((numnodes + 1) * 8 * sizeof(*bspboxes),
+			 PU_LEVEL, NULL);
+    bspstack = Z_Malloc ((numnodes + 1) * sizeof(*bspstack),
+			 PU_LEVEL, NULL);
+    segcoords = Z_Malloc ((numsegs + 1) * 4 * sizeof(*segcoords),
+			  PU_LEVEL, NULL);
+
+    for (i=0, node=nodes ; i<numnodes ; i++, node++)
+    {
+	bsppartitions[i*4 + 0] = node->x;
+	bsppartitions[i*4 + 1] = node->y;
+	bsppartitions[i*4 + 2] = node->dx;
+	bsppartitions[i*4 + 3] = node->dy;
+
+	for (j=0 ; j<2 ; j++)
+	{
+	    bspchildren[i*2 + j] = node->children[j];
+
+	    for (k=0 ; k<4 ; k++)
+		bspboxes[(i*2 + j)*4 + k] = node->bbox[j][k];
+	}
+    }
+
+    for (i=0, seg=segs ; i<numsegs ; i++, seg++)
+    {
+	segcoords[i*4 + 0] = seg->v1->x;
+	segcoords[i*4 + 1] = seg->v1->y;
+	segcoords[i*4 + 2] = seg->v2->x;
+	segcoords[i*4 + 3] = seg->v2->y;
+    }
+}
@@ -39,8 +39,9 @@ extern boolean		markceiling;
 
 extern boolean		skymap;
 
-extern drawseg_t	drawsegs[MAXDRAWSEGS];
+extern drawseg_t*	drawsegs;
 extern drawseg_t*	ds_p;
+extern int		numdrawsegs;
 
 extern lighttable_t**	hscalelight;
 extern lighttable_t**	vscalelight;
@@ -53,9 +54,13 @@ typedef void (*drawfunc_t) (int start, int stop);
 // BSP?
 void R_ClearClipSegs (void);
 void R_ClearDrawSegs (void);
+boolean R_CheckDrawSegs (void);
 
 
 void R_RenderBSPNode (int bspnum);
 
+// Called by P_SetupLevel, once the level is loaded.
+void R_SetupBSP (void);
+
 
 #endif
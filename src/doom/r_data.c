@@ -18,10 +18,15 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "deh_main.h"
+#include "i_sound.h"
 #include "i_swap.h"
 #include "i_system.h"
+#include "i_thread.h"
+#include "i_timer.h"
+#include "m_argv.h"
 #include "z_zone.h"
 
 
@@ -34,6 +39,7 @@
 
 #include "doomstat.h"
 #include "r_sky.h"
+#include "sounds.h"
 
 
 #include "r_data.h"
@@ -155,6 +161,10 @@ byte**			texturecomposite;
 int*		flattranslation;
 int*		texturetranslation;
 
+// decoded masked columns, purged along with the other PU_CACHE data
+static maskedcolumns_t**	spritecolumns;
+static maskedcolumns_t**	texturecolumns;
+
 // needed for pre rendering
 fixed_t*	spritewidth;	
 fixed_t*	spriteoffset;
@@ -217,6 +227,57 @@ R_DrawColumnInCache
 
 
 
+//
+// R_CompositePatch
+// Draws one of a texture's patches into the composite block,
+//  for the columns that are made up of more than one patch.
+// Touches nothing shared, so workers can call it.
+//
+static void
+R_CompositePatch
+( texture_t*	texture,
+  texpatch_t*	patch,
+  patch_t*	realpatch,
+  byte*		block )
+{
+    int			x;
+    int			x1;
+    int			x2;
+    column_t*		patchcol;
+    short*		collump;
+    unsigned short*	colofs;
+
+    collump = texturecolumnlump[texture->index];
+    colofs = texturecolumnofs[texture->index];
+
+    x1 = patch->originx;
+    x2 = x1 + SHORT(realpatch->width);
+
+    if (x1<0)
+	x = 0;
+    else
+	x = x1;
+
+    if (x2 > texture->width)
+	x2 = texture->width;
+
+    for ( ; x<x2 ; x++)
+    {
+	// Column does not have multiple patches?
+	if (collump[x] >= 0)
+	    continue;
+
+	patchcol = (column_t *)((byte *)realpatch
+				+ LONG(realpatch->columnofs[x-x1]));
+	R_DrawColumnInCache (patchcol,
+			     block + colofs[x],
+			     patch->originy,
+			     texture->height);
+    }
+}
+
+
+
 //
 // R_GenerateComposite
 // Using the texture definition,
@@ -229,13 +290,7 @@ void R_GenerateComposite (int texnum)
     texture_t*		texture;
     texpatch_t*		patch;	
     patch_t*		realpatch;
-    int			x;
-    int			x1;
-    int			x2;
     int			i;
-    column_t*		patchcol;
-    short*		collump;
-    unsigned short*	colofs;
 	
     texture = textures[texnum];
 
@@ -243,42 +298,13 @@ void R_GenerateComposite (int texnum)
 		      PU_STATIC, 
 		      &texturecomposite[texnum]);	
 
-    collump = texturecolumnlump[texnum];
-    colofs = texturecolumnofs[texnum];
-    
     // Composite the columns together.
-    patch = texture->patches;
-		
     for (i=0 , patch = texture->patches;
 	 i<texture->patchcount;
 	 i++, patch++)
     {
 	realpatch = W_CacheLumpNum (patch->patch, PU_CACHE);
-	x1 = patch->originx;
-	x2 = x1 + SHORT(realpatch->width);
-
-	if (x1<0)
-	    x = 0;
-	else
-	    x = x1;
-	
-	if (x2 > texture->width)
-	    x2 = texture->width;
-
-	for ( ; x<x2 ; x++)
-	{
-	    // Column does not have multiple patches?
-	    if (collump[x] >= 0)
-		continue;
-	    
-	    patchcol = (column_t *)((byte *)realpatch
-				    + LONG(realpatch->columnofs[x-x1]));
-	    R_DrawColumnInCache (patchcol,
-				 block + colofs[x],
-				 patch->originy,
-				 texture->height);
-	}
-						
+	R_CompositePatch (texture, patch, realpatch, block);
     }
 
     // Now that the texture has been built in column cache,
@@ -376,6 +402,9 @@ void R_GenerateLookup (int texnum)
 
 
 
+static boolean R_TakePrecachedComposite (int texnum);
+
+
 //
 // R_GetColumn
 //
@@ -395,12 +424,123 @@ R_GetColumn
 	return (byte *)W_CacheLumpNum(lump,PU_CACHE)+ofs;
 
     if (!texturecomposite[tex])
-	R_GenerateComposite (tex);
+    {
+	// It may already be on its way from the precache threads.
+	if (!R_TakePrecachedComposite (tex))
+	    R_GenerateComposite (tex);
+    }
 
     return texturecomposite[tex] + ofs;
 }
 
 
+
+//
+// R_DecodeColumns
+// Builds the posts for numcolumns columns fetched by getcolumn.
+// Each column is fetched again for the second pass, as allocating
+//  the posts may have purged it.
+//
+typedef column_t* (*getcolumn_t) (int key, int col);
+
+static maskedcolumns_t*
+R_DecodeColumns
+( int			key,
+  int			numcolumns,
+  getcolumn_t		getcolumn,
+  maskedcolumns_t**	user )
+{
+    maskedcolumns_t*	mc;
+    maskedpost_t*	post;
+    column_t*		start;
+    column_t*		column;
+    int			numposts;
+    int			col;
+
+    if (*user)
+    {
+	Z_ChangeTag (*user, PU_STATIC);
+	return *user;
+    }
+
+    numposts = 0;
+
+    for (col = 0 ; col < numcolumns ; col++)
+    {
+	column = getcolumn (key, col);
+
+	for ( ; column->topdelta != 0xff ; numposts++)
+	    column = (column_t *) ((byte *)column + column->length + 4);
+    }
+
+    mc = Z_Malloc (sizeof(*mc)
+		   + (numcolumns + 1) * sizeof(*mc->firstpost)
+		   + numposts * sizeof(*mc->posts),
+		   PU_STATIC, (void **) user);
+    mc->numcolumns = numcolumns;
+    mc->firstpost = (int *) (mc + 1);
+    mc->posts = (maskedpost_t *) (mc->firstpost + numcolumns + 1);
+
+    post = mc->posts;
+
+    for (col = 0 ; col < numcolumns ; col++)
+    {
+	mc->firstpost[col] = post - mc->posts;
+	start = getcolumn (key, col);
+
+	for (column = start ; column->topdelta != 0xff ; post++)
+	{
+	    post->topdelta = column->topdelta;
+	    post->length = column->length;
+	    post->offset = (byte *)column + 3 - (byte *)start;
+	    column = (column_t *) ((byte *)column + column->length + 4);
+	}
+    }
+
+    mc->firstpost[numcolumns] = post - mc->posts;
+
+    return mc;
+}
+
+
+static column_t* R_SpriteColumn (int lump, int col)
+{
+    patch_t*	patch;
+
+    patch = W_CacheLumpNum (firstspritelump + lump, PU_CACHE);
+
+    return (column_t *) ((byte *)patch + LONG(patch->columnofs[col]));
+}
+
+
+static column_t* R_TextureColumn (int tex, int col)
+{
+    return (column_t *) (R_GetColumn (tex, col) - 3);
+}
+
+
+//
+// R_CacheSpriteColumns
+//
+maskedcolumns_t* R_CacheSpriteColumns (int lump)
+{
+    return R_DecodeColumns (lump, spritewidth[lump] >> FRACBITS,
+			    R_SpriteColumn, &spritecolumns[lump]);
+}
+
+
+//
+// R_CacheTextureColumns
+// R_GetColumn wraps columns with texturewidthmask,
+//  so only that many are needed.
+//
+maskedcolumns_t* R_CacheTextureColumns (int tex)
+{
+    return R_DecodeColumns (tex, texturewidthmask[tex] + 1,
+			    R_TextureColumn, &texturecolumns[tex]);
+}
+
+
 static void GenerateTextureHashTable(void)
 {
     texture_t **rover;
@@ -526,6 +666,8 @@ void R_InitTextures (void)
     texturecompositesize = Z_Malloc (numtextures * sizeof(*texturecompositesize), PU_STATIC, 0);
     texturewidthmask = Z_Malloc (numtextures * sizeof(*texturewidthmask), PU_STATIC, 0);
     textureheight = Z_Malloc (numtextures * sizeof(*textureheight), PU_STATIC, 0);
+    texturecolumns = Z_Malloc (numtextures * sizeof(*texturecolumns), PU_STATIC, 0);
+    memset (texturecolumns, 0, numtextures * sizeof(*texturecolumns));
 
     totalwidth = 0;
     
@@ -664,6 +806,8 @@ void R_InitSpriteLumps (void)
     spritewidth = Z_Malloc (numspritelumps*sizeof(*spritewidth), PU_STATIC, 0);
     spriteoffset = Z_Malloc (numspritelumps*sizeof(*spriteoffset), PU_STATIC, 0);
     spritetopoffset = Z_Malloc (numspritelumps*sizeof(*spritetopoffset), PU_STATIC, 0);
+    spritecolumns = Z_Malloc (numspritelumps*sizeof(*spritecolumns), PU_STATIC, 0);
+    memset (spritecolumns, 0, numspritelumps*sizeof(*spritecolumns));
 	
     for (i=0 ; i< numspritelumps ; i++)
     {
@@ -909,4 +1053,460 @@ void R_PrecacheLevel (void)
 
 
 
+//
+// BACKGROUND PRECACHING
+// With -precachethreads, R_StartPrecache hands the work of
+//  compositing the level's textures, and of paging in its
+//  graphics and sounds from a memory-mapped WAD, to worker
+//  threads.  Only the game thread may use the zone, so it
+//  allocates each composite and locks its patches beforehand;
+//  the workers just fill in memory.  Finished composites are
+//  given to texturecomposite[] on the game thread, either by
+//  R_UpdatePrecache or when R_GetColumn wants one early.
+//
+enum
+{
+    PRECACHE_PENDING,
+    PRECACHE_BUSY,
+    PRECACHE_DONE
+};
+
+typedef struct
+{
+    int			texnum;
+
+    // The composite, until it is handed over.
+    byte*		block;
+
+    // Locked pointers to each of the texture's patches,
+    //  and the tags they had before.
+    patch_t**		patches;
+    int*		patchtags;
+
+    atomic_int_t	state;
+} precachetex_t;
+
+static boolean		bgprecache = false;
+
+static thread_batch_t*	precachebatch;
+
+static precachetex_t*	precachetex;
+static int		numprecachetex;
+
+// Index into precachetex for each texture, or -1.
+static int*		precachetexindex;
+
+// Lumps to page in once the textures are done.
+static int*		precachelumps;
+static int		numprecachelumps;
+
+// The composites and their patches are locked until all of
+//  the precaching is done, so stop taking on textures when
+//  this much of the zone would be left.  The rest are
+//  composited on demand as usual.
+#define PRECACHEMARGIN	((int) (Z_ZoneSize () / 4))
+
+
+//
+// BuildPrecachedComposite
+// Builds the composite, unless another thread got there first.
+//
+static void BuildPrecachedComposite (precachetex_t* pt)
+{
+    texture_t*		texture;
+    int			i;
+
+    if (!I_AtomicCAS (&pt->state, PRECACHE_PENDING, PRECACHE_BUSY))
+	return;
+
+    texture = textures[pt->texnum];
+
+    for (i=0 ; i<texture->patchcount ; i++)
+    {
+	R_CompositePatch (texture, &texture->patches[i],
+			  pt->patches[i], pt->block);
+    }
+
+    I_AtomicSet (&pt->state, PRECACHE_DONE);
+}
+
+
+static void PrecacheJob (void* data, int index)
+{
+    if (index < numprecachetex)
+	BuildPrecachedComposite (&precachetex[index]);
+    else
+	W_PrefetchLump (precachelumps[index - numprecachetex]);
+}
+
+
+//
+// HandOverComposite
+// Makes a finished composite visible to R_GetColumn,
+//  purgable just like one made by R_GenerateComposite.
+//
+static void HandOverComposite (precachetex_t* pt)
+{
+    if (pt->block == NULL)
+	return;
+
+    Z_ChangeUser (pt->block, (void **) &texturecomposite[pt->texnum]);
+    Z_ChangeTag (pt->block, PU_CACHE);
+    pt->block = NULL;
+}
+
+
+//
+// R_TakePrecachedComposite
+// Called by R_GetColumn for a texture that has no composite.
+// If it is one being precached, gets it ready now,
+//  building it here if no worker has started on it.
+//
+static boolean R_TakePrecachedComposite (int texnum)
+{
+    precachetex_t*	pt;
+
+    if (precachebatch == NULL || precachetexindex[texnum] < 0)
+	return false;
+
+    pt = &precachetex[precachetexindex[texnum]];
+
+    // Already handed over, and purged since.
+    if (pt->block == NULL)
+	return false;
+
+    // Build it here, or wait for the worker that is building it.
+    BuildPrecachedComposite (pt);
+    I_WaitForJob (&pt->state, PRECACHE_DONE);
+
+    HandOverComposite (pt);
+
+    return true;
+}
+
+
+//
+// RestorePatchTag
+// Undoes the W_CacheLumpNum in R_StartPrecache.
+//
+static void RestorePatchTag (int lump, int tag)
+{
+    if (tag == PU_CACHE)
+	W_ReleaseLumpNum (lump);
+    else
+	Z_ChangeTag (lumpinfo[lump]->cache, tag);
+}
+
+
+//
+// R_FinishPrecache
+// Waits for all of the precaching to finish.
+//
+static void R_FinishPrecache (void)
+{
+    precachetex_t*	pt;
+    texture_t*		texture;
+    int			i;
+    int			j;
+
+    if (precachebatch == NULL)
+	return;
+
+    I_FinishBatch (precachebatch);
+    precachebatch = NULL;
+
+    // Go backwards, so that a patch used more than once, which
+    //  was already locked the later times, is left with the tag
+    //  it had first.
+    for (i=numprecachetex-1 ; i>=0 ; i--)
+    {
+	pt = &precachetex[i];
+	texture = textures[pt->texnum];
+
+	HandOverComposite (pt);
+
+	for (j=texture->patchcount-1 ; j>=0 ; j--)
+	    RestorePatchTag (texture->patches[j].patch, pt->patchtags[j]);
+
+	Z_Free (pt->patches);
+	Z_Free (pt->patchtags);
+    }
+
+    Z_Free (precachetex);
+    Z_Free (precachetexindex);
+    Z_Free (precachelumps);
+
+    precachetex = NULL;
+    numprecachetex = 0;
+    precachelumps = NULL;
+    numprecachelumps = 0;
+}
+
+
+//
+// R_UpdatePrecache
+// Called once a frame, to pick up the finished composites.
+//
+void R_UpdatePrecache (void)
+{
+    int		i;
+
+    if (precachebatch == NULL)
+	return;
+
+    for (i=0 ; i<numprecachetex ; i++)
+    {
+	if (precachetex[i].block != NULL
+	 && I_AtomicGet (&precachetex[i].state) == PRECACHE_DONE)
+	{
+	    HandOverComposite (&precachetex[i]);
+	}
+    }
+
+    if (I_BatchFinished (precachebatch))
+	R_FinishPrecache ();
+}
+
+
+static void AddPrecacheLump (byte* lumpmarked, int lump)
+{
+    if (lump <= 0 || lumpmarked[lump])
+	return;
 
+    lumpmarked[lump] = 1;
+    precachelumps[numprecachelumps++] = lump;
+}
+
+
+static void AddPrecacheSound (byte* lumpmarked, int sfx)
+{
+    if (sfx <= 0 || sfx >= NUMSFX)
+	return;
+
+    if (S_sfx[sfx].lumpnum >= 0)
+	AddPrecacheLump (lumpmarked, S_sfx[sfx].lumpnum);
+    else
+	AddPrecacheLump (lumpmarked, I_GetSfxLumpNum (&S_sfx[sfx]));
+}
+
+
+//
+// R_StartPrecache
+// Called by G_DoLoadLevel once the level is set up.
+// Works out every texture, flat, sprite frame and sound
+//  the level uses, and starts the workers on them.
+//
+void R_StartPrecache (void)
+{
+    byte*		texturepresent;
+    byte*		spritepresent;
+    byte*		lumpmarked;
+    precachetex_t*	pt;
+    texture_t*		texture;
+    thinker_t*		th;
+    mobjinfo_t*		info;
+    spriteframe_t*	sf;
+    int			numcandidates;
+    int			freemem;
+    int			lump;
+    int			size;
+    int			i;
+    int			j;
+    int			k;
+
+    if (!bgprecache)
+	return;
+
+    // Anything still going from the last level.
+    R_FinishPrecache ();
+
+    texturepresent = Z_Malloc (numtextures, PU_STATIC, NULL);
+    memset (texturepresent, 0, numtextures);
+
+    for (i=0 ; i<numsides ; i++)
+    {
+	texturepresent[sides[i].toptexture] = 1;
+	texturepresent[sides[i].midtexture] = 1;
+	texturepresent[sides[i].bottomtexture] = 1;
+    }
+
+    texturepresent[skytexture] = 1;
+
+    spritepresent = Z_Malloc (numsprites, PU_STATIC, NULL);
+    memset (spritepresent, 0, numsprites);
+
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+	if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+	    spritepresent[((mobj_t *)th)->sprite] = 1;
+    }
+
+    // Textures that need compositing.
+    precachetexindex = Z_Malloc (numtextures * sizeof(*precachetexindex),
+				 PU_STATIC, NULL);
+    numcandidates = 0;
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	precachetexindex[i] = -1;
+
+	if (texturepresent[i]
+	 && texturecompositesize[i] > 0
+	 && texturecomposite[i] == NULL)
+	{
+	    numcandidates++;
+	}
+    }
+
+    precachetex = Z_Malloc (numcandidates * sizeof(*precachetex),
+			    PU_STATIC, NULL);
+    numprecachetex = 0;
+
+    // Z_FreeMemory walks the whole zone, so take it once and
+    //  count down as the composites and patches are locked.
+    // (It counts purgable blocks as free.)
+    freemem = Z_FreeMemory ();
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	if (!texturepresent[i]
+	 || texturecompositesize[i] == 0
+	 || texturecomposite[i] != NULL)
+	{
+	    continue;
+	}
+
+	texture = textures[i];
+
+	// Room for the composite and its patches?
+	if (freemem >= 0)
+	{
+	    size = texturecompositesize[i];
+
+	    for (j=0 ; j<texture->patchcount ; j++)
+		size += W_LumpLength (texture->patches[j].patch);
+
+	    if (freemem - size < PRECACHEMARGIN)
+		break;
+
+	    freemem -= size;
+	}
+
+	precachetexindex[i] = numprecachetex;
+	pt = &precachetex[numprecachetex++];
+
+	pt->texnum = i;
+	pt->block = Z_Malloc (texturecompositesize[i], PU_STATIC, NULL);
+	pt->patches = Z_Malloc (texture->patchcount * sizeof(*pt->patches),
+				PU_STATIC, NULL);
+	pt->patchtags = Z_Malloc (texture->patchcount
+				  * sizeof(*pt->patchtags),
+				  PU_STATIC, NULL);
+
+	for (j=0 ; j<texture->patchcount ; j++)
+	{
+	    lump = texture->patches[j].patch;
+
+	    // Patches in a memory-mapped WAD, or not yet loaded,
+	    //  have no block to keep a tag for.
+	    if (lumpinfo[lump]->cache != NULL)
+		pt->patchtags[j] = Z_GetTag (lumpinfo[lump]->cache);
+	    else
+		pt->patchtags[j] = PU_CACHE;
+
+	    pt->patches[j] = W_CacheLumpNum (lump, PU_STATIC);
+	}
+
+	I_AtomicSet (&pt->state, PRECACHE_PENDING);
+    }
+
+    // Lumps to page in.
+    lumpmarked = Z_Malloc (numlumps, PU_STATIC, NULL);
+    memset (lumpmarked, 0, numlumps);
+    precachelumps = Z_Malloc (numlumps * sizeof(*precachelumps),
+			      PU_STATIC, NULL);
+    numprecachelumps = 0;
+
+    for (i=0 ; i<numsectors ; i++)
+    {
+	AddPrecacheLump (lumpmarked, firstflat + sectors[i].floorpic);
+	AddPrecacheLump (lumpmarked, firstflat + sectors[i].ceilingpic);
+    }
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	if (!texturepresent[i])
+	    continue;
+
+	for (j=0 ; j<textures[i]->patchcount ; j++)
+	    AddPrecacheLump (lumpmarked, textures[i]->patches[j].patch);
+    }
+
+    for (i=0 ; i<numsprites ; i++)
+    {
+	if (!spritepresent[i])
+	    continue;
+
+	for (j=0 ; j<sprites[i].numframes ; j++)
+	{
+	    sf = &sprites[i].spriteframes[j];
+
+	    for (k=0 ; k<8 ; k++)
+		AddPrecacheLump (lumpmarked, firstspritelump + sf->lump[k]);
+	}
+    }
+
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+	if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+	    continue;
+
+	info = ((mobj_t *)th)->info;
+	AddPrecacheSound (lumpmarked, info->seesound);
+	AddPrecacheSound (lumpmarked, info->attacksound);
+	AddPrecacheSound (lumpmarked, info->painsound);
+	AddPrecacheSound (lumpmarked, info->deathsound);
+	AddPrecacheSound (lumpmarked, info->activesound);
+    }
+
+    Z_Free (lumpmarked);
+    Z_Free (spritepresent);
+    Z_Free (texturepresent);
+
+    precachebatch = I_StartBatch (PrecacheJob, NULL,
+				  numprecachetex + numprecachelumps, false);
+}
+
+
+//
+// R_InitPrecache
+//
+void R_InitPrecache (void)
+{
+    int		p;
+    int		threads;
+
+    //!
+    // @arg <n>
+    // @category video
+    //
+    // When a level is loaded, composite its textures and page in
+    // its graphics and sounds using n background threads.  If n is
+    // 0, one thread is used for each CPU.  Paging in only applies
+    // to WADs loaded with -mmap.
+    //
+
+    p = M_CheckParmWithArgs ("-precachethreads", 1);
+
+    if (!p)
+	return;
+
+    threads = atoi (myargv[p + 1]);
+
+    if (threads <= 0)
+	threads = I_GetNumCPUs ();
+
+    I_InitThreadPool (threads);
+
+    bgprecache = true;
+}
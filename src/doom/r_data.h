@@ -32,10 +32,44 @@ R_GetColumn
   int		col );
 
 
+// The posts of every column of a sprite or masked texture,
+//  decoded once so that masked drawing need not walk
+//  the column_t headers.
+typedef struct
+{
+    short	topdelta;
+    short	length;
+
+    // Offset of the post's pixels from the start of its column.
+    int		offset;
+} maskedpost_t;
+
+typedef struct
+{
+    int			numcolumns;
+
+    // Column i has posts firstpost[i] to firstpost[i+1]-1.
+    int*		firstpost;
+    maskedpost_t*	posts;
+} maskedcolumns_t;
+
+// Decoded posts for a sprite lump (numbered from firstspritelump)
+//  or a texture, built on first use. They are returned PU_STATIC,
+//  as caching the columns may purge other PU_CACHE blocks; the
+//  caller sets them back to PU_CACHE when it has finished drawing.
+maskedcolumns_t* R_CacheSpriteColumns (int lump);
+maskedcolumns_t* R_CacheTextureColumns (int tex);
+
+
 // I/O, setting up the stuff.
 void R_InitData (void);
 void R_PrecacheLevel (void);
 
+// Background precaching, with -precachethreads.
+void R_InitPrecache (void);
+void R_StartPrecache (void);
+void R_UpdatePrecache (void);
+
 
 // Retrieval.
 // Floor/ceiling opaque texture tiles,
@@ -29,6 +29,8 @@
 #include "w_wad.h"
 
 #include "r_local.h"
+#include "r_simd.h"
+#include "r_thread.h"
 
 // Needs access to LFB (guess what).
 #include "v_video.h"
@@ -79,15 +81,17 @@ static pixel_t *background_buffer = NULL;
 // R_DrawColumn
 // Source is the top of the column to scale.
 //
-lighttable_t*		dc_colormap; 
-int			dc_x; 
-int			dc_yl; 
-int			dc_yh; 
-fixed_t			dc_iscale; 
-fixed_t			dc_texturemid;
+// These are per-thread, so that the view can be drawn
+//  in strips by several threads at once (see r_thread.c).
+THREADLOCAL lighttable_t*	dc_colormap; 
+THREADLOCAL int			dc_x; 
+THREADLOCAL int			dc_yl; 
+THREADLOCAL int			dc_yh; 
+THREADLOCAL fixed_t		dc_iscale; 
+THREADLOCAL fixed_t		dc_texturemid;
 
 // first pixel in a column (possibly virtual) 
-byte*			dc_source;		
+THREADLOCAL byte*		dc_source;		
 
 // just for profiling 
 int			dccount;
@@ -145,6 +149,34 @@ void R_DrawColumn (void)
 } 
 
 
+//
+// R_DrawColumnVector
+// Same as R_DrawColumn, using the SSE2/AVX2/NEON
+//  kernel picked by R_InitDrawKernels.
+//
+void R_DrawColumnVector (void)
+{
+    int			count;
+
+    count = dc_yh - dc_yl;
+
+    if (count < 0)
+	return;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= SCREENWIDTH
+	|| dc_yl < 0
+	|| dc_yh >= SCREENHEIGHT)
+	I_Error ("R_DrawColumnVector: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+    drawkernels->column(ylookup[dc_yl] + columnofs[dc_x],
+			dc_source, dc_colormap,
+			dc_texturemid + (dc_yl-centery)*dc_iscale,
+			dc_iscale, count + 1);
+}
+
+
 
 // UNUSED.
 // Loop unrolled.
@@ -269,7 +301,7 @@ int	fuzzoffset[FUZZTABLE] =
     FUZZOFF,FUZZOFF,-FUZZOFF,FUZZOFF,FUZZOFF,-FUZZOFF,FUZZOFF 
 }; 
 
-int	fuzzpos = 0; 
+THREADLOCAL int	fuzzpos = 0; 
 
 
 //
@@ -404,6 +436,29 @@ void R_DrawFuzzColumnLow (void)
 	frac += fracstep; 
     } while (count--); 
 } 
+
+
+//
+// R_SkipFuzzColumn
+// Moves fuzzpos on past the column described by dc_yl/dc_yh,
+//  exactly as drawing it with R_DrawFuzzColumn would,
+//  but without touching the framebuffer.
+//
+void R_SkipFuzzColumn (void)
+{
+    int			yl;
+    int			yh;
+    int			count;
+
+    yl = dc_yl ? dc_yl : 1;
+    yh = dc_yh == viewheight-1 ? viewheight - 2 : dc_yh;
+    count = yh - yl;
+
+    if (count < 0)
+	return;
+
+    fuzzpos = (fuzzpos + count + 1) % FUZZTABLE;
+}
  
   
   
@@ -418,7 +473,7 @@ void R_DrawFuzzColumnLow (void)
 //  of the BaronOfHell, the HellKnight, uses
 //  identical sprites, kinda brightened up.
 //
-byte*	dc_translation;
+THREADLOCAL byte*	dc_translation;
 byte*	translationtables;
 
 void R_DrawTranslatedColumn (void) 
@@ -567,19 +622,19 @@ void R_InitTranslationTables (void)
 // In consequence, flats are not stored by column (like walls),
 //  and the inner loop has to step in texture space u and v.
 //
-int			ds_y; 
-int			ds_x1; 
-int			ds_x2;
+THREADLOCAL int		ds_y; 
+THREADLOCAL int		ds_x1; 
+THREADLOCAL int		ds_x2;
 
-lighttable_t*		ds_colormap; 
+THREADLOCAL lighttable_t*	ds_colormap; 
 
-fixed_t			ds_xfrac; 
-fixed_t			ds_yfrac; 
-fixed_t			ds_xstep; 
-fixed_t			ds_ystep;
+THREADLOCAL fixed_t		ds_xfrac; 
+THREADLOCAL fixed_t		ds_yfrac; 
+THREADLOCAL fixed_t		ds_xstep; 
+THREADLOCAL fixed_t		ds_ystep;
 
 // start of a 64*64 tile image 
-byte*			ds_source;	
+THREADLOCAL byte*		ds_source;	
 
 // just for profiling
 int			dscount;
@@ -639,6 +694,62 @@ void R_DrawSpan (void)
 }
 
 
+//
+// R_DrawSpanVector
+// Same as R_DrawSpan, using the SSE2/AVX2/NEON
+//  kernel picked by R_InitDrawKernels.
+//
+void R_DrawSpanVector (void)
+{
+    unsigned int position, step;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=SCREENWIDTH
+	|| (unsigned)ds_y>SCREENHEIGHT)
+    {
+	I_Error( "R_DrawSpanVector: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    drawkernels->packedspan(ylookup[ds_y] + columnofs[ds_x1],
+			    ds_source, ds_colormap,
+			    position, step, ds_x2 - ds_x1 + 1);
+}
+
+
+//
+// R_AdvanceSpan
+// Moves the start of the span described by ds_xfrac/ds_yfrac
+//  along by count pixels.  The texture coordinates reached are
+//  exactly those R_DrawSpan would have stepped to, so a span
+//  can be drawn in several pieces without changing the result.
+//
+void R_AdvanceSpan (int count)
+{
+    unsigned int position, step;
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    position += step * count;
+
+    // Unpack again; the bits that were dropped by packing
+    //  are never looked at by the span drawers.
+    ds_xfrac = (position >> 16) << 6;
+    ds_yfrac = (position & 0xffff) << 6;
+}
+
+
 
 // UNUSED.
 // Loop unrolled by 4.
@@ -766,6 +877,208 @@ void R_DrawSpanLow (void)
     } while (count--);
 }
 
+
+//
+// Column-major view buffer, for -columnmajor.
+// Each column of the view is kept top to bottom in
+//  COLBUFFERPITCH consecutive bytes, so the column drawers
+//  write to memory in order instead of a screen width apart.
+// Spans are drawn across the columns instead.
+// The finished view is transposed into the screen buffer.
+//
+#define COLBUFFERPITCH		SCREENHEIGHT
+
+static pixel_t		colbuffer[SCREENWIDTH * COLBUFFERPITCH];
+
+
+//
+// R_DrawColumnCM
+// R_DrawColumn for the column-major buffer.
+//
+void R_DrawColumnCM (void)
+{
+    int			count;
+    pixel_t*		dest;
+    fixed_t		frac;
+    fixed_t		fracstep;
+
+    count = dc_yh - dc_yl;
+
+    if (count < 0)
+	return;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= SCREENWIDTH
+	|| dc_yl < 0
+	|| dc_yh >= SCREENHEIGHT)
+	I_Error ("R_DrawColumnCM: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+    dest = colbuffer + dc_x * COLBUFFERPITCH + dc_yl;
+
+    fracstep = dc_iscale;
+    frac = dc_texturemid + (dc_yl-centery)*fracstep;
+
+    do
+    {
+	*dest++ = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
+	frac += fracstep;
+    } while (count--);
+}
+
+
+//
+// R_DrawFuzzColumnCM
+// R_DrawFuzzColumn for the column-major buffer.
+//
+void R_DrawFuzzColumnCM (void)
+{
+    int			count;
+    pixel_t*		dest;
+
+    // Adjust borders, as R_DrawFuzzColumn does.
+    if (!dc_yl)
+	dc_yl = 1;
+
+    if (dc_yh == viewheight-1)
+	dc_yh = viewheight - 2;
+
+    count = dc_yh - dc_yl;
+
+    if (count < 0)
+	return;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= SCREENWIDTH
+	|| dc_yl < 0 || dc_yh >= SCREENHEIGHT)
+    {
+	I_Error ("R_DrawFuzzColumnCM: %i to %i at %i",
+		 dc_yl, dc_yh, dc_x);
+    }
+#endif
+
+    dest = colbuffer + dc_x * COLBUFFERPITCH + dc_yl;
+
+    do
+    {
+	// The fuzz table steps a whole row up or down;
+	//  here that is the next byte either way.
+	*dest = colormaps[6*256+dest[fuzzoffset[fuzzpos] / FUZZOFF]];
+
+	if (++fuzzpos == FUZZTABLE)
+	    fuzzpos = 0;
+
+	dest++;
+    } while (count--);
+}
+
+
+//
+// R_DrawTranslatedColumnCM
+// R_DrawTranslatedColumn for the column-major buffer.
+//
+void R_DrawTranslatedColumnCM (void)
+{
+    int			count;
+    pixel_t*		dest;
+    fixed_t		frac;
+    fixed_t		fracstep;
+
+    count = dc_yh - dc_yl;
+
+    if (count < 0)
+	return;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= SCREENWIDTH
+	|| dc_yl < 0
+	|| dc_yh >= SCREENHEIGHT)
+    {
+	I_Error ("R_DrawTranslatedColumnCM: %i to %i at %i",
+		 dc_yl, dc_yh, dc_x);
+    }
+#endif
+
+    dest = colbuffer + dc_x * COLBUFFERPITCH + dc_yl;
+
+    fracstep = dc_iscale;
+    frac = dc_texturemid + (dc_yl-centery)*fracstep;
+
+    do
+    {
+	*dest++ = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
+	frac += fracstep;
+    } while (count--);
+}
+
+
+//
+// R_DrawSpanCM
+// R_DrawSpan for the column-major buffer,
+//  stepping across the columns.
+//
+void R_DrawSpanCM (void)
+{
+    unsigned int position, step;
+    pixel_t *dest;
+    int count;
+    int spot;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=SCREENWIDTH
+	|| (unsigned)ds_y>SCREENHEIGHT)
+    {
+	I_Error( "R_DrawSpanCM: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    dest = colbuffer + ds_x1 * COLBUFFERPITCH + ds_y;
+    count = ds_x2 - ds_x1;
+
+    do
+    {
+        spot = ((position >> 4) & 0x0fc0) | (position >> 26);
+	*dest = ds_colormap[ds_source[spot]];
+	dest += COLBUFFERPITCH;
+        position += step;
+    } while (count--);
+}
+
+
+//
+// R_StartColumnMajorView
+// Loads the column-major buffer with the view as it is
+//  on screen, so that anything the renderer does not
+//  draw over (eg. a hall of mirrors) still looks the same.
+//
+void R_StartColumnMajorView (void)
+{
+    R_Transpose(colbuffer, COLBUFFERPITCH,
+		ylookup[0] + columnofs[0], SCREENWIDTH,
+		viewwidth, viewheight);
+}
+
+
+//
+// R_FinishColumnMajorView
+// Copies the finished view back to the screen.
+//
+void R_FinishColumnMajorView (void)
+{
+    R_Transpose(ylookup[0] + columnofs[0], SCREENWIDTH,
+		colbuffer, COLBUFFERPITCH,
+		viewheight, viewwidth);
+}
+
+
 //
 // R_InitBuffer 
 // Creats lookup tables that avoid
@@ -779,6 +1092,7 @@ R_InitBuffer
   int		height ) 
 { 
     int		i; 
+    pixel_t*	dest;
 
     // Handle resize,
     //  e.g. smaller view windows
@@ -795,9 +1109,15 @@ R_InitBuffer
     else 
 	viewwindowy = (SCREENHEIGHT-SBARHEIGHT-height) >> 1; 
 
+    // With -pipeline, the view is drawn into a buffer of its own.
+    if (renderpipeline)
+	dest = pipelinebuffer;
+    else
+	dest = I_VideoBuffer;
+
     // Preclaculate all row offsets.
     for (i=0 ; i<height ; i++) 
-	ylookup[i] = I_VideoBuffer + (i+viewwindowy)*SCREENWIDTH; 
+	ylookup[i] = dest + (i+viewwindowy)*SCREENWIDTH; 
 } 
  
  
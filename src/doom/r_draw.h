@@ -20,18 +20,19 @@
 #ifndef __R_DRAW__
 #define __R_DRAW__
 
+#include "i_thread.h"
 
 
 
-extern lighttable_t*	dc_colormap;
-extern int		dc_x;
-extern int		dc_yl;
-extern int		dc_yh;
-extern fixed_t		dc_iscale;
-extern fixed_t		dc_texturemid;
+extern THREADLOCAL lighttable_t*	dc_colormap;
+extern THREADLOCAL int		dc_x;
+extern THREADLOCAL int		dc_yl;
+extern THREADLOCAL int		dc_yh;
+extern THREADLOCAL fixed_t	dc_iscale;
+extern THREADLOCAL fixed_t	dc_texturemid;
 
 // first pixel in a column
-extern byte*		dc_source;		
+extern THREADLOCAL byte*	dc_source;		
 
 
 // The span blitting interface.
@@ -40,10 +41,17 @@ extern byte*		dc_source;
 void 	R_DrawColumn (void);
 void 	R_DrawColumnLow (void);
 
+// R_DrawColumn using the vector kernels from r_simd.c.
+void	R_DrawColumnVector (void);
+
 // The Spectre/Invisibility effect.
 void 	R_DrawFuzzColumn (void);
 void 	R_DrawFuzzColumnLow (void);
 
+// Steps the fuzz effect past a column without drawing it.
+void	R_SkipFuzzColumn (void);
+extern THREADLOCAL int	fuzzpos;
+
 // Draw with color translation tables,
 //  for player sprite rendering,
 //  Green/Red/Blue/Indigo shirts.
@@ -55,31 +63,49 @@ R_VideoErase
 ( unsigned	ofs,
   int		count );
 
-extern int		ds_y;
-extern int		ds_x1;
-extern int		ds_x2;
+extern THREADLOCAL int		ds_y;
+extern THREADLOCAL int		ds_x1;
+extern THREADLOCAL int		ds_x2;
 
-extern lighttable_t*	ds_colormap;
+extern THREADLOCAL lighttable_t*	ds_colormap;
 
-extern fixed_t		ds_xfrac;
-extern fixed_t		ds_yfrac;
-extern fixed_t		ds_xstep;
-extern fixed_t		ds_ystep;
+extern THREADLOCAL fixed_t	ds_xfrac;
+extern THREADLOCAL fixed_t	ds_yfrac;
+extern THREADLOCAL fixed_t	ds_xstep;
+extern THREADLOCAL fixed_t	ds_ystep;
 
 // start of a 64*64 tile image
-extern byte*		ds_source;		
+extern THREADLOCAL byte*	ds_source;		
 
 extern byte*		translationtables;
-extern byte*		dc_translation;
+extern THREADLOCAL byte*	dc_translation;
 
 
 // Span blitting for rows, floor/ceiling.
 // No Sepctre effect needed.
 void 	R_DrawSpan (void);
 
+// R_DrawSpan using the vector kernels from r_simd.c.
+void	R_DrawSpanVector (void);
+
 // Low resolution mode, 160x200?
 void 	R_DrawSpanLow (void);
 
+// Skip the start of a span, for drawing it in pieces.
+void	R_AdvanceSpan (int count);
+
+// Versions of the drawers for the column-major view buffer,
+//  which is transposed onto the screen when the view is done.
+void	R_DrawColumnCM (void);
+void	R_DrawFuzzColumnCM (void);
+void	R_DrawTranslatedColumnCM (void);
+void	R_DrawSpanCM (void);
+
+// Copy the view from the screen into the column-major buffer,
+//  and back again once it has been drawn.
+void	R_StartColumnMajorView (void);
+void	R_FinishColumnMajorView (void);
+
 
 void
 R_InitBuffer
@@ -0,0 +1,159 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Growing the renderer's fixed pools past the vanilla limits,
+//	with -growlimits.
+//
+//	Each pool starts out as its vanilla static array.  When a
+//	frame fills one, it is doubled in the zone and kept at that
+//	size, so once a level has been looked around, frames allocate
+//	nothing.  Openings are the exception: drawsegs point into them,
+//	so they can't be moved, and more blocks are chained on instead.
+//
+//	Overflowing the pools is part of how vanilla behaves, and
+//	demos depend on it, so they never grow while a demo is being
+//	recorded or played back, the attract loop included.
+//
+
+#include <stdio.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "i_system.h"
+#include "m_argv.h"
+#include "z_zone.h"
+
+#include "r_local.h"
+#include "r_limits.h"
+
+boolean			growlimits = false;
+
+static boolean		allowgrowth = false;
+
+// The most used by any frame so far.
+static int		visplaneshigh;
+static int		drawsegshigh;
+static int		visspriteshigh;
+static int		openingshigh;
+
+
+//
+// R_GrowPool
+//
+void *R_GrowPool (const void *pool, int *size, size_t elemsize)
+{
+    void*	newpool;
+
+    newpool = Z_Malloc (*size * 2 * elemsize, PU_STATIC, NULL);
+    memcpy (newpool, pool, *size * elemsize);
+    *size *= 2;
+
+    return newpool;
+}
+
+
+//
+// R_FreePool
+//
+void R_FreePool (void *pool, const void *fixedpool)
+{
+    if (pool != fixedpool)
+	Z_Free (pool);
+}
+
+
+//
+// R_StartLimits
+//
+void R_StartLimits (void)
+{
+    growlimits = allowgrowth && !demoplayback && !demorecording;
+}
+
+
+//
+// R_FinishLimits
+//
+void R_FinishLimits (void)
+{
+    int		count;
+
+    count = lastvisplane - visplanes;
+    if (count > visplaneshigh)
+	visplaneshigh = count;
+
+    count = ds_p - drawsegs;
+    if (count > drawsegshigh)
+	drawsegshigh = count;
+
+    count = vissprite_p - vissprites;
+    if (count > visspriteshigh)
+	visspriteshigh = count;
+
+    count = R_OpeningsUsed ();
+    if (count > openingshigh)
+	openingshigh = count;
+}
+
+
+//
+// R_ReportLimits
+// At exit, so that the pools can be sized for the levels played.
+//
+static void R_ReportLimits (void)
+{
+    printf ("R_ReportLimits: most used in one frame, of allocated:\n");
+    printf ("  visplanes  %7i of %7i (vanilla %i)\n",
+	    visplaneshigh, numvisplanes, MAXVISPLANES);
+    printf ("  drawsegs   %7i of %7i (vanilla %i)\n",
+	    drawsegshigh, numdrawsegs, MAXDRAWSEGS);
+    printf ("  vissprites %7i of %7i (vanilla %i)\n",
+	    visspriteshigh, numvissprites, MAXVISSPRITES);
+    printf ("  openings   %7i of %7i (vanilla %i)\n",
+	    openingshigh, numopenings, MAXOPENINGS);
+}
+
+
+//
+// R_InitLimits
+//
+void R_InitLimits (void)
+{
+    //!
+    // @category video
+    //
+    // Let the visplane, drawseg, sprite and opening pools of the
+    // renderer grow as big as a level needs, instead of stopping
+    // with an error or leaving things out.  Not while a demo is
+    // being recorded or played back, since vanilla's overflows are
+    // part of what a demo plays back.  The most of each used in one
+    // frame is shown at exit.
+    //
+
+    if (!M_CheckParm ("-growlimits"))
+	return;
+
+    if (M_CheckParm ("-record") || M_CheckParm ("-playdemo")
+     || M_CheckParm ("-timedemo"))
+    {
+	printf ("R_InitLimits: -growlimits can't be used with demos, "
+		"ignored.\n");
+	return;
+    }
+
+    allowgrowth = true;
+    I_AtExit (R_ReportLimits, true);
+}
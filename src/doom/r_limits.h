@@ -0,0 +1,50 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Growing the renderer's fixed pools past the vanilla limits,
+//	with -growlimits.
+//
+
+
+#ifndef __R_LIMITS__
+#define __R_LIMITS__
+
+#include <stddef.h>
+
+#include "doomtype.h"
+
+// True if the pools may grow for the frame being drawn:
+//  with -growlimits, unless a demo is being recorded or played.
+//  Otherwise the vanilla limits apply, however big the pools are.
+extern boolean		growlimits;
+
+// Called by R_Init.
+void R_InitLimits (void);
+
+// Called by R_RenderPlayerView before the pools are cleared,
+//  and once everything has been drawn, to note the high-water marks.
+void R_StartLimits (void);
+void R_FinishLimits (void);
+
+// Returns a copy of a pool of *size elements, each elemsize bytes,
+//  with room for twice as many, and updates *size.  The old pool is
+//  left alone, so that pointers into it can be moved across before
+//  it is freed with R_FreePool.
+void *R_GrowPool (const void *pool, int *size, size_t elemsize);
+
+// Frees a pool left by R_GrowPool, unless it is fixedpool,
+//  the static array it started out as.
+void R_FreePool (void *pool, const void *fixedpool);
+
+#endif
@@ -29,11 +29,18 @@
 #include "doomdef.h"
 #include "d_loop.h"
 
+#include "i_timer.h"
+#include "m_argv.h"
 #include "m_bbox.h"
 #include "m_menu.h"
 
 #include "r_local.h"
+#include "r_simd.h"
 #include "r_sky.h"
+#include "r_stats.h"
+#include "r_limits.h"
+#include "r_pvs.h"
+#include "r_thread.h"
 
 
 
@@ -112,6 +119,20 @@ void (*fuzzcolfunc) (void);
 void (*transcolfunc) (void);
 void (*spanfunc) (void);
 
+// Draw the view into a column-major buffer (-columnmajor).
+boolean			columnmajor;
+
+// True if the view is being drawn column-major this frame.
+//  Only in high detail.
+static boolean		drawcolumnmajor;
+
+// Time spent in R_RenderPlayerView, split by the layout drawn
+//  to, for the -timedemo report.
+static boolean		viewtiming;
+static uint64_t		viewtime[2];
+static int		viewframes[2];
+static uint64_t		drawsegvisitstotal;
+
 
 
 //
@@ -661,6 +682,47 @@ R_SetViewSize
 }
 
 
+//
+// R_SetDrawFunctions
+// Picks the drawers for the detail level
+//  and the layout of the view buffer.
+//
+static void R_SetDrawFunctions (void)
+{
+    if (detailshift)
+    {
+	colfunc = basecolfunc = R_DrawColumnLow;
+	fuzzcolfunc = R_DrawFuzzColumnLow;
+	transcolfunc = R_DrawTranslatedColumnLow;
+	spanfunc = R_DrawSpanLow;
+    }
+    else if (drawcolumnmajor)
+    {
+	colfunc = basecolfunc = R_DrawColumnCM;
+	fuzzcolfunc = R_DrawFuzzColumnCM;
+	transcolfunc = R_DrawTranslatedColumnCM;
+	spanfunc = R_DrawSpanCM;
+    }
+    else
+    {
+	colfunc = basecolfunc = R_DrawColumn;
+	fuzzcolfunc = R_DrawFuzzColumn;
+	transcolfunc = R_DrawTranslatedColumn;
+	spanfunc = R_DrawSpan;
+
+	// Use the vector versions if the CPU can.
+	if (drawkernels != NULL)
+	{
+	    colfunc = basecolfunc = R_DrawColumnVector;
+	    spanfunc = R_DrawSpanVector;
+	}
+    }
+
+    R_SetupThreadedDrawers ();
+    R_SetupStatsDrawers ();
+}
+
+
 //
 // R_ExecuteSetViewSize
 //
@@ -675,6 +737,9 @@ void R_ExecuteSetViewSize (void)
 
     setsizeneeded = false;
 
+    // Anything being drawn is for the old size.
+    R_DropPipelinedView ();
+
     if (setblocks == 11)
     {
 	scaledviewwidth = SCREENWIDTH;
@@ -695,20 +760,10 @@ void R_ExecuteSetViewSize (void)
     centeryfrac = centery<<FRACBITS;
     projection = centerxfrac;
 
-    if (!detailshift)
-    {
-	colfunc = basecolfunc = R_DrawColumn;
-	fuzzcolfunc = R_DrawFuzzColumn;
-	transcolfunc = R_DrawTranslatedColumn;
-	spanfunc = R_DrawSpan;
-    }
-    else
-    {
-	colfunc = basecolfunc = R_DrawColumnLow;
-	fuzzcolfunc = R_DrawFuzzColumnLow;
-	transcolfunc = R_DrawTranslatedColumnLow;
-	spanfunc = R_DrawSpanLow;
-    }
+    // Not with -pipeline, as the buffer would be in use
+    //  by two frames at once.
+    drawcolumnmajor = columnmajor && !detailshift && !renderpipeline;
+    R_SetDrawFunctions ();
 
     R_InitBuffer (scaledviewwidth, viewheight);
 	
@@ -782,6 +837,24 @@ void R_Init (void)
     R_InitSkyMap ();
     R_InitTranslationTables ();
     printf (".");
+    R_InitDrawKernels ();
+    R_InitRenderThreads ();
+    R_InitRenderStats ();
+    R_InitPVS ();
+    R_InitLimits ();
+    R_InitPrecache ();
+
+    //!
+    // @category video
+    //
+    // Draw the 3D view into a column-major buffer, so that wall and
+    // sprite columns are written to consecutive bytes, and transpose
+    // it onto the screen afterwards. High detail only. With
+    // -timedemo, frames alternate between this and the normal
+    // layout and the time taken by each is reported.
+    //
+
+    columnmajor = M_CheckParm ("-columnmajor") > 0;
 	
     framecount = 0;
 }
@@ -860,11 +933,25 @@ void R_SetupFrame (player_t* player)
 //
 // R_RenderView
 //
-void R_RenderPlayerView (player_t* player)
-{	
+//
+// R_DrawView
+// Everything but showing the view,
+//  with or without the visible sets.
+//
+static void R_DrawView (player_t* player, boolean withpvs)
+{
     R_SetupFrame (player);
 
+    if (withpvs)
+	R_MarkPVS ();
+    else
+	pvsinuse = false;
+
+    if (drawcolumnmajor)
+	R_StartColumnMajorView ();
+
     // Clear buffers.
+    R_StartLimits ();
     R_ClearClipSegs ();
     R_ClearDrawSegs ();
     R_ClearPlanes ();
@@ -885,7 +972,163 @@ void R_RenderPlayerView (player_t* player)
     NetUpdate ();
     
     R_DrawMasked ();
+    R_FinishLimits ();
+}
+
+
+void R_RenderPlayerView (player_t* player)
+{	
+    uint64_t	starttime = 0;
+    uint64_t	elapsed = 0;
+    boolean	shown = false;
+    boolean	checkpvs;
+    int		startfuzzpos;
+    int		startframecount;
+    int		startvalidcount;
+    int		i;
+
+    // Pick up any textures composited in the background.
+    R_UpdatePrecache ();
+
+    // Show the last frame, before recording over it.
+    if (renderpipeline)
+	shown = R_FinishPipelinedView ();
+
+    // With -pvscheck, draw the view without the visible sets
+    //  first, to check that they make no difference.
+    // The pipelined view isn't drawn until later, and the
+    //  column-major one keeps what it drew last time.
+    checkpvs = pvscheck && !renderpipeline && !columnmajor;
+
+    if (checkpvs)
+    {
+	// The fuzz carries on from one frame to the next,
+	//  so start both from the same place.  R_SetupFrame
+	//  counts the frame, so count it only once.
+	startfuzzpos = fuzzpos;
+	startframecount = framecount;
+	startvalidcount = validcount;
+
+	R_StartPVSCheck ();
+	R_DrawView (player, false);
+	R_FlushDrawCommands ();
+	R_HashPVSReference ();
+
+	// The sectors R_AddSprites marked would be skipped
+	//  when validcount comes round to the same value.
+	for (i=0 ; i<numsectors ; i++)
+	{
+	    if (sectors[i].validcount == validcount)
+		sectors[i].validcount = startvalidcount;
+	}
+
+	fuzzpos = startfuzzpos;
+	framecount = startframecount;
+	validcount = startvalidcount;
+    }
+
+    if (viewtiming)
+    {
+	// Take turns at the two layouts, so that
+	//  both are timed over the same demo.
+	if (columnmajor && !detailshift && !renderpipeline)
+	{
+	    drawcolumnmajor = !drawcolumnmajor;
+	    R_SetDrawFunctions ();
+	}
+
+	starttime = I_GetTimeUS ();
+    }
+
+    if (renderstats)
+	R_StartFrameStats ();
+
+    R_DrawView (player, true);
+
+    // Finish off anything left to the drawing threads.
+    if (renderpipeline)
+    {
+	R_StartPipelinedView ();
+
+	// Nothing to show yet, so this frame can't wait.
+	if (!shown)
+	    R_FinishPipelinedView ();
+    }
+    else
+	R_FlushDrawCommands ();
+
+    if (checkpvs)
+	R_FinishPVSCheck ();
+
+    if (drawcolumnmajor)
+	R_FinishColumnMajorView ();
+
+    if (viewtiming)
+    {
+	elapsed = I_GetTimeUS () - starttime;
+	viewtime[drawcolumnmajor] += elapsed;
+	++viewframes[drawcolumnmajor];
+	drawsegvisitstotal += drawsegvisitsavoided;
+    }
+
+    if (renderstats)
+	R_FinishFrameStats (elapsed);
 
     // Check for new console commands.
     NetUpdate ();				
 }
+
+
+//
+// R_StartViewTiming
+//
+void R_StartViewTiming (void)
+{
+    viewtiming = true;
+    viewtime[0] = viewtime[1] = 0;
+    viewframes[0] = viewframes[1] = 0;
+    visplaneprobessaved = 0;
+    drawsegvisitstotal = 0;
+    R_StartStatsLog ();
+}
+
+
+//
+// R_PrintViewTiming
+//
+void R_PrintViewTiming (void)
+{
+    static const char *layouts[2] = { "row-major", "column-major" };
+    double	ms[2];
+    int		i;
+
+    for (i=0 ; i<2 ; i++)
+    {
+	ms[i] = 0;
+
+	if (viewframes[i] == 0)
+	    continue;
+
+	ms[i] = viewtime[i] / (viewframes[i] * 1000.0);
+	printf ("R_RenderPlayerView: %i %s frames, %.3f ms per frame\n",
+		viewframes[i], layouts[i], ms[i]);
+    }
+
+    if (viewframes[0] > 0 && viewframes[1] > 0)
+    {
+	printf ("R_RenderPlayerView: column-major is %.3f ms per frame "
+		"(%+.1f%%) against row-major\n",
+		ms[1] - ms[0], (ms[1] - ms[0]) * 100.0 / ms[0]);
+    }
+
+    printf ("R_FindPlane: %" PRId64 " visplane comparisons saved "
+	    "by hashing\n", visplaneprobessaved);
+
+    if (viewframes[0] + viewframes[1] > 0)
+    {
+	printf ("R_DrawSprite: %.1f drawseg visits avoided per frame\n",
+		(double) drawsegvisitstotal / (viewframes[0] + viewframes[1]));
+    }
+
+    R_StopStatsLog ();
+}
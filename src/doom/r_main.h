@@ -157,4 +157,13 @@ void R_Init (void);
 // Called by M_Responder.
 void R_SetViewSize (int blocks, int detail);
 
+// Set by -columnmajor.
+extern boolean	columnmajor;
+
+// Called by G_TimeDemo, to time the drawing of each view.
+void R_StartViewTiming (void);
+
+// Called at the end of a timedemo.
+void R_PrintViewTiming (void);
+
 #endif
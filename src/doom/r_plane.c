@@ -23,6 +23,8 @@
 #include <stdlib.h>
 
 #include "i_system.h"
+#include "i_thread.h"
+#include "m_argv.h"
 #include "z_zone.h"
 #include "w_wad.h"
 
@@ -30,7 +32,10 @@
 #include "doomstat.h"
 
 #include "r_local.h"
+#include "r_limits.h"
 #include "r_sky.h"
+#include "r_stats.h"
+#include "r_thread.h"
 
 
 
@@ -42,17 +47,55 @@ planefunction_t		ceilingfunc;
 //
 
 // Here comes the obnoxious "visplane".
-#define MAXVISPLANES	128
-visplane_t		visplanes[MAXVISPLANES];
+// With -growlimits, visplanes can be moved to a bigger copy
+//  by R_GrowVisplanes, which moves every pointer into them.
+static visplane_t	fixedvisplanes[MAXVISPLANES];
+visplane_t*		visplanes = fixedvisplanes;
 visplane_t*		lastvisplane;
+int			numvisplanes = MAXVISPLANES;
 visplane_t*		floorplane;
 visplane_t*		ceilingplane;
 
+// Hash chains of visplanes by height, picnum and lightlevel,
+//  so R_FindPlane need not scan every visplane in the frame.
+// Only the first visplane made for each key is in its chain,
+//  since that is the one a scan of visplanes[] would find.
+#define VISPLANEHASHSIZE	128
+#define VISPLANEHASH(h,p,l)	\
+	((unsigned) (((h)>>FRACBITS)*7 + (p)*3 + (l)) & (VISPLANEHASHSIZE-1))
+
+static visplane_t*	visplanehash[VISPLANEHASHSIZE];
+static visplane_t*	fixedvisplanehashnext[MAXVISPLANES];
+static visplane_t**	visplanehashnext = fixedvisplanehashnext;
+
+// How many visplanes this frame may use.
+static int		maxvisplanes;
+
+// Comparisons the plain scan would have made, less those
+//  made walking the hash chains.  A chain can be longer
+//  than the scan, so this can go below zero.
+int64_t			visplaneprobessaved;
+
 // ?
-#define MAXOPENINGS	SCREENWIDTH*64
 short			openings[MAXOPENINGS];
 short*			lastopening;
 
+// With -growlimits, more blocks of openings are chained on when
+//  one fills up, since drawsegs point into them.  Each is twice
+//  the size of the one before, and they are kept for later frames.
+#define MAXOPENINGBLOCKS	16
+
+static short*		openingblocks[MAXOPENINGBLOCKS] = { openings };
+static int		openingblocksizes[MAXOPENINGBLOCKS] = { MAXOPENINGS };
+static int		numopeningblocks = 1;
+int			numopenings = MAXOPENINGS;
+
+// The block being filled, where it ends,
+//  and the openings used in the blocks before it.
+static int		openingblock;
+static short*		openingsend;
+static int		openingsdone;
+
 
 //
 // Clip values are the solid pixel bounding the range.
@@ -66,34 +109,111 @@ short			ceilingclip[SCREENWIDTH];
 // spanstart holds the start of a plane span
 // initialized to 0 at start
 //
-int			spanstart[SCREENHEIGHT];
+// This and the texture mapping state below are per thread,
+//  since with -planethreads each worker draws planes too.
+//
+THREADLOCAL int		spanstart[SCREENHEIGHT];
 int			spanstop[SCREENHEIGHT];
 
 //
 // texture mapping
 //
-lighttable_t**		planezlight;
-fixed_t			planeheight;
+THREADLOCAL lighttable_t**	planezlight;
+THREADLOCAL fixed_t		planeheight;
 
 fixed_t			yslope[SCREENHEIGHT];
 fixed_t			distscale[SCREENWIDTH];
 fixed_t			basexscale;
 fixed_t			baseyscale;
 
-fixed_t			cachedheight[SCREENHEIGHT];
-fixed_t			cacheddistance[SCREENHEIGHT];
-fixed_t			cachedxstep[SCREENHEIGHT];
-fixed_t			cachedystep[SCREENHEIGHT];
+THREADLOCAL fixed_t	cachedheight[SCREENHEIGHT];
+THREADLOCAL fixed_t	cacheddistance[SCREENHEIGHT];
+THREADLOCAL fixed_t	cachedxstep[SCREENHEIGHT];
+THREADLOCAL fixed_t	cachedystep[SCREENHEIGHT];
+
+//
+// The band of rows this thread draws planes into.
+// Everything, unless planes are being drawn in parallel.
+//
+static THREADLOCAL int	planetop = 0;
+static THREADLOCAL int	planebottom = SCREENHEIGHT-1;
+
+//
+// Parallel plane drawing, with -planethreads.
+// The view is cut into bands of rows, and each band draws
+//  every visplane in order, keeping only its own rows.
+//  So each pixel is written exactly as in a plain frame.
+//
+static boolean		planethreads = false;
+static int		numplanebands;
+static thread_batch_t*	planebatch;
+
+// What the bands need of each visplane.
+// Looked up on the main thread, since the zone is not thread safe.
+typedef struct
+{
+    byte*	source;
+    int		top;		// rows covered, so bands can skip it
+    int		bottom;
+} planework_t;
+
+static planework_t	fixedplanework[MAXVISPLANES];
+static planework_t*	planework = fixedplanework;
+static byte*		skycolumn[SCREENWIDTH];
 
 
 
+//
+// PurgeHook
+// The planes being drawn point into cached lumps,
+//  so they must be finished before any of the cache is thrown out.
+//
+static void PurgeHook (void)
+{
+    R_FinishPlanes ();
+}
+
+
 //
 // R_InitPlanes
 // Only at game startup.
 //
 void R_InitPlanes (void)
 {
-  // Doh!
+    int		p;
+    int		threads;
+
+    //!
+    // @arg <n>
+    // @category video
+    //
+    // Draw floors, ceilings and sky using n threads, each drawing
+    // a band of rows, while the main thread gets on with setting up
+    // the sprites.  If n is 0, one thread is used for each CPU.  Not
+    // used together with -renderthreads, which already draws the
+    // planes on multiple threads.
+    //
+
+    p = M_CheckParmWithArgs ("-planethreads", 1);
+
+    if (!p)
+	return;
+
+    threads = atoi (myargv[p + 1]);
+
+    if (threads <= 0)
+	threads = I_GetNumCPUs ();
+
+    if (threads <= 1)
+	return;
+
+    I_InitThreadPool (threads - 1);
+
+    numplanebands = I_ThreadPoolSize () * 2;
+    planethreads = I_ThreadPoolSize () > 1;
+
+    if (planethreads)
+	Z_AddPurgeHook (PurgeHook);
 }
 
 
@@ -131,6 +251,10 @@ R_MapPlane
     }
 #endif
 
+    // Another thread's rows?
+    if (y < planetop || y > planebottom)
+	return;
+
     if (planeheight != cachedheight[y])
     {
 	cachedheight[y] = planeheight;
@@ -188,7 +312,14 @@ void R_ClearPlanes (void)
     }
 
     lastvisplane = visplanes;
+    maxvisplanes = growlimits ? numvisplanes : MAXVISPLANES;
+
     lastopening = openings;
+    openingblock = 0;
+    openingsend = openings + MAXOPENINGS;
+    openingsdone = 0;
+
+    memset (visplanehash, 0, sizeof(visplanehash));
     
     // texture calculation
     memset (cachedheight, 0, sizeof(cachedheight));
@@ -204,6 +335,73 @@ void R_ClearPlanes (void)
 
 
 
+//
+// MovePlane
+//
+static visplane_t*
+MovePlane
+( visplane_t*	pl,
+  visplane_t*	newplanes )
+{
+    if (pl == NULL)
+	return NULL;
+
+    return newplanes + (pl - visplanes);
+}
+
+
+//
+// R_GrowVisplanes
+// Doubles the visplanes with -growlimits, moving the hash chains,
+//  the floor and ceiling planes and *pl across.
+//  False if they can't grow this frame.
+//
+static boolean R_GrowVisplanes (visplane_t** pl)
+{
+    visplane_t*		newplanes;
+    visplane_t**	newhashnext;
+    planework_t*	newwork;
+    int			count;
+    int			size;
+    int			i;
+
+    if (!growlimits)
+	return false;
+
+    count = lastvisplane - visplanes;
+
+    size = numvisplanes;
+    newhashnext = R_GrowPool (visplanehashnext, &size, sizeof(*newhashnext));
+    size = numvisplanes;
+    newwork = R_GrowPool (planework, &size, sizeof(*newwork));
+    newplanes = R_GrowPool (visplanes, &numvisplanes, sizeof(*newplanes));
+
+    for (i=0 ; i<VISPLANEHASHSIZE ; i++)
+	visplanehash[i] = MovePlane (visplanehash[i], newplanes);
+
+    for (i=0 ; i<count ; i++)
+	newhashnext[i] = MovePlane (newhashnext[i], newplanes);
+
+    floorplane = MovePlane (floorplane, newplanes);
+    ceilingplane = MovePlane (ceilingplane, newplanes);
+
+    if (pl != NULL)
+	*pl = MovePlane (*pl, newplanes);
+
+    R_FreePool (visplanehashnext, fixedvisplanehashnext);
+    R_FreePool (planework, fixedplanework);
+    R_FreePool (visplanes, fixedvisplanes);
+
+    visplanehashnext = newhashnext;
+    planework = newwork;
+    visplanes = newplanes;
+    lastvisplane = visplanes + count;
+    maxvisplanes = numvisplanes;
+
+    return true;
+}
+
+
 //
 // R_FindPlane
 //
@@ -214,31 +412,43 @@ R_FindPlane
   int		lightlevel )
 {
     visplane_t*	check;
+    unsigned	hash;
+    int		probes;
 	
     if (picnum == skyflatnum)
     {
 	height = 0;			// all skys map together
 	lightlevel = 0;
     }
-	
-    for (check=visplanes; check<lastvisplane; check++)
+
+    hash = VISPLANEHASH (height, picnum, lightlevel);
+    probes = 0;
+
+    for (check = visplanehash[hash];
+	 check != NULL;
+	 check = visplanehashnext[check - visplanes])
     {
+	probes++;
+
 	if (height == check->height
 	    && picnum == check->picnum
 	    && lightlevel == check->lightlevel)
 	{
-	    break;
+	    visplaneprobessaved += (check - visplanes) + 1 - probes;
+	    return check;
 	}
     }
-    
-			
-    if (check < lastvisplane)
-	return check;
+
+    visplaneprobessaved += (lastvisplane - visplanes) - probes;
 		
-    if (lastvisplane - visplanes == MAXVISPLANES)
+    if (lastvisplane - visplanes == maxvisplanes
+     && !R_GrowVisplanes (NULL))
 	I_Error ("R_FindPlane: no more visplanes");
 		
-    lastvisplane++;
+    check = lastvisplane++;
+
+    visplanehashnext[check - visplanes] = visplanehash[hash];
+    visplanehash[hash] = check;
 
     check->height = height;
     check->picnum = picnum;
@@ -303,11 +513,14 @@ R_CheckPlane
     }
 	
     // make a new visplane
+    if (lastvisplane - visplanes == maxvisplanes)
+	R_GrowVisplanes (&pl);
+
     lastvisplane->height = pl->height;
     lastvisplane->picnum = pl->picnum;
     lastvisplane->lightlevel = pl->lightlevel;
     
-    if (lastvisplane - visplanes == MAXVISPLANES)
+    if (lastvisplane - visplanes == maxvisplanes)
 	I_Error ("R_CheckPlane: no more visplanes");
 
     pl = lastvisplane++;
@@ -320,6 +533,46 @@ R_CheckPlane
 }
 
 
+//
+// R_CheckOpenings
+// With -growlimits, moves on to the next block of openings
+//  unless there is room for count more in this one.
+//
+void R_CheckOpenings (int count)
+{
+    if (!growlimits || openingsend - lastopening >= count)
+	return;
+
+    openingsdone += lastopening - openingblocks[openingblock];
+    openingblock++;
+
+    if (openingblock == numopeningblocks)
+    {
+	if (numopeningblocks == MAXOPENINGBLOCKS)
+	    I_Error ("R_CheckOpenings: no more openings");
+
+	openingblocksizes[openingblock] = openingblocksizes[openingblock-1]*2;
+	openingblocks[openingblock] =
+	    Z_Malloc (openingblocksizes[openingblock] * sizeof(short),
+		      PU_STATIC, NULL);
+	numopenings += openingblocksizes[openingblock];
+	numopeningblocks++;
+    }
+
+    lastopening = openingblocks[openingblock];
+    openingsend = lastopening + openingblocksizes[openingblock];
+}
+
+
+//
+// R_OpeningsUsed
+//
+int R_OpeningsUsed (void)
+{
+    return openingsdone + (lastopening - openingblocks[openingblock]);
+}
+
+
 //
 // R_MakeSpans
 //
@@ -356,6 +609,221 @@ R_MakeSpans
 
 
 
+//
+// R_DrawSkyPlane
+// Sky columns come from skycolumn if given,
+//  otherwise straight from the sky texture.
+//
+static void
+R_DrawSkyPlane
+( visplane_t*	pl,
+  byte**	columns )
+{
+    int		x;
+    int		angle;
+
+    dc_iscale = pspriteiscale>>detailshift;
+    
+    // Sky is allways drawn full bright,
+    //  i.e. colormaps[0] is used.
+    // Because of this hack, sky is not affected
+    //  by INVUL inverse mapping.
+    dc_colormap = colormaps;
+    dc_texturemid = skytexturemid;
+    for (x=pl->minx ; x <= pl->maxx ; x++)
+    {
+	dc_yl = pl->top[x];
+	dc_yh = pl->bottom[x];
+
+	// Keep to this thread's rows.
+	// The drawers step from dc_yl, so this is exact.
+	if (dc_yl < planetop)
+	    dc_yl = planetop;
+	if (dc_yh > planebottom)
+	    dc_yh = planebottom;
+
+	if (dc_yl <= dc_yh)
+	{
+	    dc_x = x;
+
+	    if (columns != NULL)
+		dc_source = columns[x];
+	    else
+	    {
+		angle = (viewangle + xtoviewangle[x])>>ANGLETOSKYSHIFT;
+		dc_source = R_GetColumn(skytexture, angle);
+	    }
+
+	    colfunc ();
+	}
+    }
+}
+
+
+//
+// R_DrawFlatPlane
+// The plane's edges must already be marked.
+//
+static void
+R_DrawFlatPlane
+( visplane_t*	pl,
+  byte*		source )
+{
+    int		light;
+    int		x;
+    int		stop;
+
+    ds_source = source;
+	
+    planeheight = abs(pl->height-viewz);
+    light = (pl->lightlevel >> LIGHTSEGSHIFT)+extralight;
+
+    if (light >= LIGHTLEVELS)
+	light = LIGHTLEVELS-1;
+
+    if (light < 0)
+	light = 0;
+
+    planezlight = zlight[light];
+
+    stop = pl->maxx + 1;
+
+    for (x=pl->minx ; x<= stop ; x++)
+    {
+	R_MakeSpans(x,pl->top[x-1],
+		    pl->bottom[x-1],
+		    pl->top[x],
+		    pl->bottom[x]);
+    }
+}
+
+
+//
+// DrawPlaneBand
+// Draws one band of rows of every visplane.
+//
+static void DrawPlaneBand (void* data, int band)
+{
+    visplane_t*		pl;
+    planework_t*	work;
+    int			y;
+
+    planetop = (band * viewheight) / numplanebands;
+    planebottom = ((band + 1) * viewheight) / numplanebands - 1;
+
+    // This thread's cache may be from another frame.
+    for (y=planetop ; y<=planebottom ; y++)
+	cachedheight[y] = 0;
+
+    for (pl = visplanes ; pl < lastvisplane ; pl++)
+    {
+	work = &planework[pl - visplanes];
+
+	// Empty, or none of its rows are in this band?
+	if (work->top > planebottom || work->bottom < planetop)
+	    continue;
+
+	if (pl->picnum == skyflatnum)
+	    R_DrawSkyPlane (pl, skycolumn);
+	else
+	    R_DrawFlatPlane (pl, work->source);
+    }
+
+    // The main thread draws bands too, while it waits in
+    //  I_FinishBatch, and may draw a later frame's planes itself.
+    planetop = 0;
+    planebottom = SCREENHEIGHT-1;
+}
+
+
+//
+// R_StartPlaneThreads
+// Looks up everything the planes need from the zone,
+//  then hands the bands to the thread pool.
+//
+static void R_StartPlaneThreads (void)
+{
+    visplane_t*		pl;
+    planework_t*	work;
+    boolean		sky;
+    int			x;
+    int			angle;
+
+    sky = false;
+
+    for (pl = visplanes ; pl < lastvisplane ; pl++)
+    {
+	work = &planework[pl - visplanes];
+	work->top = SCREENHEIGHT;
+	work->bottom = -1;
+
+	// Once here, rather than by every band.
+	for (x=pl->minx ; x<=pl->maxx ; x++)
+	{
+	    if (pl->top[x] > pl->bottom[x])
+		continue;
+
+	    if (pl->top[x] < work->top)
+		work->top = pl->top[x];
+	    if (pl->bottom[x] > work->bottom)
+		work->bottom = pl->bottom[x];
+	}
+
+	if (work->top > work->bottom)
+	    continue;
+
+	if (pl->picnum == skyflatnum)
+	{
+	    sky = true;
+	    continue;
+	}
+
+	work->source =
+	    W_CacheLumpNum(firstflat + flattranslation[pl->picnum],
+			   PU_STATIC);
+
+	pl->top[pl->maxx+1] = 0xff;
+	pl->top[pl->minx-1] = 0xff;
+    }
+
+    if (sky)
+    {
+	for (x=0 ; x<viewwidth ; x++)
+	{
+	    angle = (viewangle + xtoviewangle[x])>>ANGLETOSKYSHIFT;
+	    skycolumn[x] = R_GetColumn(skytexture, angle);
+	}
+    }
+
+    planebatch = I_StartBatch (DrawPlaneBand, NULL, numplanebands, true);
+}
+
+
+//
+// R_FinishPlanes
+// Waits for the planes started by R_DrawPlanes.
+//
+void R_FinishPlanes (void)
+{
+    visplane_t*		pl;
+    planework_t*	work;
+
+    if (planebatch == NULL)
+	return;
+
+    I_FinishBatch (planebatch);
+    planebatch = NULL;
+
+    for (pl = visplanes ; pl < lastvisplane ; pl++)
+    {
+	work = &planework[pl - visplanes];
+
+	if (work->top <= work->bottom && pl->picnum != skyflatnum)
+	    W_ReleaseLumpNum(firstflat + flattranslation[pl->picnum]);
+    }
+}
+
+
 //
 // R_DrawPlanes
 // At the end of each frame.
@@ -363,26 +831,30 @@ R_MakeSpans
 void R_DrawPlanes (void)
 {
     visplane_t*		pl;
-    int			light;
-    int			x;
-    int			stop;
-    int			angle;
     int                 lumpnum;
 				
 #ifdef RANGECHECK
-    if (ds_p - drawsegs > MAXDRAWSEGS)
+    if (ds_p - drawsegs > numdrawsegs)
 	I_Error ("R_DrawPlanes: drawsegs overflow (%" PRIiPTR ")",
 		 ds_p - drawsegs);
     
-    if (lastvisplane - visplanes > MAXVISPLANES)
+    if (lastvisplane - visplanes > numvisplanes)
 	I_Error ("R_DrawPlanes: visplane overflow (%" PRIiPTR ")",
 		 lastvisplane - visplanes);
     
-    if (lastopening - openings > MAXOPENINGS)
+    if (!openingblock && lastopening - openings > MAXOPENINGS)
 	I_Error ("R_DrawPlanes: opening overflow (%" PRIiPTR ")",
 		 lastopening - openings);
 #endif
 
+    // With -renderthreads, the drawers only record what to draw.
+    // The counters for -renderstats are only kept on this thread.
+    if (planethreads && !renderthreads && !renderstats)
+    {
+	R_StartPlaneThreads ();
+	return;
+    }
+
     for (pl = visplanes ; pl < lastvisplane ; pl++)
     {
 	if (pl->minx > pl->maxx)
@@ -392,57 +864,17 @@ void R_DrawPlanes (void)
 	// sky flat
 	if (pl->picnum == skyflatnum)
 	{
-	    dc_iscale = pspriteiscale>>detailshift;
-	    
-	    // Sky is allways drawn full bright,
-	    //  i.e. colormaps[0] is used.
-	    // Because of this hack, sky is not affected
-	    //  by INVUL inverse mapping.
-	    dc_colormap = colormaps;
-	    dc_texturemid = skytexturemid;
-	    for (x=pl->minx ; x <= pl->maxx ; x++)
-	    {
-		dc_yl = pl->top[x];
-		dc_yh = pl->bottom[x];
-
-		if (dc_yl <= dc_yh)
-		{
-		    angle = (viewangle + xtoviewangle[x])>>ANGLETOSKYSHIFT;
-		    dc_x = x;
-		    dc_source = R_GetColumn(skytexture, angle);
-		    colfunc ();
-		}
-	    }
+	    R_DrawSkyPlane (pl, NULL);
 	    continue;
 	}
 	
 	// regular flat
         lumpnum = firstflat + flattranslation[pl->picnum];
-	ds_source = W_CacheLumpNum(lumpnum, PU_STATIC);
-	
-	planeheight = abs(pl->height-viewz);
-	light = (pl->lightlevel >> LIGHTSEGSHIFT)+extralight;
-
-	if (light >= LIGHTLEVELS)
-	    light = LIGHTLEVELS-1;
-
-	if (light < 0)
-	    light = 0;
-
-	planezlight = zlight[light];
 
 	pl->top[pl->maxx+1] = 0xff;
 	pl->top[pl->minx-1] = 0xff;
-		
-	stop = pl->maxx + 1;
 
-	for (x=pl->minx ; x<= stop ; x++)
-	{
-	    R_MakeSpans(x,pl->top[x-1],
-			pl->bottom[x-1],
-			pl->top[x],
-			pl->bottom[x]);
-	}
+	R_DrawFlatPlane (pl, W_CacheLumpNum(lumpnum, PU_STATIC));
 	
         W_ReleaseLumpNum(lumpnum);
     }
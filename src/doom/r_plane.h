@@ -26,7 +26,17 @@
 
 
 // Visplane related.
+// The vanilla sizes of the pools,
+//  which can grow past them with -growlimits.
+#define MAXVISPLANES	128
+#define MAXOPENINGS	SCREENWIDTH*64
+
 extern  short*		lastopening;
+extern  int		numopenings;
+
+extern visplane_t*	visplanes;
+extern visplane_t*	lastvisplane;
+extern int		numvisplanes;
 
 
 typedef void (*planefunction_t) (int top, int bottom);
@@ -40,6 +50,9 @@ extern short		ceilingclip[SCREENWIDTH];
 extern fixed_t		yslope[SCREENHEIGHT];
 extern fixed_t		distscale[SCREENWIDTH];
 
+// Visplane comparisons saved by hashing, for -timedemo.
+extern int64_t		visplaneprobessaved;
+
 void R_InitPlanes (void);
 void R_ClearPlanes (void);
 
@@ -57,7 +70,14 @@ R_MakeSpans
   int		t2,
   int		b2 );
 
+// With -planethreads, this only starts the planes
+//  drawing, and R_FinishPlanes waits for them.
+// Called before taking count openings from lastopening.
+void R_CheckOpenings (int count);
+int R_OpeningsUsed (void);
+
 void R_DrawPlanes (void);
+void R_FinishPlanes (void);
 
 visplane_t*
 R_FindPlane
@@ -0,0 +1,1505 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Potentially visible sets of subsectors, with -pvs.
+//
+//	For each subsector, the set of subsectors that could be seen
+//	from anywhere inside it, looking through two-sided lines and
+//	ignoring heights, so that doors and lifts can do as they
+//	please.  The BSP walk skips whatever is outside the set of the
+//	subsector the view is in.  Nothing out there has a seg that
+//	is not hidden behind one-sided walls, which the walk would
+//	have clipped away anyway, so the frame is the same.
+//
+//	Sprites can stick out of their sectors, so subsectors out of
+//	sight that have things in their sector are still walked to,
+//	just to add the sprites, in exactly the same way as before.
+//
+//	The sets are found much as in Quake's vis.  The partition
+//	lines of the BSP are cut into portals between the convex
+//	cells on either side, trimmed to the part of each cell inside
+//	its segs, and lines of sight are followed through each portal
+//	and on through the portals beyond it, narrowing at each step
+//	to what can still be seen through all of them.  That runs on
+//	one thread per CPU, and the results are kept in the pvs
+//	directory of the configuration directory under a hash of the
+//	map, so it only has to be done once for each map.
+//
+//	The picture is the same, but the limits are not: subsectors
+//	out of sight don't get visplanes, so fewer are used, and a
+//	view that would stop with "no more visplanes" may not.
+//	-pvscheck draws each view both with and without the sets and
+//	compares hashes of the two.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "i_system.h"
+#include "i_thread.h"
+#include "i_timer.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "m_bbox.h"
+#include "m_config.h"
+#include "m_misc.h"
+#include "sha1.h"
+#include "w_wad.h"
+#include "xxhash.h"
+#include "z_zone.h"
+
+#include "doomdata.h"
+#include "r_local.h"
+#include "r_pvs.h"
+
+// Bumped whenever the sets found for a map might change.
+#define PVS_VERSION		1
+
+// The largest level that -pvs is used on.  The sets take
+//  numsubsectors squared bits, and working them out takes two
+//  sets for each portal.
+#define MAXPVSSUBSECTORS	8192
+
+// How far, in map units, a seg may be off a line and still be
+//  taken to lie along it, as node builders round the vertices
+//  they add when they split segs.
+#define SEGSLACK		1.0
+
+// Slack when narrowing lines of sight, always on the side of
+//  seeing more.
+#define FLOWSLACK		0.01
+
+// Limits on following lines of sight through a portal.  Past
+//  them, everything its flood reached is taken to be visible.
+#define MAXFLOWSTEPS		(1 << 16)
+#define MAXFLOWDEPTH		1024
+
+typedef struct
+{
+    double	x;
+    double	y;
+} pvspoint_t;
+
+// The positive side of a line is where a*x + b*y >= c.
+typedef struct
+{
+    double	a;
+    double	b;
+    double	c;
+} pvsline_t;
+
+typedef struct
+{
+    pvspoint_t	p[2];
+} winding_t;
+
+typedef struct
+{
+    winding_t	w;
+
+    // Positive on the far side.
+    pvsline_t	line;
+
+    // The subsectors it leads out of and into.
+    int		from;
+    int		to;
+} portal_t;
+
+// A stretch of a partition line inside one subsector.
+typedef struct
+{
+    int		leaf;
+    double	t0;
+    double	t1;
+} pvsspan_t;
+
+typedef struct
+{
+    pvsspan_t*	spans;
+    int		numspans;
+    int		maxspans;
+} spanlist_t;
+
+// The state of following lines of sight through one portal.
+typedef struct
+{
+    byte*	row;
+    byte*	onpath;
+
+    // What might still be seen at each depth.
+    byte*	might;
+    int		maxdepth;
+
+    int		steps;
+    boolean	overflow;
+} flow_t;
+
+boolean			pvsinuse = false;
+byte*			pvsnodes;
+byte*			pvssubsectors;
+
+static boolean		usepvs = false;
+
+boolean			pvscheck = false;
+
+// With -pvscheck, the hash of the view drawn without the sets,
+//  and how many views have been checked.
+static uint64_t		referencehash;
+static int		viewschecked;
+static int		viewsdiffering;
+
+// Bit j of row i is set if subsector j might be seen from i.
+static byte*		pvs = NULL;
+static int		pvsrowbytes;
+
+static int*		nodeparent;
+static int*		subsectorparent;
+
+// Portals out of each subsector: those of subsector i are
+//  portals[firstportal[i]] to portals[firstportal[i+1]-1].
+static portal_t*	portals;
+static int		numportals;
+static int		maxportals;
+static int*		firstportal;
+
+// For each portal, the subsectors a line through it might reach,
+//  found by flooding through the portals beyond it, then those
+//  found by following lines of sight, once portaldone is set.
+static byte*		portalflood;
+static byte*		portalvis;
+static atomic_int_t*	portaldone;
+static int*		portalorder;
+
+static pvsline_t*	cellstack;
+static spanlist_t	frontspans;
+static spanlist_t	backspans;
+
+
+//
+// Geometry
+//
+static double Side (const pvsline_t *l, const pvspoint_t *p)
+{
+    return l->a * p->x + l->b * p->y - l->c;
+}
+
+// The line from (x,y) along (dx,dy), positive on the front side,
+//  as Doom has it: the right, looking along the line.
+static boolean
+MakeLine
+( pvsline_t*	l,
+  double	x,
+  double	y,
+  double	dx,
+  double	dy )
+{
+    double	len;
+
+    len = sqrt (dx*dx + dy*dy);
+
+    if (len < 1e-9)
+	return false;
+
+    l->a = dy / len;
+    l->b = -dx / len;
+    l->c = l->a * x + l->b * y;
+    return true;
+}
+
+static void FlipLine (pvsline_t *l)
+{
+    l->a = -l->a;
+    l->b = -l->b;
+    l->c = -l->c;
+}
+
+// A broken node, with no length, sends everything to the back.
+static pvsline_t NodeLine (const node_t *node)
+{
+    pvsline_t	l;
+
+    if (!MakeLine (&l, (double) node->x / FRACUNIT,
+		   (double) node->y / FRACUNIT,
+		   (double) node->dx / FRACUNIT,
+		   (double) node->dy / FRACUNIT))
+    {
+	l.a = l.b = 0;
+	l.c = 1;
+    }
+
+    return l;
+}
+
+static pvspoint_t VertexPoint (const vertex_t *v)
+{
+    pvspoint_t	p;
+
+    p.x = (double) v->x / FRACUNIT;
+    p.y = (double) v->y / FRACUNIT;
+    return p;
+}
+
+//
+// ClipWinding
+// Keeps the part of w within slack of the positive side of l.
+// Returns false if there is none.
+//
+static boolean
+ClipWinding
+( winding_t*		w,
+  const pvsline_t*	l,
+  double		slack )
+{
+    double	s0;
+    double	s1;
+    double	t;
+    int		out;
+
+    s0 = Side (l, &w->p[0]) + slack;
+    s1 = Side (l, &w->p[1]) + slack;
+
+    if (s0 >= 0 && s1 >= 0)
+	return true;
+
+    if (s0 < 0 && s1 < 0)
+	return false;
+
+    t = s0 / (s0 - s1);
+    out = s0 < 0 ? 0 : 1;
+
+    w->p[out].x = w->p[0].x + t * (w->p[1].x - w->p[0].x);
+    w->p[out].y = w->p[0].y + t * (w->p[1].y - w->p[0].y);
+    return true;
+}
+
+//
+// ClipToSeparators
+// Keeps the part of target that a line through source and then
+//  pass could reach.  Lines through an end of each, with the rest
+//  of source and pass on opposite sides, bound those.  Any line
+//  that is not clearly one of them is left out, which only lets
+//  more through.
+//
+static boolean
+ClipToSeparators
+( const winding_t*	source,
+  const winding_t*	pass,
+  winding_t*		target )
+{
+    const pvspoint_t*	s;
+    const pvspoint_t*	p;
+    pvsline_t		l;
+    double		ds;
+    double		dp;
+    int			i;
+    int			j;
+
+    for (i=0 ; i<2 ; i++)
+    {
+	for (j=0 ; j<2 ; j++)
+	{
+	    s = &source->p[i];
+	    p = &pass->p[j];
+
+	    if (!MakeLine (&l, s->x, s->y, p->x - s->x, p->y - s->y))
+		continue;
+
+	    ds = Side (&l, &source->p[!i]);
+	    dp = Side (&l, &pass->p[!j]);
+
+	    if (ds > FLOWSLACK && dp < -FLOWSLACK)
+		FlipLine (&l);
+	    else if (!(ds < -FLOWSLACK && dp > FLOWSLACK))
+		continue;
+
+	    if (!ClipWinding (target, &l, FLOWSLACK))
+		return false;
+	}
+    }
+
+    return true;
+}
+
+
+//
+// Portals
+//
+static void AddSpan (spanlist_t *list, int leaf, double t0, double t1)
+{
+    if (list->numspans == list->maxspans)
+    {
+	list->maxspans = list->maxspans ? list->maxspans * 2 : 64;
+	list->spans = I_Realloc (list->spans,
+				 list->maxspans * sizeof(*list->spans));
+    }
+
+    list->spans[list->numspans].leaf = leaf;
+    list->spans[list->numspans].t0 = t0;
+    list->spans[list->numspans].t1 = t1;
+    list->numspans++;
+}
+
+//
+// FilterSpan
+// Cuts the stretch t0 to t1 of the line from o along d between
+//  the subsectors under bspnum that it runs through.  If the line
+//  lies along a partition, it goes to the side given by normal,
+//  which points into the region being filtered.
+//
+static void
+FilterSpan
+( spanlist_t*		list,
+  int			bspnum,
+  const pvspoint_t*	o,
+  const pvspoint_t*	d,
+  const pvsline_t*	normal,
+  double		t0,
+  double		t1 )
+{
+    pvsline_t	l;
+    double	s0;
+    double	s1;
+    double	t;
+    int		first;
+    int		second;
+
+    while (!(bspnum & NF_SUBSECTOR))
+    {
+	l = NodeLine (&nodes[bspnum]);
+
+	s0 = l.a * (o->x + t0*d->x) + l.b * (o->y + t0*d->y) - l.c;
+	s1 = l.a * (o->x + t1*d->x) + l.b * (o->y + t1*d->y) - l.c;
+
+	if (fabs (s0) < 1e-6 && fabs (s1) < 1e-6)
+	{
+	    // Along the partition.
+	    if (l.a * normal->a + l.b * normal->b > 0)
+		bspnum = nodes[bspnum].children[0];
+	    else
+		bspnum = nodes[bspnum].children[1];
+	}
+	else if (s0 >= -1e-6 && s1 >= -1e-6)
+	    bspnum = nodes[bspnum].children[0];
+	else if (s0 <= 1e-6 && s1 <= 1e-6)
+	    bspnum = nodes[bspnum].children[1];
+	else
+	{
+	    t = t0 + (t1 - t0) * s0 / (s0 - s1);
+	    first = nodes[bspnum].children[s0 > 0 ? 0 : 1];
+	    second = nodes[bspnum].children[s0 > 0 ? 1 : 0];
+
+	    FilterSpan (list, first, o, d, normal, t0, t);
+	    FilterSpan (list, second, o, d, normal, t, t1);
+	    return;
+	}
+    }
+
+    AddSpan (list, bspnum & ~NF_SUBSECTOR, t0, t1);
+}
+
+static int CompareSpans (const void *a, const void *b)
+{
+    const pvsspan_t*	sa = a;
+    const pvsspan_t*	sb = b;
+
+    if (sa->t0 < sb->t0)
+	return -1;
+    if (sa->t0 > sb->t0)
+	return 1;
+    return 0;
+}
+
+static void
+AddPortal
+( const winding_t*	w,
+  const pvsline_t*	line,
+  int			from,
+  int			to )
+{
+    if (numportals == maxportals)
+    {
+	maxportals = maxportals ? maxportals * 2 : 1024;
+	portals = I_Realloc (portals, maxportals * sizeof(*portals));
+    }
+
+    portals[numportals].w = *w;
+    portals[numportals].line = *line;
+    portals[numportals].from = from;
+    portals[numportals].to = to;
+    numportals++;
+}
+
+//
+// ClipToSubsector
+// Keeps the part of w that is inside the segs of subsector num.
+//  Segs along w itself are left to CutOneSidedSegs: split segs
+//  are a little off the line they were split from, and the
+//  lines through them can cut across w a long way off.
+//
+static boolean ClipToSubsector (winding_t *w, int num)
+{
+    seg_t*	seg;
+    pvspoint_t	v1;
+    pvspoint_t	v2;
+    pvsline_t	along;
+    pvsline_t	l;
+    int		i;
+
+    if (!MakeLine (&along, w->p[0].x, w->p[0].y,
+		   w->p[1].x - w->p[0].x, w->p[1].y - w->p[0].y))
+	return false;
+
+    seg = &segs[subsectors[num].firstline];
+
+    for (i=0 ; i<subsectors[num].numlines ; i++, seg++)
+    {
+	v1 = VertexPoint (seg->v1);
+	v2 = VertexPoint (seg->v2);
+
+	if (fabs (Side (&along, &v1)) <= SEGSLACK
+	 && fabs (Side (&along, &v2)) <= SEGSLACK)
+	    continue;
+
+	if (MakeLine (&l, v1.x, v1.y, v2.x - v1.x, v2.y - v1.y)
+	 && !ClipWinding (w, &l, 0))
+	    return false;
+    }
+
+    return true;
+}
+
+//
+// CutOneSidedSegs
+// Takes out of the pieces of w, as distances along it, the parts
+//  covered by one-sided segs of subsector num that lie along it.
+//  Returns how many pieces are left.
+//
+#define MAXPIECES	16
+
+static int
+CutOneSidedSegs
+( const winding_t*	w,
+  int			num,
+  double		pieces[][2],
+  int			numpieces )
+{
+    seg_t*	seg;
+    pvsline_t	l;
+    pvspoint_t	v1;
+    pvspoint_t	v2;
+    double	len;
+    double	u0;
+    double	u1;
+    double	t;
+    int		i;
+    int		j;
+    int		n;
+
+    len = hypot (w->p[1].x - w->p[0].x, w->p[1].y - w->p[0].y);
+
+    if (!MakeLine (&l, w->p[0].x, w->p[0].y,
+		   w->p[1].x - w->p[0].x, w->p[1].y - w->p[0].y))
+	return 0;
+
+    seg = &segs[subsectors[num].firstline];
+
+    for (i=0 ; i<subsectors[num].numlines ; i++, seg++)
+    {
+	if (seg->backsector != NULL)
+	    continue;
+
+	v1 = VertexPoint (seg->v1);
+	v2 = VertexPoint (seg->v2);
+
+	if (fabs (Side (&l, &v1)) > SEGSLACK
+	 || fabs (Side (&l, &v2)) > SEGSLACK)
+	    continue;
+
+	// Where the seg runs along w.
+	u0 = ((v1.x - w->p[0].x) * (w->p[1].x - w->p[0].x)
+	    + (v1.y - w->p[0].y) * (w->p[1].y - w->p[0].y)) / len;
+	u1 = ((v2.x - w->p[0].x) * (w->p[1].x - w->p[0].x)
+	    + (v2.y - w->p[0].y) * (w->p[1].y - w->p[0].y)) / len;
+
+	if (u0 > u1)
+	{
+	    t = u0;
+	    u0 = u1;
+	    u1 = t;
+	}
+
+	if (u0 >= u1)
+	    continue;
+
+	for (j=0, n=numpieces ; j<n ; j++)
+	{
+	    if (u1 <= pieces[j][0] || u0 >= pieces[j][1])
+		continue;
+
+	    if (u0 > pieces[j][0] && u1 < pieces[j][1])
+	    {
+		// Cut in two.
+		if (numpieces == MAXPIECES)
+		    continue;
+
+		pieces[numpieces][0] = u1;
+		pieces[numpieces][1] = pieces[j][1];
+		numpieces++;
+		pieces[j][1] = u0;
+	    }
+	    else if (u0 > pieces[j][0])
+		pieces[j][1] = u0;
+	    else if (u1 < pieces[j][1])
+		pieces[j][0] = u1;
+	    else
+		pieces[j][0] = pieces[j][1];
+	}
+    }
+
+    return numpieces;
+}
+
+//
+// AddPieces
+// Adds the portals out of from into to along w, less the parts
+//  covered by one-sided segs of from.  Those face the way into
+//  to, so they are solid to anything looking through them.  The
+//  segs of to there face the other way, and don't block.  What
+//  is left is stretched a little, to be sure of not missing a
+//  line of sight past the end of a seg.
+//
+static void
+AddPieces
+( const winding_t*	w,
+  const pvsline_t*	line,
+  int			from,
+  int			to )
+{
+    winding_t	piece;
+    double	pieces[MAXPIECES][2];
+    double	len;
+    double	t0;
+    double	t1;
+    int		numpieces;
+    int		i;
+
+    len = hypot (w->p[1].x - w->p[0].x, w->p[1].y - w->p[0].y);
+
+    pieces[0][0] = 0;
+    pieces[0][1] = len;
+    numpieces = CutOneSidedSegs (w, from, pieces, 1);
+
+    for (i=0 ; i<numpieces ; i++)
+    {
+	if (pieces[i][1] - pieces[i][0] < FLOWSLACK)
+	    continue;
+
+	t0 = (pieces[i][0] - FLOWSLACK) / len;
+	t1 = (pieces[i][1] + FLOWSLACK) / len;
+
+	piece.p[0].x = w->p[0].x + (w->p[1].x - w->p[0].x) * t0;
+	piece.p[0].y = w->p[0].y + (w->p[1].y - w->p[0].y) * t0;
+	piece.p[1].x = w->p[0].x + (w->p[1].x - w->p[0].x) * t1;
+	piece.p[1].y = w->p[0].y + (w->p[1].y - w->p[0].y) * t1;
+
+	AddPortal (&piece, line, from, to);
+    }
+}
+
+//
+// MakePortals
+// Joins front, in front of line, and back, behind it,
+//  where they meet along span.
+//
+static void
+MakePortals
+( const winding_t*	span,
+  const pvsline_t*	line,
+  int			front,
+  int			back )
+{
+    winding_t	w;
+    pvsline_t	out;
+
+    w = *span;
+
+    if (!ClipToSubsector (&w, front) || !ClipToSubsector (&w, back))
+	return;
+
+    if (hypot (w.p[1].x - w.p[0].x, w.p[1].y - w.p[0].y) < FLOWSLACK)
+	return;
+
+    // Out of the front subsector, the far side is the back.
+    out = *line;
+    FlipLine (&out);
+    AddPieces (&w, &out, front, back);
+    AddPieces (&w, line, back, front);
+}
+
+//
+// MakeNodePortals
+// Cuts the partition of each node, inside the node's cell, into
+//  portals between the subsectors either side of it.  The cell
+//  is kept as the lines in cellstack[0] to cellstack[depth-1].
+//
+static void MakeNodePortals (int bspnum, int depth)
+{
+    node_t*	node;
+    pvsline_t	line;
+    pvsline_t	back;
+    pvspoint_t	o;
+    pvspoint_t	d;
+    winding_t	span;
+    pvsspan_t*	f;
+    pvsspan_t*	b;
+    double	t0;
+    double	t1;
+    double	s0;
+    double	ds;
+    double	t;
+    int		i;
+    int		j;
+
+    if (bspnum & NF_SUBSECTOR)
+	return;
+
+    node = &nodes[bspnum];
+    line = NodeLine (node);
+    back = line;
+    FlipLine (&back);
+
+    o.x = (double) node->x / FRACUNIT;
+    o.y = (double) node->y / FRACUNIT;
+    d.x = (double) node->dx / FRACUNIT;
+    d.y = (double) node->dy / FRACUNIT;
+
+    // Find the partition inside the cell.
+    t0 = -1e30;
+    t1 = 1e30;
+
+    for (i=0 ; i<depth && t0 < t1 ; i++)
+    {
+	s0 = Side (&cellstack[i], &o);
+	ds = cellstack[i].a * d.x + cellstack[i].b * d.y;
+
+	if (fabs (ds) < 1e-12)
+	{
+	    if (s0 < 0)
+		t1 = t0;
+	    continue;
+	}
+
+	t = -s0 / ds;
+
+	if (ds > 0 && t > t0)
+	    t0 = t;
+	else if (ds < 0 && t < t1)
+	    t1 = t;
+    }
+
+    if (line.a != 0 || line.b != 0)
+    {
+	frontspans.numspans = 0;
+	backspans.numspans = 0;
+
+	if (t0 < t1)
+	{
+	    FilterSpan (&frontspans, node->children[0], &o, &d, &line, t0, t1);
+	    FilterSpan (&backspans, node->children[1], &o, &d, &back, t0, t1);
+	}
+
+	qsort (frontspans.spans, frontspans.numspans,
+	       sizeof(*frontspans.spans), CompareSpans);
+	qsort (backspans.spans, backspans.numspans,
+	       sizeof(*backspans.spans), CompareSpans);
+
+	// Pair up the subsectors that meet along it.
+	i = j = 0;
+
+	while (i < frontspans.numspans && j < backspans.numspans)
+	{
+	    f = &frontspans.spans[i];
+	    b = &backspans.spans[j];
+
+	    s0 = f->t0 > b->t0 ? f->t0 : b->t0;
+	    t = f->t1 < b->t1 ? f->t1 : b->t1;
+
+	    if (t > s0)
+	    {
+		span.p[0].x = o.x + s0 * d.x;
+		span.p[0].y = o.y + s0 * d.y;
+		span.p[1].x = o.x + t * d.x;
+		span.p[1].y = o.y + t * d.y;
+		MakePortals (&span, &line, f->leaf, b->leaf);
+	    }
+
+	    if (f->t1 < b->t1)
+		i++;
+	    else
+		j++;
+	}
+    }
+
+    cellstack[depth] = line;
+    MakeNodePortals (node->children[0], depth + 1);
+    cellstack[depth] = back;
+    MakeNodePortals (node->children[1], depth + 1);
+}
+
+//
+// SortPortals
+// Groups the portals by the subsector they lead out of.
+//
+static void SortPortals (void)
+{
+    portal_t*	sorted;
+    int*	next;
+    int		i;
+
+    firstportal = calloc (numsubsectors + 1, sizeof(*firstportal));
+    next = malloc ((numsubsectors + 1) * sizeof(*next));
+    sorted = malloc ((numportals + 1) * sizeof(*sorted));
+
+    if (firstportal == NULL || next == NULL || sorted == NULL)
+	I_Error ("R_SetupPVS: Failed to allocate %i portals", numportals);
+
+    for (i=0 ; i<numportals ; i++)
+	firstportal[portals[i].from + 1]++;
+
+    for (i=0 ; i<numsubsectors ; i++)
+	firstportal[i + 1] += firstportal[i];
+
+    memcpy (next, firstportal, (numsubsectors + 1) * sizeof(*next));
+
+    for (i=0 ; i<numportals ; i++)
+	sorted[next[portals[i].from]++] = portals[i];
+
+    free (next);
+    free (portals);
+    portals = sorted;
+}
+
+
+//
+// Following lines of sight
+//
+
+static void MarkVisible (byte *row, int num)
+{
+    row[num >> 3] |= 1 << (num & 7);
+}
+
+static boolean IsVisible (const byte *row, int num)
+{
+    return (row[num >> 3] & (1 << (num & 7))) != 0;
+}
+
+//
+// PortalInFront
+// True if a line through p could go on through q.
+//
+static boolean PortalInFront (const portal_t *p, const portal_t *q)
+{
+    winding_t	w;
+    pvsline_t	back;
+
+    w = q->w;
+
+    if (!ClipWinding (&w, &p->line, FLOWSLACK))
+	return false;
+
+    back = q->line;
+    FlipLine (&back);
+    w = p->w;
+
+    return ClipWinding (&w, &back, FLOWSLACK);
+}
+
+//
+// FloodPortal
+// Finds portalflood for one portal: everything that can
+//  be reached through portals that are each partly beyond it.
+//  Run on the worker threads.
+//
+static void FloodPortal (void *unused, int num)
+{
+    const portal_t*	p;
+    const portal_t*	q;
+    byte*		vis;
+    int*		stack;
+    int			count;
+    int			leaf;
+    int			i;
+
+    p = &portals[num];
+    vis = portalflood + num * pvsrowbytes;
+    stack = malloc (numsubsectors * sizeof(*stack));
+
+    if (stack == NULL)
+    {
+	memset (vis, 0xff, pvsrowbytes);
+	return;
+    }
+
+    MarkVisible (vis, p->to);
+    stack[0] = p->to;
+    count = 1;
+
+    while (count > 0)
+    {
+	leaf = stack[--count];
+
+	for (i=firstportal[leaf] ; i<firstportal[leaf + 1] ; i++)
+	{
+	    q = &portals[i];
+
+	    if (IsVisible (vis, q->to) || !PortalInFront (p, q))
+		continue;
+
+	    MarkVisible (vis, q->to);
+	    stack[count++] = q->to;
+	}
+    }
+
+    free (stack);
+}
+
+static int CountVisible (const byte *row)
+{
+    int		count;
+    int		i;
+    byte	b;
+
+    count = 0;
+
+    for (i=0 ; i<pvsrowbytes ; i++)
+    {
+	for (b = row[i] ; b ; b &= b - 1)
+	    count++;
+    }
+
+    return count;
+}
+
+//
+// RecursiveFlow
+// Follows the lines through source, and pass if it is not NULL,
+//  across subsector num and out through its portals.  might is
+//  what can still be seen along the way.
+//
+static void
+RecursiveFlow
+( flow_t*		flow,
+  const winding_t*	source,
+  const pvsline_t*	sourceline,
+  const winding_t*	pass,
+  const pvsline_t*	passline,
+  int			num,
+  int			depth,
+  const byte*		might )
+{
+    const portal_t*	p;
+    const byte*		vis;
+    winding_t		target;
+    winding_t		newsource;
+    byte*		newmight;
+    boolean		more;
+    int			i;
+    int			j;
+
+    if (depth >= flow->maxdepth)
+    {
+	flow->overflow = true;
+	return;
+    }
+
+    flow->onpath[num] = 1;
+    newmight = flow->might + depth * pvsrowbytes;
+
+    for (i=firstportal[num] ; i<firstportal[num + 1] ; i++)
+    {
+	p = &portals[i];
+
+	// A straight line can't go back into a convex
+	//  subsector it has already crossed.
+	if (flow->onpath[p->to] || !IsVisible (might, p->to))
+	    continue;
+
+	if (++flow->steps > MAXFLOWSTEPS)
+	{
+	    flow->overflow = true;
+	    break;
+	}
+
+	// Nothing more to be found this way?  Portals already
+	//  done say exactly what can be seen through them.
+	if (I_AtomicGet (&portaldone[i]))
+	    vis = portalvis + i * pvsrowbytes;
+	else
+	    vis = portalflood + i * pvsrowbytes;
+
+	more = false;
+
+	for (j=0 ; j<pvsrowbytes ; j++)
+	{
+	    newmight[j] = might[j] & vis[j];
+	    more |= (newmight[j] & ~flow->row[j]) != 0;
+	}
+
+	if (!more)
+	    continue;
+
+	target = p->w;
+	newsource = *source;
+
+	if (!ClipWinding (&target, sourceline, FLOWSLACK))
+	    continue;
+
+	if (pass != NULL)
+	{
+	    if (!ClipWinding (&target, passline, FLOWSLACK)
+	     || !ClipToSeparators (source, pass, &target))
+		continue;
+	}
+
+	MarkVisible (flow->row, p->to);
+
+	// Only the part of the source that can see the
+	//  target through pass matters from here on.
+	if (pass != NULL && !ClipToSeparators (&target, pass, &newsource))
+	    continue;
+
+	RecursiveFlow (flow, &newsource, sourceline, &target, &p->line,
+		       p->to, depth + 1, newmight);
+
+	if (flow->overflow)
+	    break;
+    }
+
+    flow->onpath[num] = 0;
+}
+
+//
+// FlowPortal
+// Finds portalvis for one portal.  They are done in order of
+//  how much their floods reached, so that the small ones are
+//  there to cut short the big ones.  Run on the worker threads.
+//
+static void FlowPortal (void *unused, int index)
+{
+    const portal_t*	p;
+    flow_t		flow;
+    byte*		flood;
+    int			num;
+
+    num = portalorder[index];
+    p = &portals[num];
+    flood = portalflood + num * pvsrowbytes;
+
+    flow.row = portalvis + num * pvsrowbytes;
+    flow.maxdepth = numsubsectors < MAXFLOWDEPTH ? numsubsectors
+						 : MAXFLOWDEPTH;
+    flow.onpath = calloc (numsubsectors, 1);
+    flow.might = malloc (flow.maxdepth * pvsrowbytes);
+    flow.steps = 0;
+    flow.overflow = flow.onpath == NULL || flow.might == NULL;
+
+    if (!flow.overflow)
+    {
+	flow.onpath[p->from] = 1;
+	MarkVisible (flow.row, p->to);
+	RecursiveFlow (&flow, &p->w, &p->line, NULL, NULL, p->to, 0, flood);
+    }
+
+    // Too much to follow: take everything the flood reached.
+    if (flow.overflow)
+	memcpy (flow.row, flood, pvsrowbytes);
+
+    free (flow.onpath);
+    free (flow.might);
+
+    I_AtomicSet (&portaldone[num], 1);
+}
+
+static int *portalcounts;
+
+static int ComparePortals (const void *a, const void *b)
+{
+    return portalcounts[*(const int *) a] - portalcounts[*(const int *) b];
+}
+
+//
+// FlowPortals
+// Fills in the sets from the portals out of each subsector.
+//
+static boolean FlowPortals (void)
+{
+    byte*	row;
+    byte*	vis;
+    int		i;
+    int		j;
+    int		k;
+
+    portalflood = calloc (numportals + 1, pvsrowbytes);
+    portalvis = calloc (numportals + 1, pvsrowbytes);
+    portaldone = calloc (numportals + 1, sizeof(*portaldone));
+    portalorder = malloc ((numportals + 1) * sizeof(*portalorder));
+    portalcounts = malloc ((numportals + 1) * sizeof(*portalcounts));
+
+    if (portalflood == NULL || portalvis == NULL || portaldone == NULL
+     || portalorder == NULL || portalcounts == NULL)
+    {
+	free (portalflood);
+	free (portalvis);
+	free (portaldone);
+	free (portalorder);
+	free (portalcounts);
+	return false;
+    }
+
+    I_RunParallel (FloodPortal, NULL, numportals);
+
+    for (i=0 ; i<numportals ; i++)
+    {
+	portalorder[i] = i;
+	portalcounts[i] = CountVisible (portalflood + i * pvsrowbytes);
+    }
+
+    qsort (portalorder, numportals, sizeof(*portalorder), ComparePortals);
+
+    I_RunParallel (FlowPortal, NULL, numportals);
+
+    for (i=0 ; i<numsubsectors ; i++)
+    {
+	row = pvs + i * pvsrowbytes;
+	MarkVisible (row, i);
+
+	for (j=firstportal[i] ; j<firstportal[i + 1] ; j++)
+	{
+	    vis = portalvis + j * pvsrowbytes;
+
+	    for (k=0 ; k<pvsrowbytes ; k++)
+		row[k] |= vis[k];
+	}
+    }
+
+    free (portalflood);
+    free (portalvis);
+    free (portaldone);
+    free (portalorder);
+    free (portalcounts);
+    return true;
+}
+
+//
+// R_BuildPVS
+//
+static void R_BuildPVS (void)
+{
+    fixed_t	bbox[4];
+    double	left;
+    double	right;
+    double	bottom;
+    double	top;
+    int		i;
+
+    // A box around the level, for the root of the BSP.
+    M_ClearBox (bbox);
+
+    for (i=0 ; i<numvertexes ; i++)
+	M_AddToBox (bbox, vertexes[i].x, vertexes[i].y);
+
+    left = (double) bbox[BOXLEFT] / FRACUNIT - 64;
+    right = (double) bbox[BOXRIGHT] / FRACUNIT + 64;
+    bottom = (double) bbox[BOXBOTTOM] / FRACUNIT - 64;
+    top = (double) bbox[BOXTOP] / FRACUNIT + 64;
+
+    cellstack = malloc ((numnodes + 4) * sizeof(*cellstack));
+
+    if (cellstack == NULL)
+	I_Error ("R_SetupPVS: Failed to allocate cells");
+
+    MakeLine (&cellstack[0], left, 0, 0, 1);
+    MakeLine (&cellstack[1], right, 0, 0, -1);
+    MakeLine (&cellstack[2], 0, bottom, -1, 0);
+    MakeLine (&cellstack[3], 0, top, 1, 0);
+
+    numportals = maxportals = 0;
+    portals = NULL;
+    MakeNodePortals (numnodes - 1, 4);
+    SortPortals ();
+
+    free (cellstack);
+    free (frontspans.spans);
+    free (backspans.spans);
+    memset (&frontspans, 0, sizeof(frontspans));
+    memset (&backspans, 0, sizeof(backspans));
+
+    I_InitThreadPool (I_GetNumCPUs () - 1);
+
+    memset (pvs, 0, numsubsectors * pvsrowbytes);
+
+    if (!FlowPortals ())
+	memset (pvs, 0xff, numsubsectors * pvsrowbytes);
+
+    free (portals);
+    free (firstportal);
+    portals = NULL;
+    firstportal = NULL;
+}
+
+
+//
+// Cache files
+//
+
+static char *PVSFileName (int lumpnum)
+{
+    static const int	lumps[] =
+    {
+	ML_VERTEXES, ML_LINEDEFS, ML_SEGS, ML_SSECTORS, ML_NODES
+    };
+    sha1_context_t	context;
+    sha1_digest_t	digest;
+    char		hash[sizeof(digest) * 2 + 1];
+    char*		dir;
+    char*		filename;
+    byte*		data;
+    unsigned int	i;
+
+    SHA1_Init (&context);
+    SHA1_UpdateInt32 (&context, PVS_VERSION);
+
+    for (i=0 ; i<arrlen(lumps) ; i++)
+    {
+	data = W_CacheLumpNum (lumpnum + lumps[i], PU_STATIC);
+	SHA1_Update (&context, data, W_LumpLength (lumpnum + lumps[i]));
+	W_ReleaseLumpNum (lumpnum + lumps[i]);
+    }
+
+    SHA1_Final (digest, &context);
+
+    for (i=0 ; i<sizeof(digest) ; i++)
+	M_snprintf (hash + i * 2, 3, "%02x", digest[i]);
+
+    dir = M_StringJoin (configdir, "pvs", NULL);
+    M_MakeDirectory (dir);
+    filename = M_StringJoin (dir, DIR_SEPARATOR_S, hash, ".pvs", NULL);
+    free (dir);
+
+    return filename;
+}
+
+static boolean LoadPVS (const char *filename)
+{
+    FILE*	f;
+    byte	header[8];
+    int		count;
+    boolean	result;
+
+    f = fopen (filename, "rb");
+
+    if (f == NULL)
+	return false;
+
+    result = fread (header, 1, sizeof(header), f) == sizeof(header);
+
+    if (result)
+    {
+	count = header[4] | (header[5] << 8)
+	      | (header[6] << 16) | (header[7] << 24);
+
+	result = memcmp (header, "PVS1", 4) == 0
+	      && count == numsubsectors
+	      && fread (pvs, pvsrowbytes, numsubsectors, f)
+		 == (size_t) numsubsectors;
+    }
+
+    fclose (f);
+
+    return result;
+}
+
+static void SavePVS (const char *filename)
+{
+    FILE*	f;
+    byte	header[8];
+
+    f = fopen (filename, "wb");
+
+    if (f == NULL)
+	return;
+
+    memcpy (header, "PVS1", 4);
+    header[4] = numsubsectors & 0xff;
+    header[5] = (numsubsectors >> 8) & 0xff;
+    header[6] = (numsubsectors >> 16) & 0xff;
+    header[7] = (numsubsectors >> 24) & 0xff;
+
+    fwrite (header, 1, sizeof(header), f);
+    fwrite (pvs, pvsrowbytes, numsubsectors, f);
+    fclose (f);
+}
+
+
+//
+// R_SetupPVS
+//
+void R_SetupPVS (int lumpnum)
+{
+    char*	filename;
+    node_t*	node;
+    int		starttime;
+    int		child;
+    int		i;
+    int		j;
+
+    pvsinuse = false;
+
+    if (!usepvs)
+	return;
+
+    free (pvs);
+    pvs = NULL;
+
+    if (numnodes == 0 || numsubsectors > MAXPVSSUBSECTORS)
+	return;
+
+    pvsrowbytes = (numsubsectors + 7) / 8;
+    pvs = malloc (numsubsectors * pvsrowbytes);
+
+    if (pvs == NULL)
+	return;
+
+    // Parents, to find the nodes above the subsectors in view.
+    nodeparent = Z_Malloc (numnodes * sizeof(*nodeparent), PU_LEVEL, NULL);
+    subsectorparent = Z_Malloc (numsubsectors * sizeof(*subsectorparent),
+				PU_LEVEL, NULL);
+    pvsnodes = Z_Malloc (numnodes, PU_LEVEL, NULL);
+    pvssubsectors = Z_Malloc (numsubsectors, PU_LEVEL, NULL);
+
+    nodeparent[numnodes - 1] = -1;
+
+    for (i=0, node=nodes ; i<numnodes ; i++, node++)
+    {
+	for (j=0 ; j<2 ; j++)
+	{
+	    child = node->children[j];
+
+	    if (child & NF_SUBSECTOR)
+		subsectorparent[child & ~NF_SUBSECTOR] = i;
+	    else
+		nodeparent[child] = i;
+	}
+    }
+
+    filename = PVSFileName (lumpnum);
+
+    if (!LoadPVS (filename))
+    {
+	starttime = I_GetTimeMS ();
+	R_BuildPVS ();
+	SavePVS (filename);
+
+	printf ("R_SetupPVS: %i subsectors in %i ms\n",
+		numsubsectors, I_GetTimeMS () - starttime);
+    }
+
+    free (filename);
+}
+
+
+//
+// R_MarkPVS
+//
+void R_MarkPVS (void)
+{
+    subsector_t*	sub;
+    seg_t*		seg;
+    byte*		row;
+    double		cross;
+    int			num;
+    int			node;
+    int			i;
+
+    pvsinuse = false;
+
+    if (pvs == NULL)
+	return;
+
+    sub = R_PointInSubsector (viewx, viewy);
+    num = sub - subsectors;
+
+    // Only from inside the segs of the subsector.  Anywhere else,
+    //  one-sided walls seen from behind can be looked through.
+    seg = &segs[sub->firstline];
+
+    for (i=0 ; i<sub->numlines ; i++, seg++)
+    {
+	cross = (double) (seg->v2->x - seg->v1->x)
+		* ((double) viewy - seg->v1->y)
+	      - (double) (seg->v2->y - seg->v1->y)
+		* ((double) viewx - seg->v1->x);
+
+	if (cross >= 0)
+	    return;
+    }
+
+    memset (pvsnodes, 0, numnodes);
+    memset (pvssubsectors, PVS_SKIP, numsubsectors);
+
+    row = pvs + num * pvsrowbytes;
+
+    for (i=0 ; i<numsubsectors ; i++)
+    {
+	if (row[i >> 3] & (1 << (i & 7)))
+	    pvssubsectors[i] = PVS_DRAW;
+	else if (subsectors[i].sector->thinglist != NULL)
+	    pvssubsectors[i] = PVS_SPRITES;
+	else
+	    continue;
+
+	for (node = subsectorparent[i] ; node != -1 && !pvsnodes[node] ;
+	     node = nodeparent[node])
+	{
+	    pvsnodes[node] = 1;
+	}
+    }
+
+    pvsinuse = true;
+}
+
+
+//
+// HashView
+//
+static uint64_t HashView (void)
+{
+    uint64_t	hash;
+    int		y;
+
+    hash = 0;
+
+    for (y=0 ; y<viewheight ; y++)
+    {
+	hash = XXH64 (I_VideoBuffer + (viewwindowy+y)*SCREENWIDTH + viewwindowx,
+		      scaledviewwidth, hash);
+    }
+
+    return hash;
+}
+
+
+//
+// ClearView
+// So that anything left undrawn shows up the same both times.
+//
+static void ClearView (void)
+{
+    int		y;
+
+    for (y=0 ; y<viewheight ; y++)
+    {
+	memset (I_VideoBuffer + (viewwindowy+y)*SCREENWIDTH + viewwindowx,
+		0, scaledviewwidth);
+    }
+}
+
+
+void R_StartPVSCheck (void)
+{
+    ClearView ();
+}
+
+
+void R_HashPVSReference (void)
+{
+    referencehash = HashView ();
+    ClearView ();
+}
+
+
+void R_FinishPVSCheck (void)
+{
+    // Nothing was skipped.
+    if (!pvsinuse)
+	return;
+
+    viewschecked++;
+
+    if (HashView () != referencehash)
+    {
+	if (viewsdiffering == 0)
+	{
+	    printf ("R_FinishPVSCheck: view at tic %i, %i %i differs "
+		    "without -pvs\n", gametic,
+		    viewx >> FRACBITS, viewy >> FRACBITS);
+	}
+
+	viewsdiffering++;
+    }
+}
+
+
+//
+// R_ReportPVSCheck
+//
+static void R_ReportPVSCheck (void)
+{
+    printf ("R_ReportPVSCheck: %i of %i views differ without -pvs\n",
+	    viewsdiffering, viewschecked);
+}
+
+
+//
+// R_InitPVS
+//
+void R_InitPVS (void)
+{
+    //!
+    // @category video
+    //
+    // Skip the parts of the level that can't be seen from where the
+    // view is, found from potentially visible sets worked out when
+    // each level is loaded.  They take a while to work out for a
+    // big level, so they are kept in the pvs directory under the
+    // configuration directory.  The picture drawn is unchanged, but
+    // fewer visplanes are used, so a view that would stop with "no
+    // more visplanes" may be drawn.
+    //
+
+    usepvs = M_CheckParm ("-pvs") > 0;
+
+    //!
+    // @category video
+    //
+    // Like -pvs, but also draw each view without the sets, and
+    // report any view where the two pictures differ.  Anything
+    // left undrawn in the view is black.  Not with -pipeline or
+    // -columnmajor.
+    //
+
+    pvscheck = M_CheckParm ("-pvscheck") > 0;
+
+    if (pvscheck)
+    {
+	usepvs = true;
+	I_AtExit (R_ReportPVSCheck, true);
+    }
+}
@@ -0,0 +1,59 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Potentially visible sets of subsectors, with -pvs.
+//
+
+
+#ifndef __R_PVS__
+#define __R_PVS__
+
+#include "doomtype.h"
+
+// What the BSP walk needs to do with each subsector this frame.
+enum
+{
+    PVS_SKIP,		// nothing there can be seen
+    PVS_SPRITES,	// can't be seen, but has things that might
+    PVS_DRAW		// might be seen
+};
+
+// True if the sets are being used for the frame being drawn.
+extern boolean		pvsinuse;
+
+// With pvsinuse, nonzero for each node with anything
+//  to be done under it, and the above for each subsector.
+extern byte*		pvsnodes;
+extern byte*		pvssubsectors;
+
+// Called by R_Init.
+void R_InitPVS (void);
+
+// Called by P_SetupLevel, once the level is loaded,
+//  with the lump number of the map marker.
+void R_SetupPVS (int lumpnum);
+
+// Called by R_RenderPlayerView once the view is set up.
+void R_MarkPVS (void);
+
+// Set by -pvscheck.  R_RenderPlayerView then calls R_StartPVSCheck,
+//  draws the view without the sets, calls R_HashPVSReference,
+//  draws it again with them and calls R_FinishPVSCheck.
+extern boolean		pvscheck;
+
+void R_StartPVSCheck (void);
+void R_HashPVSReference (void);
+void R_FinishPVSCheck (void);
+
+#endif
@@ -25,6 +25,7 @@
 #include <stdlib.h>
 
 #include "i_system.h"
+#include "z_zone.h"
 
 #include "doomdef.h"
 #include "doomstat.h"
@@ -102,6 +103,9 @@ R_RenderMaskedSegRange
     column_t*	col;
     int		lightnum;
     int		texnum;
+    maskedcolumns_t*	columns;
+    int*	firstpost;
+    int		texturecolumn;
     
     // Calculate light table.
     // Use different light tables
@@ -150,6 +154,9 @@ R_RenderMaskedSegRange
 			
     if (fixedcolormap)
 	dc_colormap = fixedcolormap;
+
+    columns = R_CacheTextureColumns (texnum);
+    firstpost = columns->firstpost;
     
     // draw the columns
     for (dc_x = x1 ; dc_x <= x2 ; dc_x++)
@@ -171,15 +178,20 @@ R_RenderMaskedSegRange
 	    dc_iscale = 0xffffffffu / (unsigned)spryscale;
 	    
 	    // draw the texture
+	    texturecolumn = maskedtexturecol[dc_x] & texturewidthmask[texnum];
 	    col = (column_t *)( 
-		(byte *)R_GetColumn(texnum,maskedtexturecol[dc_x]) -3);
+		(byte *)R_GetColumn(texnum,texturecolumn) -3);
 			
-	    R_DrawMaskedColumn (col);
+	    R_DrawMaskedPosts (col,
+			       columns->posts + firstpost[texturecolumn],
+			       firstpost[texturecolumn+1]
+			       - firstpost[texturecolumn]);
 	    maskedtexturecol[dc_x] = SHRT_MAX;
 	}
 	spryscale += rw_scalestep;
     }
-	
+
+    Z_ChangeTag (columns, PU_CACHE);
 }
 
 
@@ -380,8 +392,11 @@ R_StoreWallRange
     int			lightnum;
 
     // don't overflow and crash
-    if (ds_p == &drawsegs[MAXDRAWSEGS])
+    if (!R_CheckDrawSegs ())
 	return;		
+
+    // masked texture columns, and sprite clipping above and below
+    R_CheckOpenings (3 * (stop - start + 1));
 		
 #ifdef RANGECHECK
     if (start >=viewwidth || start > stop)
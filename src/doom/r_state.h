@@ -36,6 +36,7 @@
 
 // needed for texture pegging
 extern fixed_t*		textureheight;
+extern int*		texturewidthmask;
 
 // needed for pre rendering (fracs)
 extern fixed_t*		spritewidth;
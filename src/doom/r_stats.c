@@ -0,0 +1,403 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Per-frame renderer counters, for finding out why a view
+//	is slow.
+//
+//	The BSP walk counts what it does as it goes.  The column
+//	and span drawers are wrapped by versions that count what
+//	they are given, and with -heatmap, how often each pixel of
+//	the view is written.  With -renderthreads, the wrappers go
+//	around the recording drawers, so all of the counting is
+//	done on the main thread.
+//
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "doomdef.h"
+#include "d_loop.h"
+
+#include "i_swap.h"
+#include "i_system.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "v_video.h"
+
+#include "hu_stuff.h"
+
+#include "r_local.h"
+#include "r_stats.h"
+
+boolean			renderstats = false;
+framestats_t		framestats;
+
+static boolean		statsoverlay = false;
+static boolean		heatmap = false;
+
+// How often each pixel of the view was written this frame,
+//  in the columns of the drawers, so halved in low detail.
+static byte		heatcounts[SCREENWIDTH*SCREENHEIGHT];
+
+// Palette colours for 0, 1, 2... writes: black, blue,
+//  green, yellow, orange, red, then white for any more.
+static const byte	heatcolors[] = { 0, 204, 116, 231, 216, 176, 4 };
+
+#define NUMHEATCOLORS	(sizeof(heatcolors) / sizeof(*heatcolors))
+
+static const char*	statslogname = NULL;
+static FILE*		statslog = NULL;
+static int		statslogframes;
+
+// The drawers being counted.
+static void		(*drawcolumn) (void);
+static void		(*drawfuzzcolumn) (void);
+static void		(*drawtranscolumn) (void);
+static void		(*drawspan) (void);
+
+extern patch_t*		hu_font[HU_FONTSIZE];
+
+
+//
+// Counting drawers
+//
+static void CountColumn (void)
+{
+    byte*	heat;
+    int		y;
+
+    framestats.columns++;
+
+    if (dc_yl > dc_yh)
+	return;
+
+    framestats.pixels += (dc_yh - dc_yl + 1) << detailshift;
+
+    if (heatmap
+     && (unsigned) dc_x < SCREENWIDTH && dc_yl >= 0 && dc_yh < SCREENHEIGHT)
+    {
+	heat = heatcounts + dc_yl*SCREENWIDTH + dc_x;
+
+	for (y = dc_yl ; y <= dc_yh ; y++, heat += SCREENWIDTH)
+	{
+	    if (*heat < 255)
+		(*heat)++;
+	}
+    }
+}
+
+static void CountSpan (void)
+{
+    byte*	heat;
+    int		x;
+
+    framestats.spans++;
+
+    if (ds_x1 > ds_x2)
+	return;
+
+    framestats.pixels += (ds_x2 - ds_x1 + 1) << detailshift;
+
+    if (heatmap
+     && (unsigned) ds_y < SCREENHEIGHT && ds_x1 >= 0 && ds_x2 < SCREENWIDTH)
+    {
+	heat = heatcounts + ds_y*SCREENWIDTH;
+
+	for (x = ds_x1 ; x <= ds_x2 ; x++)
+	{
+	    if (heat[x] < 255)
+		heat[x]++;
+	}
+    }
+}
+
+static void StatsColumn (void)
+{
+    CountColumn ();
+    drawcolumn ();
+}
+
+static void StatsFuzzColumn (void)
+{
+    CountColumn ();
+    drawfuzzcolumn ();
+}
+
+static void StatsTranslatedColumn (void)
+{
+    CountColumn ();
+    drawtranscolumn ();
+}
+
+static void StatsSpan (void)
+{
+    CountSpan ();
+    drawspan ();
+}
+
+
+//
+// R_SetupStatsDrawers
+//
+void R_SetupStatsDrawers (void)
+{
+    if (!renderstats)
+	return;
+
+    drawcolumn = basecolfunc;
+    drawfuzzcolumn = fuzzcolfunc;
+    drawtranscolumn = transcolfunc;
+    drawspan = spanfunc;
+
+    colfunc = basecolfunc = StatsColumn;
+    fuzzcolfunc = StatsFuzzColumn;
+    transcolfunc = StatsTranslatedColumn;
+    spanfunc = StatsSpan;
+}
+
+
+//
+// R_StartFrameStats
+//
+void R_StartFrameStats (void)
+{
+    int		y;
+
+    memset (&framestats, 0, sizeof(framestats));
+
+    // Clear out anything drawn since the last frame, such as
+    //  the reference view of -pvscheck.
+    if (heatmap)
+    {
+	for (y=0 ; y<viewheight ; y++)
+	    memset (heatcounts + y*SCREENWIDTH, 0, viewwidth);
+    }
+}
+
+
+//
+// R_DrawHeatmap
+// Replaces the view with the write counts.
+//
+static void R_DrawHeatmap (void)
+{
+    pixel_t*	dest;
+    byte*	heat;
+    int		x;
+    int		y;
+
+    for (y=0 ; y<viewheight ; y++)
+    {
+	dest = I_VideoBuffer + (viewwindowy+y)*SCREENWIDTH + viewwindowx;
+	heat = heatcounts + y*SCREENWIDTH;
+
+	for (x=0 ; x<scaledviewwidth ; x++)
+	{
+	    if (heat[x>>detailshift] < NUMHEATCOLORS)
+		dest[x] = heatcolors[heat[x>>detailshift]];
+	    else
+		dest[x] = heatcolors[NUMHEATCOLORS-1];
+	}
+    }
+}
+
+
+//
+// R_FinishFrameStats
+//
+void R_FinishFrameStats (uint64_t viewtime)
+{
+    framestats.drawsegs = ds_p - drawsegs;
+    framestats.visplanes = lastvisplane - visplanes;
+    framestats.vissprites = vissprite_p - vissprites;
+
+    if (heatmap)
+	R_DrawHeatmap ();
+
+    if (statslog != NULL)
+    {
+	fprintf (statslog, "%i,%i,%i,%i,%" PRIu64 ",%i,%i,%i,%i,%i,%i,"
+			   "%i,%i,%i,%i\n",
+		 statslogframes, gametic,
+		 viewx>>FRACBITS, viewy>>FRACBITS, viewtime,
+		 framestats.nodes, framestats.bboxrejects,
+		 framestats.nodesculled, framestats.segs, framestats.drawsegs,
+		 framestats.visplanes, framestats.vissprites,
+		 framestats.columns, framestats.spans,
+		 framestats.pixels);
+	statslogframes++;
+    }
+}
+
+
+//
+// R_DrawStatsText
+// As M_WriteText, in the HUD font.
+//
+static void R_DrawStatsText (int x, int y, const char *string)
+{
+    int		w;
+    int		c;
+    int		cx;
+    int		cy;
+
+    cx = x;
+    cy = y;
+
+    for ( ; *string ; string++)
+    {
+	if (*string == '\n')
+	{
+	    cx = x;
+	    cy += 9;
+	    continue;
+	}
+
+	c = toupper(*string) - HU_FONTSTART;
+
+	if (c < 0 || c >= HU_FONTSIZE)
+	{
+	    cx += 4;
+	    continue;
+	}
+
+	w = SHORT (hu_font[c]->width);
+
+	if (cx+w > SCREENWIDTH)
+	    break;
+
+	V_DrawPatch (cx, cy, hu_font[c]);
+	cx += w;
+    }
+}
+
+
+//
+// R_DrawStatsOverlay
+// The counts for the last frame, in the bottom left of the view.
+//
+void R_DrawStatsOverlay (void)
+{
+    char	text[256];
+    int		y;
+
+    if (!statsoverlay)
+	return;
+
+    M_snprintf (text, sizeof(text),
+		"nodes %i  rejects %i  culled %i\n"
+		"segs %i  drawsegs %i\n"
+		"planes %i  sprites %i\n"
+		"columns %i  spans %i\n"
+		"pixels %i",
+		framestats.nodes, framestats.bboxrejects,
+		framestats.nodesculled,
+		framestats.segs, framestats.drawsegs,
+		framestats.visplanes, framestats.vissprites,
+		framestats.columns, framestats.spans,
+		framestats.pixels);
+
+    y = viewwindowy + viewheight - 5*9 - 1;
+
+    if (y < 0)
+	y = 0;
+
+    R_DrawStatsText (viewwindowx + 2, y, text);
+}
+
+
+//
+// R_StartStatsLog
+//
+void R_StartStatsLog (void)
+{
+    if (statslogname == NULL)
+	return;
+
+    statslog = fopen (statslogname, "w");
+
+    if (statslog == NULL)
+	I_Error ("R_StartStatsLog: Unable to open %s", statslogname);
+
+    fprintf (statslog, "frame,gametic,x,y,viewus,nodes,bboxrejects,"
+		       "nodesculled,segs,drawsegs,visplanes,vissprites,"
+		       "columns,spans,pixels\n");
+    statslogframes = 0;
+}
+
+
+//
+// R_StopStatsLog
+//
+void R_StopStatsLog (void)
+{
+    if (statslog == NULL)
+	return;
+
+    fclose (statslog);
+    statslog = NULL;
+
+    printf ("R_StopStatsLog: %i frames written to %s\n",
+	    statslogframes, statslogname);
+}
+
+
+//
+// R_InitRenderStats
+//
+void R_InitRenderStats (void)
+{
+    int		p;
+
+    //!
+    // @category video
+    //
+    // Show counters for each frame of the 3D view: the BSP nodes
+    // visited, rejected by their bounding boxes and skipped with
+    // -pvs, the segs, drawsegs, visplanes and sprites, and the
+    // columns, spans and pixels drawn.  Counting slows drawing a
+    // little.
+    //
+
+    statsoverlay = M_CheckParm ("-renderstats") > 0;
+
+    //!
+    // @arg <file>
+    // @category video
+    //
+    // With -timedemo, write the counters shown by -renderstats
+    // for each frame to a CSV file, with the position of the view
+    // and the time taken to draw it in microseconds.
+    //
+
+    p = M_CheckParmWithArgs ("-renderstatscsv", 1);
+
+    if (p)
+	statslogname = myargv[p + 1];
+
+    //!
+    // @category video
+    //
+    // Shade each pixel of the 3D view by the number of times it
+    // was drawn: black for none, then blue, green, yellow,
+    // orange and red, and white for six or more.
+    //
+
+    heatmap = M_CheckParm ("-heatmap") > 0;
+
+    renderstats = statsoverlay || statslogname != NULL || heatmap;
+}
@@ -0,0 +1,68 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Per-frame renderer counters, for finding out why a view
+//	is slow.
+//
+
+
+#ifndef __R_STATS__
+#define __R_STATS__
+
+#include "doomtype.h"
+
+typedef struct
+{
+    int		nodes;		// BSP nodes and subsectors visited
+    int		bboxrejects;	// back spaces rejected by R_CheckBBox
+    int		nodesculled;	// nodes and subsectors skipped by -pvs
+    int		segs;		// segs passed to R_AddLine
+    int		drawsegs;
+    int		visplanes;
+    int		vissprites;
+    int		columns;	// calls to the column drawers
+    int		spans;		// calls to the span drawer
+    int		pixels;		// pixels written by both
+} framestats_t;
+
+// True if the counters are being kept, with -renderstats,
+//  -renderstatscsv or -heatmap.
+extern boolean		renderstats;
+
+// The counts for the frame being drawn,
+//  or the last one once it is finished.
+extern framestats_t	framestats;
+
+// Called by R_Init.
+void R_InitRenderStats (void);
+
+// Called by R_SetDrawFunctions, after R_SetupThreadedDrawers,
+//  to count what the drawers are given.
+void R_SetupStatsDrawers (void);
+
+// Called by R_RenderPlayerView around each frame.
+//  viewtime is how long the frame took, in microseconds,
+//  or 0 if it was not timed.
+void R_StartFrameStats (void);
+void R_FinishFrameStats (uint64_t viewtime);
+
+// Called by D_Display after the view and the HUD are drawn.
+void R_DrawStatsOverlay (void);
+
+// Write each frame to the -renderstatscsv file between these,
+//  called at the start and end of -timedemo.
+void R_StartStatsLog (void);
+void R_StopStatsLog (void);
+
+#endif
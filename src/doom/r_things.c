@@ -32,6 +32,8 @@
 #include "w_wad.h"
 
 #include "r_local.h"
+#include "r_limits.h"
+#include "r_sort.h"
 
 #include "doomstat.h"
 
@@ -278,10 +280,16 @@ void R_InitSpriteDefs(const char **namelist)
 //
 // GAME FUNCTIONS
 //
-vissprite_t	vissprites[MAXVISSPRITES];
+// With -growlimits, vissprites can be moved to a bigger copy.
+static vissprite_t	fixedvissprites[MAXVISSPRITES];
+vissprite_t*	vissprites = fixedvissprites;
 vissprite_t*	vissprite_p;
+int		numvissprites = MAXVISSPRITES;
 int		newvissprite;
 
+// How many vissprites this frame may use.
+static int	maxvissprites;
+
 
 
 //
@@ -309,6 +317,7 @@ void R_InitSprites(const char **namelist)
 void R_ClearSprites (void)
 {
     vissprite_p = vissprites;
+    maxvissprites = growlimits ? numvissprites : MAXVISSPRITES;
 }
 
 
@@ -319,8 +328,24 @@ vissprite_t	overflowsprite;
 
 vissprite_t* R_NewVisSprite (void)
 {
-    if (vissprite_p == &vissprites[MAXVISSPRITES])
-	return &overflowsprite;
+    vissprite_t*	newvissprites;
+    int			count;
+
+    count = vissprite_p - vissprites;
+
+    if (count == maxvissprites)
+    {
+	if (!growlimits)
+	    return &overflowsprite;
+
+	newvissprites =
+	    R_GrowPool (vissprites, &numvissprites, sizeof(*newvissprites));
+	R_FreePool (vissprites, fixedvissprites);
+
+	vissprites = newvissprites;
+	vissprite_p = vissprites + count;
+	maxvissprites = numvissprites;
+    }
     
     vissprite_p++;
     return vissprite_p-1;
@@ -380,6 +405,48 @@ void R_DrawMaskedColumn (column_t* column)
 }
 
 
+//
+// R_DrawMaskedPosts
+// The same as R_DrawMaskedColumn, from the posts
+//  decoded by R_CacheSpriteColumns or R_CacheTextureColumns.
+//
+void
+R_DrawMaskedPosts
+( column_t*		column,
+  const maskedpost_t*	post,
+  int			count )
+{
+    int		topscreen;
+    int 	bottomscreen;
+    fixed_t	basetexturemid;
+	
+    basetexturemid = dc_texturemid;
+	
+    for ( ; count > 0 ; count--, post++)
+    {
+	topscreen = sprtopscreen + spryscale*post->topdelta;
+	bottomscreen = topscreen + spryscale*post->length;
+
+	dc_yl = (topscreen+FRACUNIT-1)>>FRACBITS;
+	dc_yh = (bottomscreen-1)>>FRACBITS;
+		
+	if (dc_yh >= mfloorclip[dc_x])
+	    dc_yh = mfloorclip[dc_x]-1;
+	if (dc_yl <= mceilingclip[dc_x])
+	    dc_yl = mceilingclip[dc_x]+1;
+
+	if (dc_yl <= dc_yh)
+	{
+	    dc_source = (byte *)column + post->offset;
+	    dc_texturemid = basetexturemid - (post->topdelta<<FRACBITS);
+	    colfunc ();	
+	}
+    }
+	
+    dc_texturemid = basetexturemid;
+}
+
+
 
 //
 // R_DrawVisSprite
@@ -395,8 +462,12 @@ R_DrawVisSprite
     int			texturecolumn;
     fixed_t		frac;
     patch_t*		patch;
+    maskedcolumns_t*	columns;
+    int*		firstpost;
 	
 	
+    columns = R_CacheSpriteColumns (vis->patch);
+    firstpost = columns->firstpost;
     patch = W_CacheLumpNum (vis->patch+firstspritelump, PU_CACHE);
 
     dc_colormap = vis->colormap;
@@ -428,9 +499,21 @@ R_DrawVisSprite
 #endif
 	column = (column_t *) ((byte *)patch +
 			       LONG(patch->columnofs[texturecolumn]));
-	R_DrawMaskedColumn (column);
+
+	if ((unsigned) texturecolumn < (unsigned) columns->numcolumns)
+	{
+	    R_DrawMaskedPosts (column,
+			       columns->posts + firstpost[texturecolumn],
+			       firstpost[texturecolumn+1]
+			       - firstpost[texturecolumn]);
+	}
+	else
+	{
+	    R_DrawMaskedColumn (column);
+	}
     }
 
+    Z_ChangeTag (columns, PU_CACHE);
     colfunc = basecolfunc;
 }
 
@@ -775,51 +858,122 @@ void R_DrawPlayerSprites (void)
 //
 vissprite_t	vsprsortedhead;
 
+static sortkey_t	fixedvsprsortkeys[MAXVISSPRITES];
+static sortkey_t	fixedvsprsortscratch[MAXVISSPRITES];
+static sortkey_t*	vsprsortkeys = fixedvsprsortkeys;
+static sortkey_t*	vsprsortscratch = fixedvsprsortscratch;
+static int		numvsprsortkeys = MAXVISSPRITES;
+
+
+//
+// Drawseg index.
+// Built once the BSP walk is done, so that each sprite
+//  only looks at the drawsegs in the columns it covers.
+// Each bin of columns has a bit set for every drawseg that
+//  reaches into it and could clip a sprite.
+//
+// Each bin has dswords words, enough for the drawsegs of the frame.
+//
+#define DSBINSHIFT	4
+#define NUMDSBINS	(SCREENWIDTH >> DSBINSHIFT)
+#define DSWORDS		(MAXDRAWSEGS / 32)
+
+static unsigned int	fixeddrawsegbins[NUMDSBINS * DSWORDS];
+static unsigned int	fixeddscandidates[DSWORDS];
+static unsigned int*	drawsegbins = fixeddrawsegbins;
+static unsigned int*	dscandidates = fixeddscandidates;
+static int		numdswords = DSWORDS;
+static int		dswords;
+
+int			drawsegvisitsavoided;
+
+
+//
+// R_IndexDrawSegs
+//
+static void R_IndexDrawSegs (void)
+{
+    drawseg_t*		ds;
+    unsigned int*	newbins;
+    unsigned int*	newcandidates;
+    unsigned int	bit;
+    int			word;
+    int			bin;
+    int			size;
+
+    dswords = (ds_p - drawsegs + 31) >> 5;
+
+    // Grown along with the drawsegs, with -growlimits.
+    while (dswords > numdswords)
+    {
+	size = NUMDSBINS * numdswords;
+	newbins = R_GrowPool (drawsegbins, &size, sizeof(*newbins));
+	newcandidates =
+	    R_GrowPool (dscandidates, &numdswords, sizeof(*newcandidates));
+	R_FreePool (drawsegbins, fixeddrawsegbins);
+	R_FreePool (dscandidates, fixeddscandidates);
+	drawsegbins = newbins;
+	dscandidates = newcandidates;
+    }
+
+    memset (drawsegbins, 0, NUMDSBINS * dswords * sizeof(*drawsegbins));
+    drawsegvisitsavoided = 0;
+
+    for (ds=drawsegs ; ds<ds_p ; ds++)
+    {
+	// same test as R_DrawSprite
+	if (!ds->silhouette && !ds->maskedtexturecol)
+	    continue;
+
+	word = (ds - drawsegs) >> 5;
+	bit = 1u << ((ds - drawsegs) & 31);
+
+	for (bin = ds->x1 >> DSBINSHIFT ; bin <= ds->x2 >> DSBINSHIFT ; bin++)
+	    drawsegbins[bin*dswords + word] |= bit;
+    }
+}
+
 
 void R_SortVisSprites (void)
 {
     int			i;
     int			count;
-    vissprite_t*	ds;
+    int			size;
     vissprite_t*	best;
-    vissprite_t		unsorted;
-    fixed_t		bestscale;
+    sortkey_t*		newkeys;
+    sortkey_t*		newscratch;
 
     count = vissprite_p - vissprites;
-	
-    unsorted.next = unsorted.prev = &unsorted;
 
     if (!count)
 	return;
-		
-    for (ds=vissprites ; ds<vissprite_p ; ds++)
+
+    // Grown along with the vissprites, with -growlimits.
+    while (count > numvsprsortkeys)
     {
-	ds->next = ds+1;
-	ds->prev = ds-1;
+	size = numvsprsortkeys;
+	newscratch = R_GrowPool (vsprsortscratch, &size, sizeof(*newscratch));
+	newkeys = R_GrowPool (vsprsortkeys, &numvsprsortkeys, sizeof(*newkeys));
+	R_FreePool (vsprsortscratch, fixedvsprsortscratch);
+	R_FreePool (vsprsortkeys, fixedvsprsortkeys);
+	vsprsortscratch = newscratch;
+	vsprsortkeys = newkeys;
     }
-    
-    vissprites[0].prev = &unsorted;
-    unsorted.next = &vissprites[0];
-    (vissprite_p-1)->next = &unsorted;
-    unsorted.prev = vissprite_p-1;
-    
-    // pull the vissprites out by scale
+
+    for (i=0 ; i<count ; i++)
+    {
+	vsprsortkeys[i].key = vissprites[i].scale;
+	vsprsortkeys[i].index = i;
+    }
+
+    // Stable, so that sprites of equal scale stay in
+    //  the order the old selection sort picked them.
+    R_StableSortKeys (vsprsortkeys, vsprsortscratch, count);
 
     vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
     for (i=0 ; i<count ; i++)
     {
-	bestscale = INT_MAX;
-        best = unsorted.next;
-	for (ds=unsorted.next ; ds!= &unsorted ; ds=ds->next)
-	{
-	    if (ds->scale < bestscale)
-	    {
-		bestscale = ds->scale;
-		best = ds;
-	    }
-	}
-	best->next->prev = best->prev;
-	best->prev->next = best->next;
+	best = &vissprites[vsprsortkeys[i].index];
 	best->next = &vsprsortedhead;
 	best->prev = vsprsortedhead.prev;
 	vsprsortedhead.prev->next = best;
@@ -837,6 +991,10 @@ void R_DrawSprite (vissprite_t* spr)
     drawseg_t*		ds;
     short		clipbot[SCREENWIDTH];
     short		cliptop[SCREENWIDTH];
+    unsigned int*	candidates;
+    int			visits;
+    int			bin;
+    int			i;
     int			x;
     int			r1;
     int			r2;
@@ -846,12 +1004,35 @@ void R_DrawSprite (vissprite_t* spr)
 		
     for (x = spr->x1 ; x<=spr->x2 ; x++)
 	clipbot[x] = cliptop[x] = -2;
+
+    // Only the drawsegs in the sprite's bins can touch it.
+    candidates = dscandidates;
+    memset (candidates, 0, dswords * sizeof(*candidates));
+
+    for (bin = spr->x1 >> DSBINSHIFT ; bin <= spr->x2 >> DSBINSHIFT ; bin++)
+	for (i=0 ; i<dswords ; i++)
+	    candidates[i] |= drawsegbins[bin*dswords + i];
+
+    visits = 0;
     
     // Scan drawsegs from end to start for obscuring segs.
     // The first drawseg that has a greater scale
     //  is the clip seg.
-    for (ds=ds_p-1 ; ds >= drawsegs ; ds--)
+    for (i=dswords*32-1 ; i>=0 ; i--)
     {
+	if (!candidates[i >> 5])
+	{
+	    // skip to the end of the word below
+	    i &= ~31;
+	    continue;
+	}
+
+	if (!(candidates[i >> 5] & (1u << (i & 31))))
+	    continue;
+
+	ds = &drawsegs[i];
+	visits++;
+
 	// determine if the drawseg obscures the sprite
 	if (ds->x1 > spr->x2
 	    || ds->x2 < spr->x1
@@ -924,6 +1105,8 @@ void R_DrawSprite (vissprite_t* spr)
 	}
 		
     }
+
+    drawsegvisitsavoided += (ds_p - drawsegs) - visits;
     
     // all clipping has been performed, so draw the sprite
 
@@ -953,8 +1136,12 @@ void R_DrawMasked (void)
     vissprite_t*	spr;
     drawseg_t*		ds;
 	
+    // Set up while any plane threads are still drawing.
+    R_IndexDrawSegs ();
     R_SortVisSprites ();
 
+    R_FinishPlanes ();
+
     if (vissprite_p > vissprites)
     {
 	// draw all vissprites back to front
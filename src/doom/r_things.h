@@ -22,10 +22,12 @@
 
 
 
+// The vanilla size, which can grow with -growlimits.
 #define MAXVISSPRITES  	128
 
-extern vissprite_t	vissprites[MAXVISSPRITES];
+extern vissprite_t*	vissprites;
 extern vissprite_t*	vissprite_p;
+extern int		numvissprites;
 extern vissprite_t	vsprsortedhead;
 
 // Constant arrays used for psprite clipping
@@ -42,8 +44,17 @@ extern fixed_t		sprtopscreen;
 extern fixed_t		pspritescale;
 extern fixed_t		pspriteiscale;
 
+// Drawsegs R_DrawSprite did not need to look at this frame,
+//  against scanning all of them for every sprite.
+extern int		drawsegvisitsavoided;
+
 
 void R_DrawMaskedColumn (column_t* column);
+void
+R_DrawMaskedPosts
+( column_t*		column,
+  const maskedpost_t*	post,
+  int			count );
 
 
 void R_SortVisSprites (void);
@@ -0,0 +1,440 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Multithreaded drawing of the player view.
+//
+//	The BSP walk, visplane and sprite setup all still run on the
+//	main thread, exactly as before.  The column and span drawers
+//	are replaced by versions that just record their parameters.
+//	When the frame is finished, the view is cut into vertical
+//	strips and each strip replays the recorded drawing, clipped
+//	to its own columns, on a separate thread.
+//
+//	Every pixel is written by the same drawer with the same
+//	parameters, in the same order, as in a single threaded
+//	frame, so the result is identical.
+//
+//	With -pipeline, the recorded frame is drawn into a buffer
+//	of its own in the background, while the next tic runs.
+//	The recording is a snapshot of everything the drawers need
+//	from the level, so the game can carry on changing it.  The
+//	finished view is copied to the screen when the next view
+//	is started, so the view shown is one frame behind.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+
+#include "i_system.h"
+#include "i_thread.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "z_zone.h"
+
+#include "r_local.h"
+#include "r_thread.h"
+
+typedef struct
+{
+    int			x;
+    int			yl;
+    int			yh;
+    fixed_t		iscale;
+    fixed_t		texturemid;
+    byte*		source;
+    byte*		translation;
+    int			fuzzpos;
+} columncmd_t;
+
+typedef struct
+{
+    int			y;
+    int			x1;
+    int			x2;
+    fixed_t		xfrac;
+    fixed_t		yfrac;
+    fixed_t		xstep;
+    fixed_t		ystep;
+    byte*		source;
+} spancmd_t;
+
+typedef struct
+{
+    // The real drawing function.
+    void		(*drawer) (void);
+    lighttable_t*	colormap;
+    boolean		span;
+
+    union
+    {
+	columncmd_t	column;
+	spancmd_t	span;
+    } u;
+} drawcmd_t;
+
+boolean			renderthreads = false;
+boolean			renderpipeline = false;
+
+pixel_t*		pipelinebuffer;
+
+static int		numstrips;
+
+// The frame being drawn in the background, and whether
+//  pipelinebuffer holds a view that has not yet been shown.
+static thread_batch_t*	pipelinebatch;
+static boolean		pipelineready;
+
+static drawcmd_t*	drawcmds;
+static int		numdrawcmds;
+static int		drawcmds_size;
+
+static void		(*drawcolumn) (void);
+static void		(*drawfuzzcolumn) (void);
+static void		(*drawtranscolumn) (void);
+static void		(*drawspan) (void);
+
+
+//
+// NewDrawCommand
+//
+static drawcmd_t* NewDrawCommand (void (*drawer) (void))
+{
+    drawcmd_t*		cmd;
+
+    if (numdrawcmds == drawcmds_size)
+    {
+	drawcmds_size = drawcmds_size ? drawcmds_size * 2 : 4096;
+	drawcmds = I_Realloc(drawcmds, drawcmds_size * sizeof(*drawcmds));
+    }
+
+    cmd = &drawcmds[numdrawcmds++];
+    cmd->drawer = drawer;
+
+    return cmd;
+}
+
+
+static void RecordColumnCommand (void (*drawer) (void))
+{
+    drawcmd_t*		cmd;
+
+    cmd = NewDrawCommand(drawer);
+    cmd->span = false;
+    cmd->colormap = dc_colormap;
+    cmd->u.column.x = dc_x;
+    cmd->u.column.yl = dc_yl;
+    cmd->u.column.yh = dc_yh;
+    cmd->u.column.iscale = dc_iscale;
+    cmd->u.column.texturemid = dc_texturemid;
+    cmd->u.column.source = dc_source;
+    cmd->u.column.translation = dc_translation;
+    cmd->u.column.fuzzpos = fuzzpos;
+}
+
+
+//
+// Recording versions of the drawers,
+//  installed in colfunc and friends.
+//
+static void RecordColumn (void)
+{
+    RecordColumnCommand(drawcolumn);
+}
+
+static void RecordFuzzColumn (void)
+{
+    RecordColumnCommand(drawfuzzcolumn);
+
+    // The fuzz position carries on from one column to
+    //  the next, so keep it moving as if this one was drawn.
+    R_SkipFuzzColumn();
+}
+
+static void RecordTranslatedColumn (void)
+{
+    RecordColumnCommand(drawtranscolumn);
+}
+
+static void RecordSpan (void)
+{
+    drawcmd_t*		cmd;
+
+    cmd = NewDrawCommand(drawspan);
+    cmd->span = true;
+    cmd->colormap = ds_colormap;
+    cmd->u.span.y = ds_y;
+    cmd->u.span.x1 = ds_x1;
+    cmd->u.span.x2 = ds_x2;
+    cmd->u.span.xfrac = ds_xfrac;
+    cmd->u.span.yfrac = ds_yfrac;
+    cmd->u.span.xstep = ds_xstep;
+    cmd->u.span.ystep = ds_ystep;
+    cmd->u.span.source = ds_source;
+}
+
+
+//
+// DrawStrip
+// Replays every recorded command that touches
+//  the given strip of view columns.
+//
+static void DrawStrip (void *data, int strip)
+{
+    drawcmd_t*		cmd;
+    drawcmd_t*		end;
+    int			x1;
+    int			x2;
+
+    x1 = (strip * viewwidth) / numstrips;
+    x2 = ((strip + 1) * viewwidth) / numstrips - 1;
+
+    end = drawcmds + numdrawcmds;
+
+    for (cmd = drawcmds; cmd < end; ++cmd)
+    {
+	if (!cmd->span)
+	{
+	    if (cmd->u.column.x < x1 || cmd->u.column.x > x2)
+		continue;
+
+	    dc_colormap = cmd->colormap;
+	    dc_x = cmd->u.column.x;
+	    dc_yl = cmd->u.column.yl;
+	    dc_yh = cmd->u.column.yh;
+	    dc_iscale = cmd->u.column.iscale;
+	    dc_texturemid = cmd->u.column.texturemid;
+	    dc_source = cmd->u.column.source;
+	    dc_translation = cmd->u.column.translation;
+	    fuzzpos = cmd->u.column.fuzzpos;
+	}
+	else
+	{
+	    if (cmd->u.span.x2 < x1 || cmd->u.span.x1 > x2)
+		continue;
+
+	    ds_colormap = cmd->colormap;
+	    ds_y = cmd->u.span.y;
+	    ds_x1 = cmd->u.span.x1;
+	    ds_x2 = cmd->u.span.x2;
+	    ds_xfrac = cmd->u.span.xfrac;
+	    ds_yfrac = cmd->u.span.yfrac;
+	    ds_xstep = cmd->u.span.xstep;
+	    ds_ystep = cmd->u.span.ystep;
+	    ds_source = cmd->u.span.source;
+
+	    // Cut the span down to this strip.
+	    if (ds_x1 < x1)
+	    {
+		R_AdvanceSpan(x1 - ds_x1);
+		ds_x1 = x1;
+	    }
+
+	    if (ds_x2 > x2)
+		ds_x2 = x2;
+	}
+
+	cmd->drawer();
+    }
+}
+
+
+//
+// R_FlushDrawCommands
+//
+void R_FlushDrawCommands (void)
+{
+    if (numdrawcmds == 0)
+	return;
+
+    I_RunParallel(DrawStrip, NULL, numstrips);
+
+    numdrawcmds = 0;
+}
+
+
+//
+// WaitForPipeline
+// Waits for the frame being drawn in the background.
+//
+static void WaitForPipeline (void)
+{
+    if (pipelinebatch == NULL)
+	return;
+
+    I_FinishBatch(pipelinebatch);
+    pipelinebatch = NULL;
+    numdrawcmds = 0;
+}
+
+
+//
+// R_StartPipelinedView
+// Starts drawing everything recorded for this frame
+//  into pipelinebuffer, without waiting.
+//
+void R_StartPipelinedView (void)
+{
+    pipelineready = true;
+
+    if (numdrawcmds == 0)
+	return;
+
+    pipelinebatch = I_StartBatch(DrawStrip, NULL, numstrips, true);
+}
+
+
+//
+// R_FinishPipelinedView
+// Copies the view started by R_StartPipelinedView to the screen,
+//  once it is finished.  Returns false if there was none.
+//
+boolean R_FinishPipelinedView (void)
+{
+    pixel_t*	src;
+    pixel_t*	dest;
+    int		y;
+
+    WaitForPipeline();
+
+    if (!pipelineready)
+	return false;
+
+    src = pipelinebuffer + viewwindowy*SCREENWIDTH + viewwindowx;
+    dest = I_VideoBuffer + viewwindowy*SCREENWIDTH + viewwindowx;
+
+    for (y=0; y<viewheight; ++y)
+    {
+	memcpy(dest, src, scaledviewwidth);
+	src += SCREENWIDTH;
+	dest += SCREENWIDTH;
+    }
+
+    pipelineready = false;
+
+    return true;
+}
+
+
+//
+// R_DropPipelinedView
+// Throws away the view being drawn in the background.
+//
+void R_DropPipelinedView (void)
+{
+    WaitForPipeline();
+    pipelineready = false;
+}
+
+
+//
+// PurgeHook
+// Recorded commands point into cached lumps,
+//  so they must be drawn before any of the cache is thrown out.
+//
+static void PurgeHook (void)
+{
+    WaitForPipeline();
+    R_FlushDrawCommands();
+}
+
+
+//
+// R_SetupThreadedDrawers
+//
+void R_SetupThreadedDrawers (void)
+{
+    if (!renderthreads)
+	return;
+
+    drawcolumn = basecolfunc;
+    drawfuzzcolumn = fuzzcolfunc;
+    drawtranscolumn = transcolfunc;
+    drawspan = spanfunc;
+
+    colfunc = basecolfunc = RecordColumn;
+    fuzzcolfunc = RecordFuzzColumn;
+    transcolfunc = RecordTranslatedColumn;
+    spanfunc = RecordSpan;
+}
+
+
+//
+// R_InitRenderThreads
+//
+void R_InitRenderThreads (void)
+{
+    int		p;
+    int		threads;
+
+    //!
+    // @arg <n>
+    // @category video
+    //
+    // Draw the 3D view using n threads, each drawing a vertical
+    // strip of the screen.  If n is 0, one thread is used for each
+    // CPU.  The picture drawn is identical to drawing with one
+    // thread.
+    //
+
+    p = M_CheckParmWithArgs("-renderthreads", 1);
+
+    threads = 1;
+
+    if (p)
+    {
+	threads = atoi(myargv[p + 1]);
+
+	if (threads <= 0)
+	    threads = I_GetNumCPUs();
+    }
+
+    //!
+    // @category video
+    //
+    // Draw the 3D view in the background while the next tic runs,
+    // using the threads given by -renderthreads, or one thread if
+    // it is not given.  The view shown lags one frame behind.
+    //
+
+    renderpipeline = M_CheckParm("-pipeline") > 0;
+
+    // The main thread is running the game, so the
+    //  background needs at least one thread of its own.
+    if (renderpipeline && threads < 2)
+	threads = 2;
+
+    if (threads > SCREENWIDTH / 2)
+	threads = SCREENWIDTH / 2;
+
+    if (threads <= 1)
+	return;
+
+    I_InitThreadPool(threads - 1);
+
+    numstrips = I_ThreadPoolSize();
+    renderthreads = numstrips > 1;
+    renderpipeline = renderpipeline && renderthreads;
+
+    if (renderpipeline)
+    {
+	pipelinebuffer = Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);
+	memset(pipelinebuffer, 0, SCREENWIDTH * SCREENHEIGHT);
+    }
+
+    if (renderthreads)
+	Z_AddPurgeHook(PurgeHook);
+}
+
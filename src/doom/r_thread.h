@@ -0,0 +1,53 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Multithreaded drawing of the player view.
+//
+
+
+#ifndef __R_THREAD__
+#define __R_THREAD__
+
+#include "doomtype.h"
+#include "i_video.h"
+
+// True if the view is being drawn by multiple threads.
+extern boolean		renderthreads;
+
+// True if the view is drawn in the background, with -pipeline,
+//  into pipelinebuffer instead of the screen.
+extern boolean		renderpipeline;
+extern pixel_t*		pipelinebuffer;
+
+// Called by R_Init.
+void R_InitRenderThreads (void);
+
+// Called by R_ExecuteSetViewSize, after the drawing
+//  functions for the detail level have been chosen.
+void R_SetupThreadedDrawers (void);
+
+// Draw everything recorded so far.
+// Called at the end of R_RenderPlayerView.
+void R_FlushDrawCommands (void);
+
+// With -pipeline, R_RenderPlayerView starts the frame it has
+//  recorded, and shows the one started the time before.
+void R_StartPipelinedView (void);
+boolean R_FinishPipelinedView (void);
+
+// Called when the view is not going to be shown, eg. with the
+//  automap up, or when its size changes.
+void R_DropPipelinedView (void);
+
+#endif
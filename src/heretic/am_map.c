@@ -22,7 +22,9 @@
 #include "deh_str.h"
 #include "i_timer.h"
 #include "i_video.h"
+#include "m_bbox.h"
 #include "m_controls.h"
+#include "m_linegrid.h"
 #include "p_local.h"
 #include "am_map.h"
 #include "am_data.h"
@@ -34,6 +36,9 @@ vertex_t KeyPoints[NUMKEYS];
 
 #define NUMALIAS 3              // Number of antialiased lines.
 
+// Things further than this outside the window can't be seen.
+#define THINGMARGIN (32 * FRACUNIT)
+
 const char *LevelNames[] = {
     // EPISODE 1 - THE CITY OF THE DAMNED
     "E1M1:  THE DOCKS",
@@ -433,6 +438,17 @@ void AM_clearMarks(void)
 // should be called at the start of every level
 // right now, i figure it out myself
 
+// Bounding box of a line, for the automap line grid.
+
+static boolean AM_lineBox(int i, fixed_t *box)
+{
+    box[BOXTOP] = lines[i].bbox[BOXTOP];
+    box[BOXBOTTOM] = lines[i].bbox[BOXBOTTOM];
+    box[BOXLEFT] = lines[i].bbox[BOXLEFT];
+    box[BOXRIGHT] = lines[i].bbox[BOXRIGHT];
+    return true;
+}
+
 void AM_LevelInit(void)
 {
     leveljuststarted = 0;
@@ -452,6 +468,15 @@ void AM_LevelInit(void)
     scale_ftom = FixedDiv(FRACUNIT, scale_mtof);
 }
 
+// Index the lines, so that only those near the window are drawn.
+// Called by P_SetupLevel, since the automap is left up while a
+// saved game loads.
+
+void AM_InitLineGrid(void)
+{
+    M_BuildLineGrid(numlines, AM_lineBox);
+}
+
 static boolean stopped = true;
 
 void AM_Stop(void)
@@ -1274,10 +1299,21 @@ void AM_drawGrid(int color)
 void AM_drawWalls(void)
 {
     int i;
+    int n, count;
+    const int *visible;
+    fixed_t box[4];
     static mline_t l;
 
-    for (i = 0; i < numlines; i++)
+    // Only lines that can touch the window need to be clipped.
+    box[BOXTOP] = m_y2;
+    box[BOXBOTTOM] = m_y;
+    box[BOXLEFT] = m_x;
+    box[BOXRIGHT] = m_x2;
+    count = M_FindGridLines(numlines, box, &visible);
+
+    for (n = 0; n < count; n++)
     {
+        i = visible[n];
         l.a.x = lines[i].v1->x;
         l.a.y = lines[i].v1->y;
         l.b.x = lines[i].v2->x;
@@ -1446,6 +1482,15 @@ void AM_drawThings(int colors, int colorrange)
         t = sectors[i].thinglist;
         while (t)
         {
+            // Skip things too far outside the window for any part of
+            // their triangles to show.
+            if (t->x < m_x - THINGMARGIN || t->x > m_x2 + THINGMARGIN
+             || t->y < m_y - THINGMARGIN || t->y > m_y2 + THINGMARGIN)
+            {
+                t = t->snext;
+                continue;
+            }
+
             AM_drawLineCharacter(thintriangle_guy, NUMTHINTRIANGLEGUYLINES,
                                  16 << FRACBITS, t->angle, colors + lightlev,
                                  t->x, t->y);
@@ -267,6 +267,7 @@ boolean P_ChickenMorphPlayer(player_t * player);
 boolean AM_Responder(event_t * ev);
 void AM_Ticker(void);
 void AM_Drawer(void);
+void AM_InitLineGrid(void);
 
 // ***** SB_BAR *****
 
@@ -647,6 +647,8 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
 // build subsector connect matrix
 //      P_ConnectSubsectors ();
 
+    AM_InitLineGrid();
+
 // preload graphics
     if (precache)
         R_PrecacheLevel();
@@ -448,6 +448,7 @@ extern byte *dc_source;         // first pixel in a column
 
 void R_DrawColumn(void);
 void R_DrawColumnLow(void);
+void R_DrawColumnVector(void);
 void R_DrawTLColumn(void);
 void R_DrawTLColumnLow(void);
 void R_DrawTranslatedColumn(void);
@@ -469,6 +470,7 @@ extern byte *dc_translation;
 
 void R_DrawSpan(void);
 void R_DrawSpanLow(void);
+void R_DrawSpanVector(void);
 
 void R_InitBuffer(int width, int height);
 void R_InitTranslationTables(void);
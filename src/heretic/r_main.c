@@ -19,7 +19,9 @@
 #include <math.h>
 #include "doomdef.h"
 #include "m_bbox.h"
+#include "p_local.h"
 #include "r_local.h"
+#include "r_simd.h"
 #include "tables.h"
 
 int viewangleoffset;
@@ -577,6 +579,13 @@ void R_ExecuteSetViewSize(void)
         tlcolfunc = R_DrawTLColumn;
         transcolfunc = R_DrawTranslatedColumn;
         spanfunc = R_DrawSpan;
+
+        // Use the vector versions if the CPU can.
+        if (drawkernels != NULL)
+        {
+            colfunc = basecolfunc = R_DrawColumnVector;
+            spanfunc = R_DrawSpanVector;
+        }
     }
     else
     {
@@ -678,6 +687,7 @@ void R_Init(void)
     R_InitSkyMap();
     printf (".");
     R_InitTranslationTables();
+    R_InitDrawKernels();
     framecount = 0;
 }
 
@@ -778,6 +788,7 @@ void R_SetupFrame(player_t * player)
         if (setblocks < 10)
         {
             R_DrawViewBorder();
+            SB_state = -1;      // the border is drawn over the bar's top
         }
         BorderNeedRefresh = false;
         BorderTopRefresh = false;
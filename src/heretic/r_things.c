@@ -21,6 +21,7 @@
 #include "i_swap.h"
 #include "i_system.h"
 #include "r_local.h"
+#include "r_sort.h"
 
 typedef struct
 {
@@ -814,47 +815,35 @@ void R_DrawPlayerSprites(void)
 
 vissprite_t vsprsortedhead;
 
+static sortkey_t vsprsortkeys[MAXVISSPRITES];
+static sortkey_t vsprsortscratch[MAXVISSPRITES];
+
 void R_SortVisSprites(void)
 {
     int i, count;
-    vissprite_t *ds, *best;
-    vissprite_t unsorted;
-    fixed_t bestscale;
+    vissprite_t *best;
 
     count = vissprite_p - vissprites;
 
-    unsorted.next = unsorted.prev = &unsorted;
     if (!count)
         return;
 
-    for (ds = vissprites; ds < vissprite_p; ds++)
+    for (i = 0; i < count; i++)
     {
-        ds->next = ds + 1;
-        ds->prev = ds - 1;
+        vsprsortkeys[i].key = vissprites[i].scale;
+        vsprsortkeys[i].index = i;
     }
-    vissprites[0].prev = &unsorted;
-    unsorted.next = &vissprites[0];
-    (vissprite_p - 1)->next = &unsorted;
-    unsorted.prev = vissprite_p - 1;
 
 //
-// pull the vissprites out by scale
+// stable, so that sprites of equal scale stay in the order
+// the old selection sort picked them
 //
-    best = 0;                   // shut up the compiler warning
+    R_StableSortKeys(vsprsortkeys, vsprsortscratch, count);
+
     vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
     for (i = 0; i < count; i++)
     {
-        bestscale = INT_MAX;
-        for (ds = unsorted.next; ds != &unsorted; ds = ds->next)
-        {
-            if (ds->scale < bestscale)
-            {
-                bestscale = ds->scale;
-                best = ds;
-            }
-        }
-        best->next->prev = best->prev;
-        best->prev->next = best->next;
+        best = &vissprites[vsprsortkeys[i].index];
         best->next = &vsprsortedhead;
         best->prev = vsprsortedhead.prev;
         vsprsortedhead.prev->next = best;
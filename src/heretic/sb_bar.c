@@ -16,6 +16,8 @@
 
 // SB_bar.c
 
+#include <string.h>
+
 #include "doomdef.h"
 #include "deh_str.h"
 #include "i_video.h"
@@ -539,6 +541,18 @@ static int oldkeys = -1;
 
 int playerkeys = 0;
 
+// What the inventory bar was last drawn with, so that it is only drawn
+// again when something on it changes.
+static int oldinvfirst;
+static int oldcurpos;
+static int oldinvtype[7];
+static int oldinvcount[7];
+static patch_t *oldinvgem[2];
+
+// The bottom of the screen as it was with the inventory bar drawn empty,
+// for putting back what was under a gem when it blinks.
+static pixel_t InvBarBackground[SCREENWIDTH * SBARHEIGHT];
+
 extern boolean automapactive;
 
 void SB_Drawer(void)
@@ -591,10 +605,6 @@ void SB_Drawer(void)
         }
         else
         {
-            if (SB_state != 1)
-            {
-                V_DrawPatch(34, 160, PatchINVBAR);
-            }
             DrawInventoryBar();
             SB_state = 1;
         }
@@ -729,8 +739,14 @@ void DrawCommonBar(void)
     int chainY;
     int healthPos;
 
-    V_DrawPatch(0, 148, PatchLTFCTOP);
-    V_DrawPatch(290, 148, PatchRTFCTOP);
+    // The tops of the bar stick up into the view, so they are drawn again
+    // whenever the view or the automap has been drawn under them.  A new
+    // border comes with a full redraw of the bar.
+    if (SB_state == -1 || automapactive || viewwindowy + viewheight > 148)
+    {
+        V_DrawPatch(0, 148, PatchLTFCTOP);
+        V_DrawPatch(290, 148, PatchRTFCTOP);
+    }
 
     if (oldhealth != HealthMarker)
     {
@@ -877,43 +893,142 @@ void DrawMainBar(void)
     }
 }
 
+//---------------------------------------------------------------------------
+//
+// FUNC RestoreInvGem
+//
+// Puts back what was under a gem that was drawn at x, y.  Returns false
+// if the gem reaches outside the bottom of the screen or into the
+// artifact slots, in which case the whole bar has to be drawn again.
+//
+//---------------------------------------------------------------------------
+
+static boolean RestoreInvGem(patch_t *gem, int x, int y)
+{
+    int left;
+    int top;
+    int width;
+    int height;
+
+    if (gem == NULL)
+    {
+        return true;
+    }
+    left = x - SHORT(gem->leftoffset);
+    top = y - SHORT(gem->topoffset);
+    width = SHORT(gem->width);
+    height = SHORT(gem->height);
+    if (left < 0 || left + width > SCREENWIDTH
+        || top < SCREENHEIGHT - SBARHEIGHT || top + height > SCREENHEIGHT
+        || (left + width > 50 && left < 50 + 7 * 31))
+    {
+        return false;
+    }
+    V_CopyRect(left, top - (SCREENHEIGHT - SBARHEIGHT), InvBarBackground,
+               width, height, left, top);
+    return true;
+}
+
 //---------------------------------------------------------------------------
 //
 // PROC DrawInventoryBar
 //
+// Only draws what has changed since the last frame: the whole bar if
+// anything in the slots has, otherwise just the gems as they blink.
+//
 //---------------------------------------------------------------------------
 
 void DrawInventoryBar(void)
 {
     const char *patch;
+    patch_t *gem[2];
+    boolean changed;
+    int type;
+    int count;
     int i;
     int x;
 
     x = inv_ptr - curpos;
-    UpdateState |= I_STATBAR;
-    V_DrawPatch(34, 160, PatchINVBAR);
+    changed = SB_state != 1 || x != oldinvfirst || curpos != oldcurpos;
     for (i = 0; i < 7; i++)
     {
-        //V_DrawPatch(50+i*31, 160, W_CacheLumpName("ARTIBOX", PU_CACHE));
+        type = arti_none;
+        count = 0;
         if (CPlayer->inventorySlotNum > x + i
             && CPlayer->inventory[x + i].type != arti_none)
         {
-            patch = DEH_String(patcharti[CPlayer->inventory[x + i].type]);
-
-            V_DrawPatch(50 + i * 31, 160, W_CacheLumpName(patch, PU_CACHE));
-            DrSmallNumber(CPlayer->inventory[x + i].count, 69 + i * 31, 182);
+            type = CPlayer->inventory[x + i].type;
+            count = CPlayer->inventory[x + i].count;
+        }
+        if (type != oldinvtype[i] || count != oldinvcount[i])
+        {
+            oldinvtype[i] = type;
+            oldinvcount[i] = count;
+            changed = true;
         }
     }
-    V_DrawPatch(50 + curpos * 31, 189, PatchSELECTBOX);
+
+    gem[0] = NULL;
+    gem[1] = NULL;
     if (x != 0)
     {
-        V_DrawPatch(38, 159, !(leveltime & 4) ? PatchINVLFGEM1 :
-                    PatchINVLFGEM2);
+        gem[0] = !(leveltime & 4) ? PatchINVLFGEM1 : PatchINVLFGEM2;
     }
     if (CPlayer->inventorySlotNum - x > 7)
     {
-        V_DrawPatch(269, 159, !(leveltime & 4) ?
-                    PatchINVRTGEM1 : PatchINVRTGEM2);
+        gem[1] = !(leveltime & 4) ? PatchINVRTGEM1 : PatchINVRTGEM2;
+    }
+    if (!changed
+        && ((gem[0] != oldinvgem[0] && !RestoreInvGem(oldinvgem[0], 38, 159))
+            || (gem[1] != oldinvgem[1]
+                && !RestoreInvGem(oldinvgem[1], 269, 159))))
+    {
+        changed = true;
+    }
+
+    if (changed)
+    {
+        V_DrawPatch(34, 160, PatchINVBAR);
+        memcpy(InvBarBackground,
+               I_VideoBuffer + (SCREENHEIGHT - SBARHEIGHT) * SCREENWIDTH,
+               sizeof(InvBarBackground));
+        for (i = 0; i < 7; i++)
+        {
+            //V_DrawPatch(50+i*31, 160, W_CacheLumpName("ARTIBOX", PU_CACHE));
+            if (oldinvtype[i] != arti_none)
+            {
+                patch = DEH_String(patcharti[oldinvtype[i]]);
+
+                V_DrawPatch(50 + i * 31, 160,
+                            W_CacheLumpName(patch, PU_CACHE));
+                DrSmallNumber(oldinvcount[i], 69 + i * 31, 182);
+            }
+        }
+        V_DrawPatch(50 + curpos * 31, 189, PatchSELECTBOX);
+        oldinvfirst = x;
+        oldcurpos = curpos;
+        oldinvgem[0] = NULL;
+        oldinvgem[1] = NULL;
+        UpdateState |= I_STATBAR;
+    }
+
+    if (gem[0] != oldinvgem[0])
+    {
+        if (gem[0] != NULL)
+        {
+            V_DrawPatch(38, 159, gem[0]);
+        }
+        oldinvgem[0] = gem[0];
+        UpdateState |= I_STATBAR;
+    }
+    if (gem[1] != oldinvgem[1])
+    {
+        if (gem[1] != NULL)
+        {
+            V_DrawPatch(269, 159, gem[1]);
+        }
+        oldinvgem[1] = gem[1];
+        UpdateState |= I_STATBAR;
     }
 }
 
@@ -21,7 +21,9 @@
 #include "i_video.h"
 #include "i_swap.h"
 #include "i_timer.h"
+#include "m_bbox.h"
 #include "m_controls.h"
+#include "m_linegrid.h"
 #include "m_misc.h"
 #include "p_local.h"
 #include "am_map.h"
@@ -30,6 +32,9 @@
 
 #define NUMALIAS 3              // Number of antialiased lines.
 
+// Things further than this outside the window can't be seen.
+#define THINGMARGIN (32 * FRACUNIT)
+
 int cheating = 0;
 static int grid = 0;
 
@@ -343,6 +348,52 @@ void AM_clearMarks(void)
 }
 */
 
+// Lines that belong to polyobjects, which move about the map, while
+// the line grid is being built.
+
+static byte *polyobjlines;
+
+// Bounding box of a line, for the automap line grid.
+
+static boolean AM_lineBox(int i, fixed_t *box)
+{
+    if (polyobjlines[i])
+    {
+        return false;
+    }
+
+    box[BOXTOP] = lines[i].bbox[BOXTOP];
+    box[BOXBOTTOM] = lines[i].bbox[BOXBOTTOM];
+    box[BOXLEFT] = lines[i].bbox[BOXLEFT];
+    box[BOXRIGHT] = lines[i].bbox[BOXRIGHT];
+    return true;
+}
+
+// Index the lines, so that only those near the window are drawn.
+// Called by P_SetupLevel, since the automap is left up while a hub
+// teleport or a saved game loads another map.
+
+void AM_InitLineGrid(void)
+{
+    int i, j;
+
+    polyobjlines = Z_Malloc(numlines + 1, PU_STATIC, NULL);
+    memset(polyobjlines, 0, numlines + 1);
+
+    for (i = 0; i < po_NumPolyobjs; i++)
+    {
+        for (j = 0; j < polyobjs[i].numsegs; j++)
+        {
+            polyobjlines[polyobjs[i].segs[j]->linedef - lines] = 1;
+        }
+    }
+
+    M_BuildLineGrid(numlines, AM_lineBox);
+
+    Z_Free(polyobjlines);
+    polyobjlines = NULL;
+}
+
 // should be called at the start of every level
 // right now, i figure it out myself
 
@@ -1172,10 +1223,21 @@ void AM_drawGrid(int color)
 void AM_drawWalls(void)
 {
     int i;
+    int n, count;
+    const int *visible;
+    fixed_t box[4];
     static mline_t l;
 
-    for (i = 0; i < numlines; i++)
+    // Only lines that can touch the window need to be clipped.
+    box[BOXTOP] = m_y2;
+    box[BOXBOTTOM] = m_y;
+    box[BOXLEFT] = m_x;
+    box[BOXRIGHT] = m_x2;
+    count = M_FindGridLines(numlines, box, &visible);
+
+    for (n = 0; n < count; n++)
     {
+        i = visible[n];
         l.a.x = lines[i].v1->x;
         l.a.y = lines[i].v1->y;
         l.b.x = lines[i].v2->x;
@@ -1331,6 +1393,15 @@ void AM_drawThings(int colors, int colorrange)
         t = sectors[i].thinglist;
         while (t)
         {
+            // Skip things too far outside the window for any part of
+            // their triangles to show.
+            if (t->x < m_x - THINGMARGIN || t->x > m_x2 + THINGMARGIN
+             || t->y < m_y - THINGMARGIN || t->y > m_y2 + THINGMARGIN)
+            {
+                t = t->snext;
+                continue;
+            }
+
             AM_drawLineCharacter(thintriangle_guy, NUMTHINTRIANGLEGUYLINES,
                                  16 << FRACBITS, t->angle, colors + lightlev,
                                  t->x, t->y);
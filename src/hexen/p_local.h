@@ -300,6 +300,7 @@ boolean P_MorphPlayer(player_t * player);
 boolean AM_Responder(event_t * ev);
 void AM_Ticker(void);
 void AM_Drawer(void);
+void AM_InitLineGrid(void);
 
 // ***** A_ACTION *****
 boolean A_LocalQuake(byte * args, mobj_t * victim);
@@ -756,6 +756,8 @@ void P_SetupLevel(int episode, int map, int playermask, skill_t skill)
 // build subsector connect matrix
 //      P_ConnectSubsectors ();
 
+    AM_InitLineGrid();
+
 // Load colormap and set the fullbright flag
     i = P_GetMapFadeTable(gamemap);
     W_ReadLump(i, colormaps);
@@ -19,6 +19,7 @@
 #include "i_system.h"
 #include "i_video.h"
 #include "r_local.h"
+#include "r_simd.h"
 #include "v_video.h"
 
 /*
@@ -83,6 +84,28 @@ void R_DrawColumn(void)
     while (count--);
 }
 
+// Same as R_DrawColumn, using the SSE2/AVX2/NEON kernel picked by
+// R_InitDrawKernels.
+
+void R_DrawColumnVector(void)
+{
+    int count;
+
+    count = dc_yh - dc_yl;
+    if (count < 0)
+        return;
+
+#ifdef RANGECHECK
+    if ((unsigned) dc_x >= SCREENWIDTH || dc_yl < 0 || dc_yh >= SCREENHEIGHT)
+        I_Error("R_DrawColumnVector: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+    drawkernels->column(ylookup[dc_yl] + columnofs[dc_x],
+                        dc_source, dc_colormap,
+                        dc_texturemid + (dc_yl - centery) * dc_iscale,
+                        dc_iscale, count + 1);
+}
+
 void R_DrawColumnLow(void)
 {
     int count;
@@ -379,6 +402,23 @@ void R_DrawSpan(void)
     while (count--);
 }
 
+// Same as R_DrawSpan, using the SSE2/AVX2/NEON kernel picked by
+// R_InitDrawKernels.
+
+void R_DrawSpanVector(void)
+{
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1 || ds_x1 < 0 || ds_x2 >= SCREENWIDTH
+        || (unsigned) ds_y > SCREENHEIGHT)
+        I_Error("R_DrawSpanVector: %i to %i at %i", ds_x1, ds_x2, ds_y);
+#endif
+
+    drawkernels->span(ylookup[ds_y] + columnofs[ds_x1],
+                      ds_source, ds_colormap,
+                      ds_xfrac, ds_yfrac, ds_xstep, ds_ystep,
+                      ds_x2 - ds_x1 + 1);
+}
+
 void R_DrawSpanLow(void)
 {
     fixed_t xfrac, yfrac;
@@ -19,7 +19,9 @@
 #include "m_random.h"
 #include "h2def.h"
 #include "m_bbox.h"
+#include "p_local.h"
 #include "r_local.h"
+#include "r_simd.h"
 
 int viewangleoffset;
 
@@ -579,6 +581,13 @@ void R_ExecuteSetViewSize(void)
         tlcolfunc = R_DrawTLColumn;
         transcolfunc = R_DrawTranslatedColumn;
         spanfunc = R_DrawSpan;
+
+        // Use the vector versions if the CPU can.
+        if (drawkernels != NULL)
+        {
+            colfunc = basecolfunc = R_DrawColumnVector;
+            spanfunc = R_DrawSpanVector;
+        }
     }
     else
     {
@@ -668,6 +677,7 @@ void R_Init(void)
     R_InitLightTables();
     R_InitSkyMap();
     R_InitTranslationTables();
+    R_InitDrawKernels();
     framecount = 0;
 }
 
@@ -770,6 +780,7 @@ void R_SetupFrame(player_t * player)
         if (setblocks < 10)
         {
             R_DrawViewBorder();
+            SB_state = -1;      // the border is drawn over the bar's top
         }
         BorderNeedRefresh = false;
         BorderTopRefresh = false;
@@ -740,6 +740,18 @@ static int oldpieces = -1;
 static int oldweapon = -1;
 static int oldkeys = -1;
 
+// What the inventory bar was last drawn with, so that it is only drawn
+// again when something on it changes.
+static int oldinvfirst;
+static int oldcurpos;
+static int oldinvtype[7];
+static int oldinvcount[7];
+static patch_t *oldinvgem[2];
+
+// The bottom of the screen as it was with the inventory bar drawn empty,
+// for putting back what was under a gem when it blinks.
+static pixel_t InvBarBackground[SCREENWIDTH * SBARHEIGHT];
+
 extern boolean automapactive;
 
 void SB_Drawer(void)
@@ -982,7 +994,13 @@ void DrawCommonBar(void)
 {
     int healthPos;
 
-    V_DrawPatch(0, 134, PatchH2TOP);
+    // The top of the bar sticks up into the view, so it is drawn again
+    // whenever the view or the automap has been drawn under it.  A new
+    // border comes with a full redraw of the bar.
+    if (SB_state == -1 || automapactive || viewwindowy + viewheight > 134)
+    {
+        V_DrawPatch(0, 134, PatchH2TOP);
+    }
 
     if (oldhealth != HealthMarker)
     {
@@ -1213,47 +1231,143 @@ void DrawMainBar(void)
     }
 }
 
+//==========================================================================
+//
+// RestoreInvGem
+//
+// Puts back what was under a gem that was drawn at x, y.  Returns false
+// if the gem reaches outside the bottom of the screen or into the
+// artifact slots, in which case the whole bar has to be drawn again.
+//
+//==========================================================================
+
+static boolean RestoreInvGem(patch_t *gem, int x, int y)
+{
+    int left;
+    int top;
+    int width;
+    int height;
+
+    if (gem == NULL)
+    {
+        return true;
+    }
+    left = x - SHORT(gem->leftoffset);
+    top = y - SHORT(gem->topoffset);
+    width = SHORT(gem->width);
+    height = SHORT(gem->height);
+    if (left < 0 || left + width > SCREENWIDTH
+        || top < SCREENHEIGHT - SBARHEIGHT || top + height > SCREENHEIGHT
+        || (left + width > 50 && left < 50 + 7 * 31))
+    {
+        return false;
+    }
+    V_CopyRect(left, top - (SCREENHEIGHT - SBARHEIGHT), InvBarBackground,
+               width, height, left, top);
+    return true;
+}
+
 //==========================================================================
 //
 // DrawInventoryBar
 //
+// Only draws what has changed since the last frame: the whole bar if
+// anything in the slots has, otherwise just the gems as they blink.
+//
 //==========================================================================
 
 void DrawInventoryBar(void)
 {
+    patch_t *gem[2];
+    boolean changed;
+    int type;
+    int count;
     int i;
     int x;
 
     x = inv_ptr - curpos;
-    UpdateState |= I_STATBAR;
-    V_DrawPatch(38, 162, PatchINVBAR);
+    changed = SB_state != 1 || x != oldinvfirst || curpos != oldcurpos;
     for (i = 0; i < 7; i++)
     {
-        //V_DrawPatch(50+i*31, 160, W_CacheLumpName("ARTIBOX", PU_CACHE));
+        type = arti_none;
+        count = 0;
         if (CPlayer->inventorySlotNum > x + i
             && CPlayer->inventory[x + i].type != arti_none)
         {
-            V_DrawPatch(50 + i * 31, 163,
-                        W_CacheLumpName(patcharti
-                                        [CPlayer->inventory[x + i].type],
-                                        PU_CACHE));
-            if (CPlayer->inventory[x + i].count > 1)
-            {
-                DrSmallNumber(CPlayer->inventory[x + i].count, 68 + i * 31,
-                              185);
-            }
+            type = CPlayer->inventory[x + i].type;
+            count = CPlayer->inventory[x + i].count;
+        }
+        if (type != oldinvtype[i] || count != oldinvcount[i])
+        {
+            oldinvtype[i] = type;
+            oldinvcount[i] = count;
+            changed = true;
         }
     }
-    V_DrawPatch(50 + curpos * 31, 163, PatchSELECTBOX);
+
+    gem[0] = NULL;
+    gem[1] = NULL;
     if (x != 0)
     {
-        V_DrawPatch(42, 163, !(leveltime & 4) ? PatchINVLFGEM1 :
-                    PatchINVLFGEM2);
+        gem[0] = !(leveltime & 4) ? PatchINVLFGEM1 : PatchINVLFGEM2;
     }
     if (CPlayer->inventorySlotNum - x > 7)
     {
-        V_DrawPatch(269, 163, !(leveltime & 4) ? PatchINVRTGEM1 :
-                    PatchINVRTGEM2);
+        gem[1] = !(leveltime & 4) ? PatchINVRTGEM1 : PatchINVRTGEM2;
+    }
+    if (!changed
+        && ((gem[0] != oldinvgem[0] && !RestoreInvGem(oldinvgem[0], 42, 163))
+            || (gem[1] != oldinvgem[1]
+                && !RestoreInvGem(oldinvgem[1], 269, 163))))
+    {
+        changed = true;
+    }
+
+    if (changed)
+    {
+        V_DrawPatch(38, 162, PatchINVBAR);
+        memcpy(InvBarBackground,
+               I_VideoBuffer + (SCREENHEIGHT - SBARHEIGHT) * SCREENWIDTH,
+               sizeof(InvBarBackground));
+        for (i = 0; i < 7; i++)
+        {
+            //V_DrawPatch(50+i*31, 160, W_CacheLumpName("ARTIBOX", PU_CACHE));
+            if (oldinvtype[i] != arti_none)
+            {
+                V_DrawPatch(50 + i * 31, 163,
+                            W_CacheLumpName(patcharti[oldinvtype[i]],
+                                            PU_CACHE));
+                if (oldinvcount[i] > 1)
+                {
+                    DrSmallNumber(oldinvcount[i], 68 + i * 31, 185);
+                }
+            }
+        }
+        V_DrawPatch(50 + curpos * 31, 163, PatchSELECTBOX);
+        oldinvfirst = x;
+        oldcurpos = curpos;
+        oldinvgem[0] = NULL;
+        oldinvgem[1] = NULL;
+        UpdateState |= I_STATBAR;
+    }
+
+    if (gem[0] != oldinvgem[0])
+    {
+        if (gem[0] != NULL)
+        {
+            V_DrawPatch(42, 163, gem[0]);
+        }
+        oldinvgem[0] = gem[0];
+        UpdateState |= I_STATBAR;
+    }
+    if (gem[1] != oldinvgem[1])
+    {
+        if (gem[1] != NULL)
+        {
+            V_DrawPatch(269, 163, gem[1]);
+        }
+        oldinvgem[1] = gem[1];
+        UpdateState |= I_STATBAR;
     }
 }
 
@@ -454,3 +454,21 @@ boolean I_GetMemoryValue(unsigned int offset, void *value, int size)
     return false;
 }
 
+int I_GetCPUFeatures(void)
+{
+    int result = 0;
+
+    if (SDL_HasSSE2())
+    {
+        result |= CPU_SSE2;
+    }
+
+#if SDL_VERSION_ATLEAST(2, 0, 4)
+    if (SDL_HasAVX2())
+    {
+        result |= CPU_AVX2;
+    }
+#endif
+
+    return result;
+}
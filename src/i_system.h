@@ -82,5 +82,14 @@ void I_PrintBanner(const char *text);
 
 void I_PrintDivider(void);
 
+// Instruction set extensions, as returned by I_GetCPUFeatures.
+
+#define CPU_SSE2        0x01
+#define CPU_AVX2        0x02
+
+// Get a mask of the CPU_* extensions supported by this machine.
+
+int I_GetCPUFeatures(void);
+
 #endif
 
@@ -0,0 +1,375 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Thread pool, used to spread work across multiple CPUs.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SDL.h"
+
+#include "i_system.h"
+#include "i_thread.h"
+
+#define MAX_WORKERS 64
+
+struct thread_batch_s
+{
+    thread_job_t func;
+    void *data;
+    int count;
+
+    // Index of the next job to hand out, and the number of jobs that
+    // have not yet completed.
+
+    int next;
+    int unfinished;
+
+    // If true, the batch goes ahead of background batches.
+
+    boolean urgent;
+
+    // Next batch in the queue.
+
+    thread_batch_t *queue_next;
+};
+
+static SDL_Thread *workers[MAX_WORKERS];
+static int num_workers = 0;
+
+// All of the following are protected by pool_lock.
+
+static SDL_mutex *pool_lock;
+static SDL_cond *work_cond;
+static SDL_cond *done_cond;
+
+// Batches that still have jobs to hand out. Batches from
+// I_RunParallel go on the front, then urgent batches, then
+// background batches.
+
+static thread_batch_t *queue;
+static boolean shutting_down;
+
+int I_GetNumCPUs(void)
+{
+    return SDL_GetCPUCount();
+}
+
+static void RemoveFromQueue(thread_batch_t *batch)
+{
+    thread_batch_t **rover;
+
+    for (rover = &queue; *rover != NULL; rover = &(*rover)->queue_next)
+    {
+        if (*rover == batch)
+        {
+            *rover = batch->queue_next;
+            break;
+        }
+    }
+}
+
+// Claim and run the next job from the given batch. Called with
+// pool_lock held; the lock is released while the job runs.
+
+static void RunJob(thread_batch_t *batch)
+{
+    int index;
+
+    index = batch->next++;
+
+    if (batch->next == batch->count)
+    {
+        RemoveFromQueue(batch);
+    }
+
+    SDL_UnlockMutex(pool_lock);
+    batch->func(batch->data, index);
+    SDL_LockMutex(pool_lock);
+
+    --batch->unfinished;
+
+    // Wake anyone in CompleteBatch or I_WaitForJob. The latter may be
+    // waiting for this one job rather than the whole batch.
+
+    SDL_CondBroadcast(done_cond);
+}
+
+// Run the rest of a batch's jobs in this thread and wait for any that
+// other threads are still running. Called with pool_lock held.
+
+static void CompleteBatch(thread_batch_t *batch)
+{
+    while (batch->next < batch->count)
+    {
+        RunJob(batch);
+    }
+
+    while (batch->unfinished > 0)
+    {
+        SDL_CondWait(done_cond, pool_lock);
+    }
+}
+
+static int SDLCALL WorkerThread(void *unused)
+{
+    SDL_LockMutex(pool_lock);
+
+    for (;;)
+    {
+        while (queue == NULL && !shutting_down)
+        {
+            SDL_CondWait(work_cond, pool_lock);
+        }
+
+        if (shutting_down)
+        {
+            break;
+        }
+
+        RunJob(queue);
+    }
+
+    SDL_UnlockMutex(pool_lock);
+
+    return 0;
+}
+
+static void I_ShutdownThreadPool(void)
+{
+    int i;
+
+    SDL_LockMutex(pool_lock);
+    shutting_down = true;
+    SDL_CondBroadcast(work_cond);
+    SDL_UnlockMutex(pool_lock);
+
+    for (i = 0; i < num_workers; ++i)
+    {
+        SDL_WaitThread(workers[i], NULL);
+    }
+
+    num_workers = 0;
+}
+
+void I_InitThreadPool(int count)
+{
+    if (count > MAX_WORKERS)
+    {
+        count = MAX_WORKERS;
+    }
+
+    if (num_workers >= count)
+    {
+        return;
+    }
+
+    if (pool_lock == NULL)
+    {
+        pool_lock = SDL_CreateMutex();
+        work_cond = SDL_CreateCond();
+        done_cond = SDL_CreateCond();
+
+        if (pool_lock == NULL || work_cond == NULL || done_cond == NULL)
+        {
+            I_Error("I_InitThreadPool: %s", SDL_GetError());
+        }
+
+        I_AtExit(I_ShutdownThreadPool, true);
+    }
+
+    while (num_workers < count)
+    {
+        workers[num_workers] = SDL_CreateThread(WorkerThread, "worker", NULL);
+
+        if (workers[num_workers] == NULL)
+        {
+            fprintf(stderr, "I_InitThreadPool: %s\n", SDL_GetError());
+            break;
+        }
+
+        ++num_workers;
+    }
+}
+
+int I_ThreadPoolSize(void)
+{
+    return num_workers + 1;
+}
+
+void I_RunParallel(thread_job_t func, void *data, int count)
+{
+    thread_batch_t batch;
+    int i;
+
+    // Without any workers, just run everything in this thread.
+
+    if (num_workers == 0)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            func(data, i);
+        }
+
+        return;
+    }
+
+    if (count <= 0)
+    {
+        return;
+    }
+
+    batch.func = func;
+    batch.data = data;
+    batch.count = count;
+    batch.next = 0;
+    batch.unfinished = count;
+    batch.urgent = true;
+
+    SDL_LockMutex(pool_lock);
+
+    batch.queue_next = queue;
+    queue = &batch;
+    SDL_CondBroadcast(work_cond);
+
+    // Help out with the batch rather than sitting idle.
+
+    CompleteBatch(&batch);
+
+    SDL_UnlockMutex(pool_lock);
+}
+
+thread_batch_t *I_StartBatch(thread_job_t func, void *data, int count,
+                             boolean urgent)
+{
+    thread_batch_t *batch;
+    thread_batch_t **rover;
+
+    batch = malloc(sizeof(thread_batch_t));
+
+    if (batch == NULL)
+    {
+        I_Error("I_StartBatch: Failed to allocate batch");
+    }
+
+    batch->func = func;
+    batch->data = data;
+    batch->count = count;
+    batch->next = 0;
+    batch->unfinished = count;
+    batch->urgent = urgent;
+    batch->queue_next = NULL;
+
+    if (num_workers == 0)
+    {
+        // Nobody else to run it.
+
+        while (batch->next < batch->count)
+        {
+            func(data, batch->next++);
+            --batch->unfinished;
+        }
+
+        return batch;
+    }
+
+    if (count <= 0)
+    {
+        return batch;
+    }
+
+    SDL_LockMutex(pool_lock);
+
+    rover = &queue;
+
+    while (*rover != NULL && (!urgent || (*rover)->urgent))
+    {
+        rover = &(*rover)->queue_next;
+    }
+
+    batch->queue_next = *rover;
+    *rover = batch;
+
+    SDL_CondBroadcast(work_cond);
+    SDL_UnlockMutex(pool_lock);
+
+    return batch;
+}
+
+boolean I_BatchFinished(thread_batch_t *batch)
+{
+    boolean result;
+
+    if (num_workers == 0)
+    {
+        return batch->unfinished == 0;
+    }
+
+    SDL_LockMutex(pool_lock);
+    result = batch->unfinished == 0;
+    SDL_UnlockMutex(pool_lock);
+
+    return result;
+}
+
+void I_FinishBatch(thread_batch_t *batch)
+{
+    if (num_workers > 0)
+    {
+        SDL_LockMutex(pool_lock);
+        CompleteBatch(batch);
+        SDL_UnlockMutex(pool_lock);
+    }
+
+    free(batch);
+}
+
+void I_WaitForJob(atomic_int_t *atomic, int value)
+{
+    // Without any workers, every job ran in I_StartBatch.
+
+    if (num_workers == 0 || I_AtomicGet(atomic) == value)
+    {
+        return;
+    }
+
+    // The job sets the value before RunJob takes the lock to
+    // broadcast done_cond, so checking with the lock held can't miss
+    // the wakeup.
+
+    SDL_LockMutex(pool_lock);
+
+    while (I_AtomicGet(atomic) != value)
+    {
+        SDL_CondWait(done_cond, pool_lock);
+    }
+
+    SDL_UnlockMutex(pool_lock);
+}
+
+boolean I_AtomicCAS(atomic_int_t *atomic, int oldval, int newval)
+{
+    return SDL_AtomicCAS((SDL_atomic_t *) atomic, oldval, newval) != SDL_FALSE;
+}
+
+int I_AtomicGet(atomic_int_t *atomic)
+{
+    return SDL_AtomicGet((SDL_atomic_t *) atomic);
+}
+
+void I_AtomicSet(atomic_int_t *atomic, int value)
+{
+    SDL_AtomicSet((SDL_atomic_t *) atomic, value);
+}
@@ -0,0 +1,101 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      System-specific thread pool interface.
+//
+
+
+#ifndef __I_THREAD__
+#define __I_THREAD__
+
+#include "doomtype.h"
+
+// Storage class for variables that need a separate copy in each
+// thread, eg. the parameters passed to the column and span drawers.
+
+#if defined(_MSC_VER)
+#define THREADLOCAL __declspec(thread)
+#else
+#define THREADLOCAL __thread
+#endif
+
+// A job function is called once for each index in a batch.
+
+typedef void (*thread_job_t)(void *data, int index);
+
+// A batch of jobs running in the background; see I_StartBatch.
+
+typedef struct thread_batch_s thread_batch_t;
+
+// An int that can be safely shared between threads, using the
+// I_Atomic* functions below.
+
+typedef struct
+{
+    int value;
+} atomic_int_t;
+
+// Returns the number of logical CPUs in the system.
+
+int I_GetNumCPUs(void);
+
+// Start the given number of worker threads, or add to the pool if it
+// is already running with fewer. The thread that calls I_RunParallel
+// also takes part in running jobs, so a pool with n workers runs up
+// to n + 1 jobs at once.
+
+void I_InitThreadPool(int num_workers);
+
+// Returns the number of threads that run jobs, including the caller.
+
+int I_ThreadPoolSize(void);
+
+// Call func(data, i) for each i from 0 to count - 1, spread across
+// the thread pool, and wait until all of the calls have completed.
+// Must only be called from the main thread.
+
+void I_RunParallel(thread_job_t func, void *data, int count);
+
+// Queue func(data, i) for each i from 0 to count - 1 to be run by the
+// worker threads, and return without waiting. Jobs from I_RunParallel
+// are always run ahead of these; urgent batches, for work needed this
+// frame, are run ahead of the others. If there are no workers, the
+// jobs are run before returning.
+
+thread_batch_t *I_StartBatch(thread_job_t func, void *data, int count,
+                             boolean urgent);
+
+// Returns true if every job in the batch has completed.
+
+boolean I_BatchFinished(thread_batch_t *batch);
+
+// Wait for the batch to complete, helping to run any of its jobs that
+// have not yet started, then free it.
+
+void I_FinishBatch(thread_batch_t *batch);
+
+// Sleep until the atomic int has the given value, which must be set
+// by one of the jobs run by the thread pool.
+
+void I_WaitForJob(atomic_int_t *atomic, int value);
+
+// Atomic operations. I_AtomicCAS sets the value to newval only if it
+// is currently oldval, and returns true if it did so.
+
+boolean I_AtomicCAS(atomic_int_t *atomic, int oldval, int newval);
+int I_AtomicGet(atomic_int_t *atomic);
+void I_AtomicSet(atomic_int_t *atomic, int value);
+
+#endif
+
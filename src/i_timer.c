@@ -58,6 +58,22 @@ int I_GetTimeMS(void)
     return ticks - basetime;
 }
 
+//
+// High resolution timer, in microseconds, for timing parts of a frame.
+// The starting point is arbitrary; only differences are meaningful.
+//
+
+uint64_t I_GetTimeUS(void)
+{
+    Uint64 counter, frequency;
+
+    counter = SDL_GetPerformanceCounter();
+    frequency = SDL_GetPerformanceFrequency();
+
+    return (counter / frequency) * 1000000
+         + ((counter % frequency) * 1000000) / frequency;
+}
+
 // Sleep for a specified number of ms
 
 void I_Sleep(int ms)
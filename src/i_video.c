@@ -69,13 +69,6 @@ static SDL_Surface *argbbuffer = NULL;
 static SDL_Texture *texture = NULL;
 static SDL_Texture *texture_upscaled = NULL;
 
-static SDL_Rect blit_rect = {
-    0,
-    0,
-    SCREENWIDTH,
-    SCREENHEIGHT
-};
-
 static uint32_t pixel_format;
 
 // palette
@@ -83,6 +76,16 @@ static uint32_t pixel_format;
 static SDL_Color palette[256];
 static boolean palette_to_set;
 
+// The palette as pixels of the RGBA buffer.
+
+static uint32_t argb_palette[256];
+
+// The screen as it was last loaded into the texture, so that only the
+// rows that have changed since need to be converted and loaded again.
+
+static pixel_t last_screen[SCREENWIDTH * SCREENHEIGHT];
+static boolean full_update;
+
 // display has been set up?
 
 static boolean initialized = false;
@@ -687,6 +690,68 @@ static void CreateUpscaledTexture(boolean force)
     }
 }
 
+// Convert the rows of the screen buffer that have changed since the last
+// update to RGBA, and load each run of them into the texture.
+
+static void UpdateTexture(void)
+{
+    const pixel_t *src;
+    pixel_t *last;
+    uint32_t *dest;
+    SDL_Rect rect;
+    boolean changed;
+    int top;
+    int x, y;
+
+    top = -1;
+
+    for (y = 0; y <= SCREENHEIGHT; ++y)
+    {
+        src = I_VideoBuffer + y * SCREENWIDTH;
+        last = last_screen + y * SCREENWIDTH;
+
+        changed = y < SCREENHEIGHT
+               && (full_update
+                || memcmp(src, last, SCREENWIDTH * sizeof(*src)) != 0);
+
+        if (changed)
+        {
+            dest = (uint32_t *) ((byte *) argbbuffer->pixels
+                                 + y * argbbuffer->pitch);
+
+            for (x = 0; x < SCREENWIDTH; x += 4)
+            {
+                dest[x] = argb_palette[src[x]];
+                dest[x + 1] = argb_palette[src[x + 1]];
+                dest[x + 2] = argb_palette[src[x + 2]];
+                dest[x + 3] = argb_palette[src[x + 3]];
+            }
+
+            memcpy(last, src, SCREENWIDTH * sizeof(*src));
+
+            if (top < 0)
+            {
+                top = y;
+            }
+        }
+        else if (top >= 0)
+        {
+            rect.x = 0;
+            rect.y = top;
+            rect.w = SCREENWIDTH;
+            rect.h = y - top;
+
+            SDL_UpdateTexture(texture, &rect,
+                              (byte *) argbbuffer->pixels
+                                  + top * argbbuffer->pitch,
+                              argbbuffer->pitch);
+            top = -1;
+        }
+    }
+
+    full_update = false;
+}
+
 //
 // I_FinishUpdate
 //
@@ -763,6 +828,16 @@ void I_FinishUpdate (void)
         SDL_SetPaletteColors(screenbuffer->format->palette, palette, 0, 256);
         palette_to_set = false;
 
+        for (i = 0; i < 256; ++i)
+        {
+            argb_palette[i] = SDL_MapRGB(argbbuffer->format, palette[i].r,
+                                         palette[i].g, palette[i].b);
+        }
+
+        // Every pixel of the texture has to be converted again.
+
+        full_update = true;
+
         if (vga_porch_flash)
         {
             // "flash" the pillars/letterboxes with palette changes, emulating
@@ -772,14 +847,10 @@ void I_FinishUpdate (void)
         }
     }
 
-    // Blit from the paletted 8-bit screen buffer to the intermediate
-    // 32-bit RGBA buffer that we can load into the texture.
-
-    SDL_LowerBlit(screenbuffer, &blit_rect, argbbuffer, &blit_rect);
+    // Convert what has changed of the paletted 8-bit screen buffer to the
+    // intermediate 32-bit RGBA buffer, and load that into the texture.
 
-    // Update the intermediate texture with the contents of the RGBA buffer.
-
-    SDL_UpdateTexture(texture, NULL, argbbuffer->pixels, argbbuffer->pitch);
+    UpdateTexture();
 
     // Make sure the pillarboxes are kept clear each frame.
 
@@ -1349,6 +1420,11 @@ static void SetVideoMode(void)
                                 SDL_TEXTUREACCESS_STREAMING,
                                 SCREENWIDTH, SCREENHEIGHT);
 
+    // Convert the palette for the new RGBA buffer, which also fills it
+    // and the new texture from scratch.
+
+    palette_to_set = true;
+
     // Initially create the upscaled texture for rendering to screen
 
     CreateUpscaledTexture(true);
@@ -0,0 +1,328 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Grid of line bounding boxes, used by the automaps to find the
+//      lines inside the visible window.
+//
+//      Each cell of the grid lists the lines whose bounding boxes
+//      touch it. A search marks the lines from every cell it covers
+//      in a bitmap, one bit per line, then reads the bitmap back.
+//      That removes the duplicates of lines that cover several cells
+//      and puts the lines back in their original order, so that the
+//      automap draws overlapping lines in the same order as before.
+//
+
+#include <limits.h>
+#include <string.h>
+
+#include "i_system.h"
+#include "m_bbox.h"
+#include "m_linegrid.h"
+#include "z_zone.h"
+
+// Cells are at least 128 map units across, as big as blockmap
+// blocks, and are made bigger on huge maps so that there are at most
+// MAX_CELLS of them along each side.
+
+#define MIN_CELL_SHIFT (FRACBITS + 7)
+#define MAX_CELLS 256
+
+static int num_lines;
+
+static fixed_t grid_x, grid_y;
+static int grid_shift;
+static int grid_width, grid_height;
+
+// Lines in each cell: cell i holds cell_lines[cell_start[i]] to
+// cell_lines[cell_start[i + 1] - 1].
+
+static int *cell_start;
+static int *cell_lines;
+
+// Lines that can move, and so are not in the grid.
+
+static int *moving_lines;
+static int num_moving_lines;
+
+// One bit for each line, set during a search, and the results.
+
+static unsigned int *found_bits;
+static int *found_lines;
+
+static void FreeGrid(void)
+{
+    if (cell_start != NULL)
+    {
+        Z_Free(cell_start);
+        Z_Free(cell_lines);
+        Z_Free(moving_lines);
+        Z_Free(found_bits);
+        Z_Free(found_lines);
+        cell_start = NULL;
+    }
+
+    num_lines = 0;
+}
+
+static int CellX(fixed_t x)
+{
+    int64_t cell = ((int64_t) x - grid_x) >> grid_shift;
+
+    if (cell < 0)
+    {
+        return 0;
+    }
+    else if (cell >= grid_width)
+    {
+        return grid_width - 1;
+    }
+
+    return (int) cell;
+}
+
+static int CellY(fixed_t y)
+{
+    int64_t cell = ((int64_t) y - grid_y) >> grid_shift;
+
+    if (cell < 0)
+    {
+        return 0;
+    }
+    else if (cell >= grid_height)
+    {
+        return grid_height - 1;
+    }
+
+    return (int) cell;
+}
+
+// Find the range of cells that a box touches.
+
+static void CellRange(const fixed_t *box, int *x1, int *x2, int *y1, int *y2)
+{
+    *x1 = CellX(box[BOXLEFT]);
+    *x2 = CellX(box[BOXRIGHT]);
+    *y1 = CellY(box[BOXBOTTOM]);
+    *y2 = CellY(box[BOXTOP]);
+}
+
+void M_BuildLineGrid(int count, linegrid_box_t getbox)
+{
+    fixed_t box[4];
+    fixed_t extent[4];
+    int num_cells, num_entries;
+    int x1, x2, y1, y2;
+    int x, y, cell;
+    int i;
+
+    FreeGrid();
+
+    // Find the extent of the lines, and how many grid entries there
+    // will be in total.
+
+    M_ClearBox(extent);
+    num_moving_lines = 0;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (getbox(i, box))
+        {
+            M_AddToBox(extent, box[BOXLEFT], box[BOXBOTTOM]);
+            M_AddToBox(extent, box[BOXRIGHT], box[BOXTOP]);
+        }
+        else
+        {
+            ++num_moving_lines;
+        }
+    }
+
+    if (extent[BOXLEFT] > extent[BOXRIGHT])
+    {
+        // Nothing but moving lines.
+
+        M_AddToBox(extent, 0, 0);
+    }
+
+    grid_x = extent[BOXLEFT];
+    grid_y = extent[BOXBOTTOM];
+    grid_shift = MIN_CELL_SHIFT;
+
+    while (((int64_t) extent[BOXRIGHT] - grid_x) >> grid_shift >= MAX_CELLS
+        || ((int64_t) extent[BOXTOP] - grid_y) >> grid_shift >= MAX_CELLS)
+    {
+        ++grid_shift;
+    }
+
+    grid_width = (int) ((((int64_t) extent[BOXRIGHT] - grid_x)
+                         >> grid_shift) + 1);
+    grid_height = (int) ((((int64_t) extent[BOXTOP] - grid_y)
+                          >> grid_shift) + 1);
+    num_cells = grid_width * grid_height;
+
+    // Count the lines in each cell, then turn the counts into start
+    // positions, leaving each start just past the end of its cell so
+    // that the lines can be filled in backwards.
+
+    cell_start = Z_Malloc((num_cells + 1) * sizeof(int), PU_STATIC, NULL);
+    memset(cell_start, 0, (num_cells + 1) * sizeof(int));
+
+    for (i = 0; i < count; ++i)
+    {
+        if (getbox(i, box))
+        {
+            CellRange(box, &x1, &x2, &y1, &y2);
+
+            for (y = y1; y <= y2; ++y)
+            {
+                for (x = x1; x <= x2; ++x)
+                {
+                    ++cell_start[y * grid_width + x];
+                }
+            }
+        }
+    }
+
+    num_entries = 0;
+
+    for (cell = 0; cell <= num_cells; ++cell)
+    {
+        num_entries += cell_start[cell];
+        cell_start[cell] = num_entries;
+    }
+
+    cell_lines = Z_Malloc((num_entries + 1) * sizeof(int), PU_STATIC, NULL);
+    moving_lines = Z_Malloc((num_moving_lines + 1) * sizeof(int),
+                            PU_STATIC, NULL);
+    num_moving_lines = 0;
+
+    for (i = count - 1; i >= 0; --i)
+    {
+        if (getbox(i, box))
+        {
+            CellRange(box, &x1, &x2, &y1, &y2);
+
+            for (y = y1; y <= y2; ++y)
+            {
+                for (x = x1; x <= x2; ++x)
+                {
+                    cell = y * grid_width + x;
+                    cell_lines[--cell_start[cell]] = i;
+                }
+            }
+        }
+        else
+        {
+            moving_lines[num_moving_lines++] = i;
+        }
+    }
+
+    found_bits = Z_Malloc((count / 32 + 1) * sizeof(unsigned int),
+                          PU_STATIC, NULL);
+    memset(found_bits, 0, (count / 32 + 1) * sizeof(unsigned int));
+    found_lines = Z_Malloc((count + 1) * sizeof(int), PU_STATIC, NULL);
+
+    num_lines = count;
+}
+
+static void MarkLine(int line, int *low, int *high)
+{
+    found_bits[line / 32] |= 1U << (line % 32);
+
+    if (line / 32 < *low)
+    {
+        *low = line / 32;
+    }
+
+    if (line / 32 > *high)
+    {
+        *high = line / 32;
+    }
+}
+
+int M_FindGridLines(int numlines, const fixed_t *box, const int **result)
+{
+    unsigned int bits;
+    int low, high, count;
+    int x1, x2, y1, y2;
+    int x, y, cell;
+    int i;
+
+    // A grid left over from another level would give out line
+    // numbers that are wrong, or past the end of the lines.
+
+    if (numlines != num_lines)
+    {
+        I_Error("M_FindGridLines: Grid has %i lines, not %i",
+                num_lines, numlines);
+    }
+
+    *result = found_lines;
+
+    if (num_lines == 0)
+    {
+        return 0;
+    }
+
+    low = INT_MAX;
+    high = -1;
+
+    for (i = 0; i < num_moving_lines; ++i)
+    {
+        MarkLine(moving_lines[i], &low, &high);
+    }
+
+    // Nothing in the grid can overlap a box that is entirely off one
+    // side of it.
+
+    if (box[BOXRIGHT] >= grid_x && box[BOXTOP] >= grid_y
+     && ((int64_t) box[BOXLEFT] - grid_x) >> grid_shift < grid_width
+     && ((int64_t) box[BOXBOTTOM] - grid_y) >> grid_shift < grid_height)
+    {
+        CellRange(box, &x1, &x2, &y1, &y2);
+
+        for (y = y1; y <= y2; ++y)
+        {
+            for (x = x1; x <= x2; ++x)
+            {
+                cell = y * grid_width + x;
+
+                for (i = cell_start[cell]; i < cell_start[cell + 1]; ++i)
+                {
+                    MarkLine(cell_lines[i], &low, &high);
+                }
+            }
+        }
+    }
+
+    // Read back the bitmap in order, clearing it for the next search.
+
+    count = 0;
+
+    for (i = low; i <= high; ++i)
+    {
+        bits = found_bits[i];
+        found_bits[i] = 0;
+
+        for (x = 0; bits != 0; ++x, bits >>= 1)
+        {
+            if ((bits & 1) != 0)
+            {
+                found_lines[count++] = i * 32 + x;
+            }
+        }
+    }
+
+    return count;
+}
+
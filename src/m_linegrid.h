@@ -0,0 +1,46 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Grid of line bounding boxes, used by the automaps to find the
+//      lines inside the visible window.
+//
+
+
+#ifndef __M_LINEGRID__
+#define __M_LINEGRID__
+
+#include "doomtype.h"
+#include "m_fixed.h"
+
+// Fill in the bounding box of line number index, indexed by BOXTOP
+// etc. as in m_bbox.h. Returns false for a line that can move, such
+// as a Hexen polyobject line, which is then returned by every search.
+
+typedef boolean (*linegrid_box_t)(int index, fixed_t *box);
+
+// Build the grid for lines 0 to count-1, replacing any previous one.
+
+void M_BuildLineGrid(int count, linegrid_box_t getbox);
+
+// Find the lines whose bounding boxes overlap the given box, plus any
+// lines that can move. The line numbers are stored in increasing
+// order in an array owned by the grid, which is valid until the next
+// call; the number found is returned. numlines is the number of
+// lines the caller has now, which must be the number the grid was
+// built for.
+
+int M_FindGridLines(int numlines, const fixed_t *box, const int **result);
+
+#endif
+
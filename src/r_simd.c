@@ -0,0 +1,1571 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Vectorized column and span drawing kernels, shared by all games.
+//
+//      The texture coordinates for several pixels are stepped at once
+//      in vector registers.  Where the CPU has gather instructions
+//      (AVX2), the texture and colormap lookups are done with them
+//      too; otherwise the lookups are done one pixel at a time from
+//      the vector of coordinates.
+//
+//      Each set of kernels is checked against the plain C versions
+//      at startup and is only used if it draws exactly the same
+//      pixels.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "i_video.h"
+#include "m_argv.h"
+#include "m_fixed.h"
+#include "r_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__) \
+ || defined(_M_X64) || defined(_M_IX86)
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_NEON_KERNELS
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang need to be told which functions may use instructions
+// beyond the ones enabled for the whole program.
+
+#if defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+// Mask applied to the texture row in R_DrawColumn.
+#define COLUMN_MASK 127
+
+// Columns and spans shorter than this are drawn by the C versions,
+// which are faster for them: setting up the vectors costs more than
+// it saves over so few pixels.
+#define MIN_VECTOR_COUNT 8
+
+const drawkernels_t *drawkernels = NULL;
+
+// The fastest of the kernels that passed the check, taken from
+// whichever sets are best for each.
+
+static drawkernels_t selected_kernels;
+
+//
+// Plain C versions of the kernels. These match the drawing functions
+// in the games exactly, and are used to check the vector versions
+// and to draw the pixels left over at the end of a column or span.
+//
+
+static void DrawColumn_C(byte *dest, const byte *source, const byte *colormap,
+                         fixed_t frac, fixed_t fracstep, int count)
+{
+    while (count > 0)
+    {
+        *dest = colormap[source[(frac >> FRACBITS) & COLUMN_MASK]];
+        dest += SCREENWIDTH;
+        frac += fracstep;
+        --count;
+    }
+}
+
+static void DrawPackedSpan_C(byte *dest, const byte *source,
+                             const byte *colormap, unsigned int position,
+                             unsigned int step, int count)
+{
+    unsigned int spot;
+
+    while (count > 0)
+    {
+        spot = ((position >> 4) & 0x0fc0) | (position >> 26);
+        *dest++ = colormap[source[spot]];
+        position += step;
+        --count;
+    }
+}
+
+static void DrawSpan_C(byte *dest, const byte *source, const byte *colormap,
+                       fixed_t xfrac, fixed_t yfrac,
+                       fixed_t xstep, fixed_t ystep, int count)
+{
+    int spot;
+
+    while (count > 0)
+    {
+        spot = ((yfrac >> (16 - 6)) & (63 * 64)) + ((xfrac >> 16) & 63);
+        *dest++ = colormap[source[spot]];
+        xfrac += xstep;
+        yfrac += ystep;
+        --count;
+    }
+}
+
+// Index into a 64KB translucency table, for blending pixel p over the
+// pixel d already on the screen.
+
+#define BLEND_INDEX(d, p, swapped) \
+    ((swapped) ? (d) + ((p) << 8) : ((d) << 8) + (p))
+
+static void DrawTLColumn_C(byte *dest, const byte *source,
+                           const byte *translation, const byte *colormap,
+                           const byte *table, fixed_t frac, fixed_t fracstep,
+                           int count, boolean swapped)
+{
+    byte pixel;
+
+    while (count > 0)
+    {
+        pixel = source[(frac >> FRACBITS) & COLUMN_MASK];
+
+        if (translation != NULL)
+        {
+            pixel = translation[pixel];
+        }
+
+        pixel = colormap[pixel];
+        *dest = table[BLEND_INDEX(*dest, pixel, swapped)];
+        dest += SCREENWIDTH;
+        frac += fracstep;
+        --count;
+    }
+}
+
+static void BlendColumn_C(byte *dest, const byte *source, const byte *table,
+                          int count, boolean swapped)
+{
+    while (count > 0)
+    {
+        *dest = table[BLEND_INDEX(*dest, *source, swapped)];
+        ++source;
+        dest += SCREENWIDTH;
+        --count;
+    }
+}
+
+// Transposes are done in square tiles, so that both the reads and the
+// writes stay within a few cache lines at a time.
+
+#define TRANSPOSE_TILE 16
+
+static void Transpose_C(byte *dest, int dest_pitch,
+                        const byte *source, int source_pitch,
+                        int width, int height)
+{
+    int tx, ty, x, y, xend, yend;
+
+    for (ty = 0; ty < height; ty += TRANSPOSE_TILE)
+    {
+        yend = ty + TRANSPOSE_TILE < height ? ty + TRANSPOSE_TILE : height;
+
+        for (tx = 0; tx < width; tx += TRANSPOSE_TILE)
+        {
+            xend = tx + TRANSPOSE_TILE < width ? tx + TRANSPOSE_TILE : width;
+
+            for (y = ty; y < yend; ++y)
+            {
+                for (x = tx; x < xend; ++x)
+                {
+                    dest[x * dest_pitch + y] = source[y * source_pitch + x];
+                }
+            }
+        }
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+//
+// SSE2 kernels. SSE2 has no gather, so four texture coordinates are
+// stepped at once and the lookups are done from the stored result.
+//
+
+TARGET_SSE2
+static void DrawColumn_SSE2(byte *dest, const byte *source,
+                            const byte *colormap,
+                            fixed_t frac, fixed_t fracstep, int count)
+{
+    __m128i fracs, step4, mask, rows;
+    int row[4];
+
+    if (count < MIN_VECTOR_COUNT)
+    {
+        DrawColumn_C(dest, source, colormap, frac, fracstep, count);
+        return;
+    }
+
+    fracs = _mm_add_epi32(_mm_set1_epi32(frac),
+                          _mm_setr_epi32(0, fracstep, fracstep * 2,
+                                         fracstep * 3));
+    step4 = _mm_set1_epi32(fracstep * 4);
+    mask = _mm_set1_epi32(COLUMN_MASK);
+
+    while (count >= 4)
+    {
+        rows = _mm_and_si128(_mm_srli_epi32(fracs, FRACBITS), mask);
+        _mm_storeu_si128((__m128i *) row, rows);
+
+        dest[0] = colormap[source[row[0]]];
+        dest[SCREENWIDTH] = colormap[source[row[1]]];
+        dest[SCREENWIDTH * 2] = colormap[source[row[2]]];
+        dest[SCREENWIDTH * 3] = colormap[source[row[3]]];
+
+        fracs = _mm_add_epi32(fracs, step4);
+        frac += fracstep * 4;
+        dest += SCREENWIDTH * 4;
+        count -= 4;
+    }
+
+    DrawColumn_C(dest, source, colormap, frac, fracstep, count);
+}
+
+TARGET_SSE2
+static void DrawPackedSpan_SSE2(byte *dest, const byte *source,
+                                const byte *colormap, unsigned int position,
+                                unsigned int step, int count)
+{
+    __m128i pos, step4, mask, spots;
+    int spot[4];
+
+    if (count < MIN_VECTOR_COUNT)
+    {
+        DrawPackedSpan_C(dest, source, colormap, position, step, count);
+        return;
+    }
+
+    pos = _mm_add_epi32(_mm_set1_epi32((int) position),
+                        _mm_setr_epi32(0, (int) step, (int) (step * 2),
+                                       (int) (step * 3)));
+    step4 = _mm_set1_epi32((int) (step * 4));
+    mask = _mm_set1_epi32(0x0fc0);
+
+    while (count >= 4)
+    {
+        spots = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(pos, 4), mask),
+                             _mm_srli_epi32(pos, 26));
+        _mm_storeu_si128((__m128i *) spot, spots);
+
+        dest[0] = colormap[source[spot[0]]];
+        dest[1] = colormap[source[spot[1]]];
+        dest[2] = colormap[source[spot[2]]];
+        dest[3] = colormap[source[spot[3]]];
+
+        pos = _mm_add_epi32(pos, step4);
+        position += step * 4;
+        dest += 4;
+        count -= 4;
+    }
+
+    DrawPackedSpan_C(dest, source, colormap, position, step, count);
+}
+
+TARGET_SSE2
+static void DrawSpan_SSE2(byte *dest, const byte *source, const byte *colormap,
+                          fixed_t xfrac, fixed_t yfrac,
+                          fixed_t xstep, fixed_t ystep, int count)
+{
+    __m128i xfracs, yfracs, xstep4, ystep4, xmask, ymask, spots;
+    int spot[4];
+
+    if (count < MIN_VECTOR_COUNT)
+    {
+        DrawSpan_C(dest, source, colormap, xfrac, yfrac, xstep, ystep, count);
+        return;
+    }
+
+    xfracs = _mm_add_epi32(_mm_set1_epi32(xfrac),
+                           _mm_setr_epi32(0, xstep, xstep * 2, xstep * 3));
+    yfracs = _mm_add_epi32(_mm_set1_epi32(yfrac),
+                           _mm_setr_epi32(0, ystep, ystep * 2, ystep * 3));
+    xstep4 = _mm_set1_epi32(xstep * 4);
+    ystep4 = _mm_set1_epi32(ystep * 4);
+    xmask = _mm_set1_epi32(63);
+    ymask = _mm_set1_epi32(63 * 64);
+
+    while (count >= 4)
+    {
+        spots = _mm_add_epi32(
+            _mm_and_si128(_mm_srli_epi32(yfracs, 16 - 6), ymask),
+            _mm_and_si128(_mm_srli_epi32(xfracs, 16), xmask));
+        _mm_storeu_si128((__m128i *) spot, spots);
+
+        dest[0] = colormap[source[spot[0]]];
+        dest[1] = colormap[source[spot[1]]];
+        dest[2] = colormap[source[spot[2]]];
+        dest[3] = colormap[source[spot[3]]];
+
+        xfracs = _mm_add_epi32(xfracs, xstep4);
+        yfracs = _mm_add_epi32(yfracs, ystep4);
+        xfrac += xstep * 4;
+        yfrac += ystep * 4;
+        dest += 4;
+        count -= 4;
+    }
+
+    DrawSpan_C(dest, source, colormap, xfrac, yfrac, xstep, ystep, count);
+}
+
+// Transpose one 16x16 tile. Four rounds of interleaving the bytes of
+// the top half of the rows with the bottom half leaves each row
+// holding what was a column.
+
+TARGET_SSE2
+static void TransposeTile_SSE2(byte *dest, int dest_pitch,
+                               const byte *source, int source_pitch)
+{
+    __m128i rows[2][16];
+    __m128i *in, *out, *swap;
+    int i, round;
+
+    in = rows[0];
+    out = rows[1];
+
+    for (i = 0; i < 16; ++i)
+    {
+        in[i] = _mm_loadu_si128((const __m128i *) (source + i * source_pitch));
+    }
+
+    for (round = 0; round < 4; ++round)
+    {
+        for (i = 0; i < 8; ++i)
+        {
+            out[i * 2] = _mm_unpacklo_epi8(in[i], in[i + 8]);
+            out[i * 2 + 1] = _mm_unpackhi_epi8(in[i], in[i + 8]);
+        }
+
+        swap = in;
+        in = out;
+        out = swap;
+    }
+
+    for (i = 0; i < 16; ++i)
+    {
+        _mm_storeu_si128((__m128i *) (dest + i * dest_pitch), in[i]);
+    }
+}
+
+TARGET_SSE2
+static void Transpose_SSE2(byte *dest, int dest_pitch,
+                           const byte *source, int source_pitch,
+                           int width, int height)
+{
+    int fullwidth, fullheight;
+    int x, y;
+
+    fullwidth = width & ~(TRANSPOSE_TILE - 1);
+    fullheight = height & ~(TRANSPOSE_TILE - 1);
+
+    for (y = 0; y < fullheight; y += TRANSPOSE_TILE)
+    {
+        for (x = 0; x < fullwidth; x += TRANSPOSE_TILE)
+        {
+            TransposeTile_SSE2(dest + x * dest_pitch + y, dest_pitch,
+                               source + y * source_pitch + x, source_pitch);
+        }
+    }
+
+    // Whatever is left over at the right and bottom edges.
+
+    Transpose_C(dest + fullwidth * dest_pitch, dest_pitch,
+                source + fullwidth, source_pitch,
+                width - fullwidth, height);
+    Transpose_C(dest + fullheight, dest_pitch,
+                source + fullheight * source_pitch, source_pitch,
+                fullwidth, height - fullheight);
+}
+
+TARGET_SSE2
+static void DrawTLColumn_SSE2(byte *dest, const byte *source,
+                              const byte *translation, const byte *colormap,
+                              const byte *table, fixed_t frac,
+                              fixed_t fracstep, int count, boolean swapped)
+{
+    __m128i fracs, step4, mask, rows;
+    int row[4];
+    byte pixel;
+    int i;
+
+    fracs = _mm_add_epi32(_mm_set1_epi32(frac),
+                          _mm_setr_epi32(0, fracstep, fracstep * 2,
+                                         fracstep * 3));
+    step4 = _mm_set1_epi32(fracstep * 4);
+    mask = _mm_set1_epi32(COLUMN_MASK);
+
+    while (count >= 4)
+    {
+        rows = _mm_and_si128(_mm_srli_epi32(fracs, FRACBITS), mask);
+        _mm_storeu_si128((__m128i *) row, rows);
+
+        for (i = 0; i < 4; ++i)
+        {
+            pixel = source[row[i]];
+
+            if (translation != NULL)
+            {
+                pixel = translation[pixel];
+            }
+
+            pixel = colormap[pixel];
+            *dest = table[BLEND_INDEX(*dest, pixel, swapped)];
+            dest += SCREENWIDTH;
+        }
+
+        fracs = _mm_add_epi32(fracs, step4);
+        frac += fracstep * 4;
+        count -= 4;
+    }
+
+    DrawTLColumn_C(dest, source, translation, colormap, table,
+                   frac, fracstep, count, swapped);
+}
+
+static const drawkernels_t sse2_kernels =
+{
+    "SSE2",
+    DrawColumn_SSE2,
+    DrawPackedSpan_SSE2,
+    DrawSpan_SSE2,
+    Transpose_SSE2,
+    DrawTLColumn_SSE2,
+    BlendColumn_C,
+};
+
+//
+// AVX2 kernels. Eight pixels are done at once, with both the texture
+// and the colormap lookups done by gathers.
+//
+// A gather loads 32 bits from each address, so rather than reading up
+// to three bytes past the end of the table (which might be the end of
+// the WAD file mapping) each load starts three bytes early and the
+// wanted byte is taken from the top of the result. Textures, flats
+// and colormaps all sit some way into a lump or a zone block, so the
+// bytes before them are always readable.
+//
+
+TARGET_AVX2
+static __m256i Lookup8(const byte *table, __m256i index)
+{
+    __m256i result;
+
+    result = _mm256_i32gather_epi32((const int *) (table - 3), index, 1);
+
+    return _mm256_srli_epi32(result, 24);
+}
+
+// Narrow eight 32-bit values (all less than 256) down to bytes.
+
+TARGET_AVX2
+static __m128i PackPixels8(__m256i pixels)
+{
+    __m128i words;
+
+    words = _mm_packs_epi32(_mm256_castsi256_si128(pixels),
+                            _mm256_extracti128_si256(pixels, 1));
+
+    return _mm_packus_epi16(words, words);
+}
+
+TARGET_AVX2
+static void DrawColumn_AVX2(byte *dest, const byte *source,
+                            const byte *colormap,
+                            fixed_t frac, fixed_t fracstep, int count)
+{
+    __m256i fracs, step8, mask, rows, pixels;
+    byte pixel[16];
+    int i;
+
+    if (count < MIN_VECTOR_COUNT)
+    {
+        DrawColumn_C(dest, source, colormap, frac, fracstep, count);
+        return;
+    }
+
+    fracs = _mm256_add_epi32(_mm256_set1_epi32(frac),
+                             _mm256_mullo_epi32(_mm256_set1_epi32(fracstep),
+                                 _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    step8 = _mm256_set1_epi32(fracstep * 8);
+    mask = _mm256_set1_epi32(COLUMN_MASK);
+
+    while (count >= 8)
+    {
+        rows = _mm256_and_si256(_mm256_srli_epi32(fracs, FRACBITS), mask);
+        pixels = Lookup8(colormap, Lookup8(source, rows));
+        _mm_storeu_si128((__m128i *) pixel, PackPixels8(pixels));
+
+        for (i = 0; i < 8; ++i)
+        {
+            *dest = pixel[i];
+            dest += SCREENWIDTH;
+        }
+
+        fracs = _mm256_add_epi32(fracs, step8);
+        frac += fracstep * 8;
+        count -= 8;
+    }
+
+    DrawColumn_C(dest, source, colormap, frac, fracstep, count);
+}
+
+TARGET_AVX2
+static void DrawPackedSpan_AVX2(byte *dest, const byte *source,
+                                const byte *colormap, unsigned int position,
+                                unsigned int step, int count)
+{
+    __m256i pos, step8, mask, spots, pixels;
+
+    if (count < MIN_VECTOR_COUNT)
+    {
+        DrawPackedSpan_C(dest, source, colormap, position, step, count);
+        return;
+    }
+
+    pos = _mm256_add_epi32(_mm256_set1_epi32((int) position),
+                           _mm256_mullo_epi32(_mm256_set1_epi32((int) step),
+                               _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    step8 = _mm256_set1_epi32((int) (step * 8));
+    mask = _mm256_set1_epi32(0x0fc0);
+
+    while (count >= 8)
+    {
+        spots = _mm256_or_si256(
+            _mm256_and_si256(_mm256_srli_epi32(pos, 4), mask),
+            _mm256_srli_epi32(pos, 26));
+        pixels = Lookup8(colormap, Lookup8(source, spots));
+        _mm_storel_epi64((__m128i *) dest, PackPixels8(pixels));
+
+        pos = _mm256_add_epi32(pos, step8);
+        position += step * 8;
+        dest += 8;
+        count -= 8;
+    }
+
+    DrawPackedSpan_C(dest, source, colormap, position, step, count);
+}
+
+TARGET_AVX2
+static void DrawSpan_AVX2(byte *dest, const byte *source, const byte *colormap,
+                          fixed_t xfrac, fixed_t yfrac,
+                          fixed_t xstep, fixed_t ystep, int count)
+{
+    __m256i lanes, xfracs, yfracs, xstep8, ystep8, xmask, ymask;
+    __m256i spots, pixels;
+
+    if (count < MIN_VECTOR_COUNT)
+    {
+        DrawSpan_C(dest, source, colormap, xfrac, yfrac, xstep, ystep, count);
+        return;
+    }
+
+    lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    xfracs = _mm256_add_epi32(_mm256_set1_epi32(xfrac),
+                 _mm256_mullo_epi32(_mm256_set1_epi32(xstep), lanes));
+    yfracs = _mm256_add_epi32(_mm256_set1_epi32(yfrac),
+                 _mm256_mullo_epi32(_mm256_set1_epi32(ystep), lanes));
+    xstep8 = _mm256_set1_epi32(xstep * 8);
+    ystep8 = _mm256_set1_epi32(ystep * 8);
+    xmask = _mm256_set1_epi32(63);
+    ymask = _mm256_set1_epi32(63 * 64);
+
+    while (count >= 8)
+    {
+        spots = _mm256_add_epi32(
+            _mm256_and_si256(_mm256_srli_epi32(yfracs, 16 - 6), ymask),
+            _mm256_and_si256(_mm256_srli_epi32(xfracs, 16), xmask));
+        pixels = Lookup8(colormap, Lookup8(source, spots));
+        _mm_storel_epi64((__m128i *) dest, PackPixels8(pixels));
+
+        xfracs = _mm256_add_epi32(xfracs, xstep8);
+        yfracs = _mm256_add_epi32(yfracs, ystep8);
+        xfrac += xstep * 8;
+        yfrac += ystep * 8;
+        dest += 8;
+        count -= 8;
+    }
+
+    DrawSpan_C(dest, source, colormap, xfrac, yfrac, xstep, ystep, count);
+}
+
+// Read eight pixels down a column of the screen.
+
+TARGET_AVX2
+static __m256i LoadColumn8(const byte *dest)
+{
+    return _mm256_setr_epi32(dest[0], dest[SCREENWIDTH],
+                             dest[SCREENWIDTH * 2], dest[SCREENWIDTH * 3],
+                             dest[SCREENWIDTH * 4], dest[SCREENWIDTH * 5],
+                             dest[SCREENWIDTH * 6], dest[SCREENWIDTH * 7]);
+}
+
+// Blend eight pixels over eight screen pixels through the table, and
+// write the result back down the column.
+
+TARGET_AVX2
+static void BlendColumn8(byte *dest, __m256i pixels, const byte *table,
+                         boolean swapped)
+{
+    __m256i under, index;
+    byte pixel[16];
+    int i;
+
+    under = LoadColumn8(dest);
+
+    if (swapped)
+    {
+        index = _mm256_add_epi32(under, _mm256_slli_epi32(pixels, 8));
+    }
+    else
+    {
+        index = _mm256_add_epi32(_mm256_slli_epi32(under, 8), pixels);
+    }
+
+    _mm_storeu_si128((__m128i *) pixel, PackPixels8(Lookup8(table, index)));
+
+    for (i = 0; i < 8; ++i)
+    {
+        dest[i * SCREENWIDTH] = pixel[i];
+    }
+}
+
+TARGET_AVX2
+static void DrawTLColumn_AVX2(byte *dest, const byte *source,
+                              const byte *translation, const byte *colormap,
+                              const byte *table, fixed_t frac,
+                              fixed_t fracstep, int count, boolean swapped)
+{
+    __m256i fracs, step8, mask, pixels;
+
+    fracs = _mm256_add_epi32(_mm256_set1_epi32(frac),
+                             _mm256_mullo_epi32(_mm256_set1_epi32(fracstep),
+                                 _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+    step8 = _mm256_set1_epi32(fracstep * 8);
+    mask = _mm256_set1_epi32(COLUMN_MASK);
+
+    while (count >= 8)
+    {
+        pixels = Lookup8(source, _mm256_and_si256(
+                             _mm256_srli_epi32(fracs, FRACBITS), mask));
+
+        if (translation != NULL)
+        {
+            pixels = Lookup8(translation, pixels);
+        }
+
+        BlendColumn8(dest, Lookup8(colormap, pixels), table, swapped);
+
+        fracs = _mm256_add_epi32(fracs, step8);
+        frac += fracstep * 8;
+        dest += SCREENWIDTH * 8;
+        count -= 8;
+    }
+
+    DrawTLColumn_C(dest, source, translation, colormap, table,
+                   frac, fracstep, count, swapped);
+}
+
+TARGET_AVX2
+static void BlendColumn_AVX2(byte *dest, const byte *source,
+                             const byte *table, int count, boolean swapped)
+{
+    __m256i pixels;
+
+    while (count >= 8)
+    {
+        pixels = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64((const __m128i *) source));
+        BlendColumn8(dest, pixels, table, swapped);
+
+        source += 8;
+        dest += SCREENWIDTH * 8;
+        count -= 8;
+    }
+
+    BlendColumn_C(dest, source, table, count, swapped);
+}
+
+static const drawkernels_t avx2_kernels =
+{
+    "AVX2",
+    DrawColumn_AVX2,
+    DrawPackedSpan_AVX2,
+    DrawSpan_AVX2,
+    Transpose_SSE2,
+    DrawTLColumn_AVX2,
+    BlendColumn_AVX2,
+};
+
+#endif /* #ifdef HAVE_X86_KERNELS */
+
+#ifdef HAVE_NEON_KERNELS
+
+//
+// NEON kernels. NEON has no gather either, so these work like the
+// SSE2 versions.
+//
+
+static const uint32_t lane_numbers[4] = { 0, 1, 2, 3 };
+
+static void DrawColumn_NEON(byte *dest, const byte *source,
+                            const byte *colormap,
+                            fixed_t frac, fixed_t fracstep, int count)
+{
+    uint32x4_t fracs, step4, mask;
+    uint32_t row[4];
+
+    if (count < MIN_VECTOR_COUNT)
+    {
+        DrawColumn_C(dest, source, colormap, frac, fracstep, count);
+        return;
+    }
+
+    fracs = vmlaq_n_u32(vdupq_n_u32((uint32_t) frac),
+                        vld1q_u32(lane_numbers), (uint32_t) fracstep);
+    step4 = vdupq_n_u32((uint32_t) fracstep * 4);
+    mask = vdupq_n_u32(COLUMN_MASK);
+
+    while (count >= 4)
+    {
+        vst1q_u32(row, vandq_u32(vshrq_n_u32(fracs, FRACBITS), mask));
+
+        dest[0] = colormap[source[row[0]]];
+        dest[SCREENWIDTH] = colormap[source[row[1]]];
+        dest[SCREENWIDTH * 2] = colormap[source[row[2]]];
+        dest[SCREENWIDTH * 3] = colormap[source[row[3]]];
+
+        fracs = vaddq_u32(fracs, step4);
+        frac += fracstep * 4;
+        dest += SCREENWIDTH * 4;
+        count -= 4;
+    }
+
+    DrawColumn_C(dest, source, colormap, frac, fracstep, count);
+}
+
+static void DrawPackedSpan_NEON(byte *dest, const byte *source,
+                                const byte *colormap, unsigned int position,
+                                unsigned int step, int count)
+{
+    uint32x4_t pos, step4, mask, spots;
+    uint32_t spot[4];
+
+    if (count < MIN_VECTOR_COUNT)
+    {
+        DrawPackedSpan_C(dest, source, colormap, position, step, count);
+        return;
+    }
+
+    pos = vmlaq_n_u32(vdupq_n_u32(position), vld1q_u32(lane_numbers), step);
+    step4 = vdupq_n_u32(step * 4);
+    mask = vdupq_n_u32(0x0fc0);
+
+    while (count >= 4)
+    {
+        spots = vorrq_u32(vandq_u32(vshrq_n_u32(pos, 4), mask),
+                          vshrq_n_u32(pos, 26));
+        vst1q_u32(spot, spots);
+
+        dest[0] = colormap[source[spot[0]]];
+        dest[1] = colormap[source[spot[1]]];
+        dest[2] = colormap[source[spot[2]]];
+        dest[3] = colormap[source[spot[3]]];
+
+        pos = vaddq_u32(pos, step4);
+        position += step * 4;
+        dest += 4;
+        count -= 4;
+    }
+
+    DrawPackedSpan_C(dest, source, colormap, position, step, count);
+}
+
+static void DrawSpan_NEON(byte *dest, const byte *source, const byte *colormap,
+                          fixed_t xfrac, fixed_t yfrac,
+                          fixed_t xstep, fixed_t ystep, int count)
+{
+    uint32x4_t xfracs, yfracs, xstep4, ystep4, xmask, ymask, spots;
+    uint32_t spot[4];
+
+    if (count < MIN_VECTOR_COUNT)
+    {
+        DrawSpan_C(dest, source, colormap, xfrac, yfrac, xstep, ystep, count);
+        return;
+    }
+
+    xfracs = vmlaq_n_u32(vdupq_n_u32((uint32_t) xfrac),
+                         vld1q_u32(lane_numbers), (uint32_t) xstep);
+    yfracs = vmlaq_n_u32(vdupq_n_u32((uint32_t) yfrac),
+                         vld1q_u32(lane_numbers), (uint32_t) ystep);
+    xstep4 = vdupq_n_u32((uint32_t) xstep * 4);
+    ystep4 = vdupq_n_u32((uint32_t) ystep * 4);
+    xmask = vdupq_n_u32(63);
+    ymask = vdupq_n_u32(63 * 64);
+
+    while (count >= 4)
+    {
+        spots = vaddq_u32(vandq_u32(vshrq_n_u32(yfracs, 16 - 6), ymask),
+                          vandq_u32(vshrq_n_u32(xfracs, 16), xmask));
+        vst1q_u32(spot, spots);
+
+        dest[0] = colormap[source[spot[0]]];
+        dest[1] = colormap[source[spot[1]]];
+        dest[2] = colormap[source[spot[2]]];
+        dest[3] = colormap[source[spot[3]]];
+
+        xfracs = vaddq_u32(xfracs, xstep4);
+        yfracs = vaddq_u32(yfracs, ystep4);
+        xfrac += xstep * 4;
+        yfrac += ystep * 4;
+        dest += 4;
+        count -= 4;
+    }
+
+    DrawSpan_C(dest, source, colormap, xfrac, yfrac, xstep, ystep, count);
+}
+
+static void DrawTLColumn_NEON(byte *dest, const byte *source,
+                              const byte *translation, const byte *colormap,
+                              const byte *table, fixed_t frac,
+                              fixed_t fracstep, int count, boolean swapped)
+{
+    uint32x4_t fracs, step4, mask;
+    uint32_t row[4];
+    byte pixel;
+    int i;
+
+    fracs = vmlaq_n_u32(vdupq_n_u32((uint32_t) frac),
+                        vld1q_u32(lane_numbers), (uint32_t) fracstep);
+    step4 = vdupq_n_u32((uint32_t) fracstep * 4);
+    mask = vdupq_n_u32(COLUMN_MASK);
+
+    while (count >= 4)
+    {
+        vst1q_u32(row, vandq_u32(vshrq_n_u32(fracs, FRACBITS), mask));
+
+        for (i = 0; i < 4; ++i)
+        {
+            pixel = source[row[i]];
+
+            if (translation != NULL)
+            {
+                pixel = translation[pixel];
+            }
+
+            pixel = colormap[pixel];
+            *dest = table[BLEND_INDEX(*dest, pixel, swapped)];
+            dest += SCREENWIDTH;
+        }
+
+        fracs = vaddq_u32(fracs, step4);
+        frac += fracstep * 4;
+        count -= 4;
+    }
+
+    DrawTLColumn_C(dest, source, translation, colormap, table,
+                   frac, fracstep, count, swapped);
+}
+
+static const drawkernels_t neon_kernels =
+{
+    "NEON",
+    DrawColumn_NEON,
+    DrawPackedSpan_NEON,
+    DrawSpan_NEON,
+    Transpose_C,
+    DrawTLColumn_NEON,
+    BlendColumn_C,
+};
+
+#endif /* #ifdef HAVE_NEON_KERNELS */
+
+//
+// Self check.
+//
+
+#define TEST_RUNS 512
+
+// Room left before the texture and colormap, for the gathers.
+#define TEST_PADDING 16
+
+static unsigned int test_seed;
+
+// The checks must not disturb the game's random number generator,
+// so use a separate one.
+
+static unsigned int TestRandom(void)
+{
+    test_seed = test_seed * 1103515245 + 12345;
+
+    return test_seed >> 8;
+}
+
+static unsigned int TestStep(void)
+{
+    // Mostly the sort of steps seen in play, with the occasional
+    // wild one.
+
+    if ((TestRandom() & 7) == 0)
+    {
+        return TestRandom() ^ (TestRandom() << 16);
+    }
+    else
+    {
+        return (TestRandom() & 0x3ffff) - 0x20000;
+    }
+}
+
+static boolean CheckKernels(const drawkernels_t *kernels, boolean translucent)
+{
+    byte *texture_block, *colormap_block, *table_block, *translation_block;
+    byte *texture, *colormap, *table, *translation;
+    byte *expected, *result, *transposed;
+    boolean swapped;
+    boolean ok = true;
+    unsigned int a, b, c, d;
+    int x, y, count;
+    int i;
+
+    texture_block = malloc(TEST_PADDING + 64 * 64);
+    colormap_block = malloc(TEST_PADDING + 256);
+    table_block = malloc(TEST_PADDING + 256 * 256);
+    translation_block = malloc(TEST_PADDING + 256);
+    expected = malloc(SCREENWIDTH * SCREENHEIGHT);
+    result = malloc(SCREENWIDTH * SCREENHEIGHT);
+    transposed = malloc(SCREENWIDTH * SCREENHEIGHT);
+
+    if (texture_block == NULL || colormap_block == NULL
+     || table_block == NULL || translation_block == NULL
+     || expected == NULL || result == NULL || transposed == NULL)
+    {
+        I_Error("CheckKernels: Failed to allocate test buffers");
+    }
+
+    texture = texture_block + TEST_PADDING;
+    colormap = colormap_block + TEST_PADDING;
+    table = table_block + TEST_PADDING;
+    translation = translation_block + TEST_PADDING;
+
+    test_seed = 1;
+
+    for (i = 0; i < TEST_PADDING + 64 * 64; ++i)
+    {
+        texture_block[i] = TestRandom() & 0xff;
+    }
+
+    for (i = 0; i < TEST_PADDING + 256; ++i)
+    {
+        colormap_block[i] = TestRandom() & 0xff;
+    }
+
+    for (i = 0; i < TEST_PADDING + 256 * 256; ++i)
+    {
+        table_block[i] = TestRandom() & 0xff;
+    }
+
+    for (i = 0; i < TEST_PADDING + 256; ++i)
+    {
+        translation_block[i] = TestRandom() & 0xff;
+    }
+
+    memset(expected, 0, SCREENWIDTH * SCREENHEIGHT);
+    memset(result, 0, SCREENWIDTH * SCREENHEIGHT);
+
+    for (i = 0; i < TEST_RUNS && ok; ++i)
+    {
+        a = TestRandom() ^ (TestRandom() << 16);
+        b = TestStep();
+        c = TestRandom() ^ (TestRandom() << 16);
+        d = TestStep();
+
+        x = TestRandom() % SCREENWIDTH;
+        y = TestRandom() % SCREENHEIGHT;
+
+        count = 1 + TestRandom() % (SCREENHEIGHT - y);
+        DrawColumn_C(expected + y * SCREENWIDTH + x, texture, colormap,
+                     a, b, count);
+        kernels->column(result + y * SCREENWIDTH + x, texture, colormap,
+                        a, b, count);
+
+        count = 1 + TestRandom() % (SCREENWIDTH - x);
+        DrawPackedSpan_C(expected + y * SCREENWIDTH + x, texture, colormap,
+                         a, b, count);
+        kernels->packedspan(result + y * SCREENWIDTH + x, texture, colormap,
+                            a, b, count);
+
+        y = TestRandom() % SCREENHEIGHT;
+        DrawSpan_C(expected + y * SCREENWIDTH + x, texture, colormap,
+                   a, c, b, d, count);
+        kernels->span(result + y * SCREENWIDTH + x, texture, colormap,
+                      a, c, b, d, count);
+
+        ok = memcmp(expected, result, SCREENWIDTH * SCREENHEIGHT) == 0;
+    }
+
+    // Transpose the last test picture, at an awkward size so that the
+    // edges are covered too. "expected" is the same as "result" by now.
+
+    if (ok)
+    {
+        memset(transposed, 0, SCREENWIDTH * SCREENHEIGHT);
+        memset(expected, 0, SCREENWIDTH * SCREENHEIGHT);
+
+        Transpose_C(expected, SCREENHEIGHT, result, SCREENWIDTH,
+                    SCREENWIDTH - 3, SCREENHEIGHT - 5);
+        kernels->transpose(transposed, SCREENHEIGHT, result, SCREENWIDTH,
+                           SCREENWIDTH - 3, SCREENHEIGHT - 5);
+
+        ok = memcmp(expected, transposed, SCREENWIDTH * SCREENHEIGHT) == 0;
+    }
+
+    // Translucent drawing blends with what is already on the screen,
+    // so start both pictures from the same random one. Only kernelbench
+    // uses the translucent kernels, so only it checks them.
+
+    for (i = 0; i < SCREENWIDTH * SCREENHEIGHT; ++i)
+    {
+        expected[i] = TestRandom() & 0xff;
+    }
+
+    memcpy(result, expected, SCREENWIDTH * SCREENHEIGHT);
+
+    for (i = 0; i < TEST_RUNS && ok && translucent; ++i)
+    {
+        a = TestRandom() ^ (TestRandom() << 16);
+        b = TestStep();
+        swapped = (i & 1) != 0;
+
+        x = TestRandom() % SCREENWIDTH;
+        y = TestRandom() % SCREENHEIGHT;
+        count = 1 + TestRandom() % (SCREENHEIGHT - y);
+
+        DrawTLColumn_C(expected + y * SCREENWIDTH + x, texture,
+                       (i & 2) != 0 ? translation : NULL, colormap, table,
+                       a, b, count, swapped);
+        kernels->tlcolumn(result + y * SCREENWIDTH + x, texture,
+                          (i & 2) != 0 ? translation : NULL, colormap, table,
+                          a, b, count, swapped);
+
+        // Patch posts are at most 128 pixels long.
+
+        x = TestRandom() % SCREENWIDTH;
+        y = TestRandom() % (SCREENHEIGHT - 128);
+        count = 1 + TestRandom() % 128;
+        c = TestRandom() % (64 * 64 - 128);
+
+        BlendColumn_C(expected + y * SCREENWIDTH + x, texture + c, table,
+                      count, swapped);
+        kernels->blendcolumn(result + y * SCREENWIDTH + x, texture + c,
+                             table, count, swapped);
+
+        ok = memcmp(expected, result, SCREENWIDTH * SCREENHEIGHT) == 0;
+    }
+
+    free(texture_block);
+    free(colormap_block);
+    free(table_block);
+    free(translation_block);
+    free(expected);
+    free(result);
+    free(transposed);
+
+    return ok;
+}
+
+// Returns true if the kernels draw the same pixels as the C versions.
+
+static boolean TryKernels(const drawkernels_t *kernels)
+{
+    if (CheckKernels(kernels, false))
+    {
+        return true;
+    }
+
+    fprintf(stderr, "R_InitDrawKernels: %s drawing functions do not "
+                    "match the C versions, not using them.\n",
+                    kernels->name);
+
+    return false;
+}
+
+void R_InitDrawKernels(void)
+{
+    const drawkernels_t *columns = NULL;
+    const drawkernels_t *spans = NULL;
+    int features;
+
+    drawkernels = NULL;
+
+    //!
+    // @category video
+    //
+    // Don't use the SSE2, AVX2 or NEON versions of the column, span
+    // and transpose functions.
+    //
+
+    if (M_CheckParm("-nosimd") > 0)
+    {
+        return;
+    }
+
+    features = I_GetCPUFeatures();
+
+#ifdef HAVE_X86_KERNELS
+    // Each kernel is taken from the set that is fastest for it in
+    // kernelbench. The AVX2 gathers make its spans faster than SSE2,
+    // but its column is slower than both SSE2 and C: the pixels still
+    // have to be stored one row apart, so the gathers don't pay.
+
+    if ((features & CPU_SSE2) != 0 && TryKernels(&sse2_kernels))
+    {
+        columns = &sse2_kernels;
+        spans = &sse2_kernels;
+    }
+
+    if ((features & CPU_AVX2) != 0 && columns != NULL
+     && TryKernels(&avx2_kernels))
+    {
+        spans = &avx2_kernels;
+    }
+#endif
+
+#ifdef HAVE_NEON_KERNELS
+    // Only compiled in when the compiler is allowed to use NEON
+    // everywhere, so the CPU must have it.
+
+    if (TryKernels(&neon_kernels))
+    {
+        columns = &neon_kernels;
+        spans = &neon_kernels;
+    }
+#endif
+
+    // Avoid an unused variable warning where there are no kernels.
+    (void) features;
+
+    if (columns == NULL)
+    {
+        return;
+    }
+
+    selected_kernels.name = spans->name;
+    selected_kernels.column = columns->column;
+    selected_kernels.packedspan = spans->packedspan;
+    selected_kernels.span = spans->span;
+    selected_kernels.transpose = columns->transpose;
+
+    drawkernels = &selected_kernels;
+}
+
+void R_Transpose(byte *dest, int dest_pitch,
+                 const byte *source, int source_pitch,
+                 int width, int height)
+{
+    if (drawkernels != NULL)
+    {
+        drawkernels->transpose(dest, dest_pitch, source, source_pitch,
+                               width, height);
+    }
+    else
+    {
+        Transpose_C(dest, dest_pitch, source, source_pitch, width, height);
+    }
+}
+
+#ifdef TEST
+
+// Microbenchmark: times each set of kernels that this CPU can run,
+// and the plain C versions, over a sweep of column heights, span
+// lengths and texture steps, drawing from a synthetic texture, flat,
+// colormap and translucency table. Each measurement is checked
+// against the plain C versions first, and the times are printed in
+// nanoseconds per pixel.
+
+#include <stdarg.h>
+#include <time.h>
+
+#include "SDL.h"
+
+// Pixels drawn for each measurement.
+#define BENCH_PIXELS (4 * 1024 * 1024)
+
+// Calls compared with the C versions before each measurement.
+#define BENCH_CHECKS 1024
+
+typedef enum
+{
+    BENCH_COLUMN,
+    BENCH_PACKEDSPAN,
+    BENCH_SPAN,
+    BENCH_TLCOLUMN,
+    BENCH_TRANSLATEDTLCOLUMN,
+    BENCH_BLENDCOLUMN,
+    BENCH_TRANSPOSE,
+    NUM_BENCHES
+} bench_t;
+
+static const char *bench_names[NUM_BENCHES] =
+{
+    "column", "packedspan", "span", "tlcolumn", "tlcolumn+tr",
+    "blendcolumn", "transpose",
+};
+
+static const int column_counts[] = { 1, 3, 8, 32, 128, SCREENHEIGHT, 0 };
+static const int span_counts[] = { 1, 3, 8, 32, 128, SCREENWIDTH, 0 };
+static const int blend_counts[] = { 1, 3, 8, 32, 128, 0 };
+
+static const fixed_t bench_steps[] =
+{
+    FRACUNIT / 4, FRACUNIT, FRACUNIT * 4, 0
+};
+
+static const drawkernels_t c_kernels =
+{
+    "C",
+    DrawColumn_C,
+    DrawPackedSpan_C,
+    DrawSpan_C,
+    Transpose_C,
+    DrawTLColumn_C,
+    BlendColumn_C,
+};
+
+// The benchmark is built from this file alone, so it has its own
+// versions of the functions that the kernels use from elsewhere.
+
+void I_Error(const char *error, ...)
+{
+    va_list argptr;
+
+    va_start(argptr, error);
+    vfprintf(stderr, error, argptr);
+    va_end(argptr);
+    fprintf(stderr, "\n");
+
+    exit(1);
+}
+
+int M_CheckParm(const char *check)
+{
+    return 0;
+}
+
+int I_GetCPUFeatures(void)
+{
+    int result = 0;
+
+    if (SDL_HasSSE2())
+    {
+        result |= CPU_SSE2;
+    }
+
+#if SDL_VERSION_ATLEAST(2, 0, 4)
+    if (SDL_HasAVX2())
+    {
+        result |= CPU_AVX2;
+    }
+#endif
+
+    return result;
+}
+
+static byte *texture, *colormap, *table, *translation;
+static byte *background, *transposed;
+
+static byte *AllocBench(int size)
+{
+    byte *block;
+    int i;
+
+    block = malloc(TEST_PADDING + size);
+
+    if (block == NULL)
+    {
+        fprintf(stderr, "Failed to allocate %i bytes\n", size);
+        exit(1);
+    }
+
+    for (i = 0; i < TEST_PADDING + size; ++i)
+    {
+        block[i] = TestRandom() & 0xff;
+    }
+
+    return block + TEST_PADDING;
+}
+
+// Make call number n of a measurement, drawing count pixels into
+// screen. Successive calls move around the screen and the texture,
+// as the drawing functions of the games do.
+
+static void DrawBench(const drawkernels_t *kernels, bench_t bench,
+                      byte *screen, int n, int count, fixed_t step)
+{
+    unsigned int position, packedstep;
+    const byte *source;
+    byte *dest;
+
+    source = texture + (n * 67) % (64 * 64 - 128);
+
+    switch (bench)
+    {
+        case BENCH_COLUMN:
+            dest = screen + n % SCREENWIDTH;
+            kernels->column(dest, source, colormap, n << 12, step, count);
+            break;
+
+        case BENCH_PACKEDSPAN:
+            // Across the flat diagonally, packed as R_DrawSpan does.
+            dest = screen + (n % SCREENHEIGHT) * SCREENWIDTH;
+            position = (((n << 14) << 10) & 0xffff0000)
+                     | (((n << 13) >> 6) & 0x0000ffff);
+            packedstep = ((step << 10) & 0xffff0000)
+                       | (((step / 2) >> 6) & 0x0000ffff);
+            kernels->packedspan(dest, texture, colormap,
+                                position, packedstep, count);
+            break;
+
+        case BENCH_SPAN:
+            dest = screen + (n % SCREENHEIGHT) * SCREENWIDTH;
+            kernels->span(dest, texture, colormap, n << 14, n << 13,
+                          step, step / 2, count);
+            break;
+
+        case BENCH_TLCOLUMN:
+        case BENCH_TRANSLATEDTLCOLUMN:
+            dest = screen + n % SCREENWIDTH;
+            kernels->tlcolumn(dest, source,
+                              bench == BENCH_TRANSLATEDTLCOLUMN ?
+                                  translation : NULL,
+                              colormap, table, n << 12, step, count,
+                              (n & 1) != 0);
+            break;
+
+        case BENCH_BLENDCOLUMN:
+            dest = screen + n % SCREENWIDTH;
+            kernels->blendcolumn(dest, source, table, count, (n & 1) != 0);
+            break;
+
+        case BENCH_TRANSPOSE:
+            // count rows of the screen into columns.
+            kernels->transpose(transposed, SCREENHEIGHT, screen,
+                               SCREENWIDTH, SCREENWIDTH, count);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Returns false if the kernels don't draw the same pixels as the
+// plain C versions.
+
+static boolean CheckBench(const drawkernels_t *kernels, bench_t bench,
+                          byte *expected, byte *result,
+                          int count, fixed_t step)
+{
+    int n;
+
+    memcpy(expected, background, SCREENWIDTH * SCREENHEIGHT);
+    memcpy(result, background, SCREENWIDTH * SCREENHEIGHT);
+
+    for (n = 0; n < BENCH_CHECKS; ++n)
+    {
+        DrawBench(&c_kernels, bench, expected, n, count, step);
+    }
+
+    if (bench == BENCH_TRANSPOSE)
+    {
+        memcpy(expected, transposed, SCREENWIDTH * SCREENHEIGHT);
+    }
+
+    for (n = 0; n < BENCH_CHECKS; ++n)
+    {
+        DrawBench(kernels, bench, result, n, count, step);
+    }
+
+    if (bench == BENCH_TRANSPOSE)
+    {
+        memcpy(result, transposed, SCREENWIDTH * SCREENHEIGHT);
+    }
+
+    return memcmp(expected, result, SCREENWIDTH * SCREENHEIGHT) == 0;
+}
+
+// Returns the time taken to draw each pixel, in nanoseconds.
+
+static double TimeBench(const drawkernels_t *kernels, bench_t bench,
+                        byte *screen, int count, fixed_t step)
+{
+    clock_t start;
+    int calls;
+    int n;
+
+    calls = BENCH_PIXELS / count;
+
+    if (bench == BENCH_TRANSPOSE)
+    {
+        calls /= SCREENWIDTH;
+    }
+
+    if (calls < 1)
+    {
+        calls = 1;
+    }
+
+    memcpy(screen, background, SCREENWIDTH * SCREENHEIGHT);
+
+    start = clock();
+
+    for (n = 0; n < calls; ++n)
+    {
+        DrawBench(kernels, bench, screen, n, count, step);
+    }
+
+    return (clock() - start) * 1e9 / CLOCKS_PER_SEC
+         / ((double) calls * count
+            * (bench == BENCH_TRANSPOSE ? SCREENWIDTH : 1));
+}
+
+int main(int argc, char *argv[])
+{
+    const drawkernels_t *sets[4];
+    const int *counts;
+    byte *expected, *result;
+    int num_sets, features;
+    int bench, c, s, i;
+    boolean failed = false;
+
+    features = I_GetCPUFeatures();
+    num_sets = 0;
+    sets[num_sets++] = &c_kernels;
+
+#ifdef HAVE_X86_KERNELS
+    if ((features & CPU_SSE2) != 0)
+    {
+        sets[num_sets++] = &sse2_kernels;
+    }
+
+    if ((features & CPU_AVX2) != 0)
+    {
+        sets[num_sets++] = &avx2_kernels;
+    }
+#endif
+
+#ifdef HAVE_NEON_KERNELS
+    sets[num_sets++] = &neon_kernels;
+#endif
+
+    (void) features;
+
+    // The same random check that R_InitDrawKernels makes, and the
+    // translucent kernels too.
+
+    for (i = 1; i < num_sets; ++i)
+    {
+        if (!CheckKernels(sets[i], true))
+        {
+            fprintf(stderr, "%s: self check failed\n", sets[i]->name);
+            failed = true;
+        }
+    }
+
+    test_seed = 1;
+    texture = AllocBench(64 * 64);
+    colormap = AllocBench(256);
+    table = AllocBench(256 * 256);
+    translation = AllocBench(256);
+    background = AllocBench(SCREENWIDTH * SCREENHEIGHT);
+    transposed = AllocBench(SCREENWIDTH * SCREENHEIGHT);
+    expected = AllocBench(SCREENWIDTH * SCREENHEIGHT);
+    result = AllocBench(SCREENWIDTH * SCREENHEIGHT);
+
+    printf("%-12s %5s %6s", "kernel", "count", "step");
+
+    for (i = 0; i < num_sets; ++i)
+    {
+        printf(" %9s", sets[i]->name);
+    }
+
+    printf("   (ns per pixel)\n");
+
+    for (bench = 0; bench < NUM_BENCHES; ++bench)
+    {
+        if (bench == BENCH_COLUMN || bench == BENCH_TLCOLUMN
+         || bench == BENCH_TRANSLATEDTLCOLUMN || bench == BENCH_TRANSPOSE)
+        {
+            counts = column_counts;
+        }
+        else if (bench == BENCH_BLENDCOLUMN)
+        {
+            counts = blend_counts;
+        }
+        else
+        {
+            counts = span_counts;
+        }
+
+        for (c = 0; counts[c] != 0; ++c)
+        {
+            for (s = 0; bench_steps[s] != 0; ++s)
+            {
+                // Blending and transposing have no texture step.
+
+                if ((bench == BENCH_BLENDCOLUMN || bench == BENCH_TRANSPOSE)
+                 && s > 0)
+                {
+                    break;
+                }
+
+                printf("%-12s %5i", bench_names[bench], counts[c]);
+
+                if (bench == BENCH_BLENDCOLUMN || bench == BENCH_TRANSPOSE)
+                {
+                    printf(" %6s", "-");
+                }
+                else
+                {
+                    printf(" %6.2f", (double) bench_steps[s] / FRACUNIT);
+                }
+
+                for (i = 0; i < num_sets; ++i)
+                {
+                    if (i > 0
+                     && !CheckBench(sets[i], bench, expected, result,
+                                    counts[c], bench_steps[s]))
+                    {
+                        printf(" %9s", "MISMATCH");
+                        failed = true;
+                        continue;
+                    }
+
+                    printf(" %9.3f", TimeBench(sets[i], bench, result,
+                                               counts[c], bench_steps[s]));
+                }
+
+                printf("\n");
+            }
+        }
+    }
+
+    return failed ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,100 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Vectorized column and span drawing kernels, shared by all games.
+//
+
+
+#ifndef __R_SIMD__
+#define __R_SIMD__
+
+#include "doomtype.h"
+#include "m_fixed.h"
+
+typedef struct
+{
+    const char *name;
+
+    // Draw count pixels down a column, SCREENWIDTH bytes apart, as
+    // done by R_DrawColumn:
+    //   colormap[source[(frac >> FRACBITS) & 127]], stepping frac by
+    //   fracstep after each pixel.
+
+    void (*column)(byte *dest, const byte *source, const byte *colormap,
+                   fixed_t frac, fixed_t fracstep, int count);
+
+    // Draw count pixels along a span, using the packed position of
+    // the Doom and Strife versions of R_DrawSpan: x in the top 16
+    // bits and y in the bottom 16 bits, each 6.10 fixed point.
+
+    void (*packedspan)(byte *dest, const byte *source, const byte *colormap,
+                       unsigned int position, unsigned int step, int count);
+
+    // Draw count pixels along a span, stepping separate x and y
+    // positions, as done by the Heretic and Hexen versions of
+    // R_DrawSpan.
+
+    void (*span)(byte *dest, const byte *source, const byte *colormap,
+                 fixed_t xfrac, fixed_t yfrac,
+                 fixed_t xstep, fixed_t ystep, int count);
+
+    // Transpose a block of width x height bytes; see R_Transpose.
+
+    void (*transpose)(byte *dest, int dest_pitch,
+                      const byte *source, int source_pitch,
+                      int width, int height);
+
+    // Draw count translucent pixels down a column, as done by the
+    // Heretic, Hexen and Strife translucent column drawers. These and
+    // blendcolumn are slower than the C drawers, since the lookups in
+    // the 64KB table can't be done in vector registers, so only
+    // kernelbench uses them. Each
+    // pixel p is colormap[source[(frac >> FRACBITS) & 127]], passed
+    // through translation first if it is not NULL, and is blended
+    // with the pixel d already on the screen using the 64KB table:
+    //   table[(d << 8) + p], or table[d + (p << 8)] if swapped.
+
+    void (*tlcolumn)(byte *dest, const byte *source,
+                     const byte *translation, const byte *colormap,
+                     const byte *table, fixed_t frac, fixed_t fracstep,
+                     int count, boolean swapped);
+
+    // Blend count pixels from source down a column through the 64KB
+    // table, in the same way, as done by V_DrawTLPatch and friends.
+
+    void (*blendcolumn)(byte *dest, const byte *source, const byte *table,
+                        int count, boolean swapped);
+} drawkernels_t;
+
+// The kernels chosen by R_InitDrawKernels, or NULL if the plain C
+// drawing functions should be used. tlcolumn and blendcolumn are
+// always NULL here.
+
+extern const drawkernels_t *drawkernels;
+
+// Choose the fastest set of kernels that this CPU supports and that
+// draws exactly the same pixels as the plain C versions.
+
+void R_InitDrawKernels(void);
+
+// Transpose a block of bytes: each of the height rows of width bytes
+// in the source becomes a column in the destination, so that
+// dest[x * dest_pitch + y] = source[y * source_pitch + x].
+
+void R_Transpose(byte *dest, int dest_pitch,
+                 const byte *source, int source_pitch,
+                 int width, int height);
+
+#endif
+
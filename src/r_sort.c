@@ -0,0 +1,299 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Stable sorting, used to put vissprites in drawing order.
+//
+//      The vanilla R_SortVisSprites repeatedly pulls out the first
+//      remaining vissprite with the smallest scale. That is exactly
+//      a stable sort by scale, so any stable sort draws the sprites
+//      in the same order. This is a bottom-up merge sort, with
+//      short runs sorted by insertion first.
+//
+
+#include <string.h>
+
+#include "r_sort.h"
+
+// Length of the runs sorted by insertion before merging.
+
+#define RUN_LENGTH 16
+
+static void InsertionSort(sortkey_t *keys, int count)
+{
+    sortkey_t key;
+    int i, j;
+
+    for (i = 1; i < count; ++i)
+    {
+        key = keys[i];
+
+        // Only move past keys that are strictly greater, so that
+        // equal keys keep their order.
+
+        for (j = i; j > 0 && keys[j - 1].key > key.key; --j)
+        {
+            keys[j] = keys[j - 1];
+        }
+
+        keys[j] = key;
+    }
+}
+
+// Merge the sorted runs source[start..mid) and source[mid..end) into
+// dest[start..end).
+
+static void MergeRuns(sortkey_t *dest, const sortkey_t *source,
+                      int start, int mid, int end)
+{
+    int left, right, i;
+
+    left = start;
+    right = mid;
+
+    for (i = start; i < end; ++i)
+    {
+        // Take from the left run on a tie, to keep the sort stable.
+
+        if (left < mid && (right >= end
+                        || source[left].key <= source[right].key))
+        {
+            dest[i] = source[left++];
+        }
+        else
+        {
+            dest[i] = source[right++];
+        }
+    }
+}
+
+void R_StableSortKeys(sortkey_t *keys, sortkey_t *scratch, int count)
+{
+    sortkey_t *source, *dest, *swap;
+    int width, start, mid, end;
+
+    for (start = 0; start < count; start += RUN_LENGTH)
+    {
+        end = start + RUN_LENGTH;
+
+        if (end > count)
+        {
+            end = count;
+        }
+
+        InsertionSort(keys + start, end - start);
+    }
+
+    source = keys;
+    dest = scratch;
+
+    for (width = RUN_LENGTH; width < count; width *= 2)
+    {
+        for (start = 0; start < count; start += 2 * width)
+        {
+            mid = start + width;
+            end = start + 2 * width;
+
+            if (mid > count)
+            {
+                mid = count;
+            }
+
+            if (end > count)
+            {
+                end = count;
+            }
+
+            MergeRuns(dest, source, start, mid, end);
+        }
+
+        swap = source;
+        source = dest;
+        dest = swap;
+    }
+
+    if (source != keys)
+    {
+        memcpy(keys, source, count * sizeof(sortkey_t));
+    }
+}
+
+#ifdef TEST
+
+// Microbenchmark: sorts synthetic sets of vissprite scales with both
+// the vanilla selection sort and R_StableSortKeys, checks that they
+// give the same order and prints the time taken by each.
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MIN_SPRITES 128
+#define MAX_SPRITES 4096
+
+static unsigned int rand_state = 1;
+
+static int Random(void)
+{
+    rand_state = rand_state * 1103515245 + 12345;
+    return (rand_state >> 16) & 0x7fff;
+}
+
+// The algorithm from R_SortVisSprites, on a list of keys rather than
+// of vissprites.
+
+static void SelectionSort(const sortkey_t *keys, int *order, int count)
+{
+    int *next, *prev;
+    int head, best, i, j;
+    fixed_t bestscale;
+
+    next = malloc((count + 1) * sizeof(int));
+    prev = malloc((count + 1) * sizeof(int));
+
+    // Entry count is the head of the unsorted list.
+
+    head = count;
+
+    for (i = 0; i < count; ++i)
+    {
+        next[i] = i + 1;
+        prev[i] = i - 1;
+    }
+
+    prev[0] = head;
+    next[head] = 0;
+    next[count - 1] = head;
+    prev[head] = count - 1;
+
+    for (i = 0; i < count; ++i)
+    {
+        bestscale = INT_MAX;
+        best = next[head];
+
+        for (j = next[head]; j != head; j = next[j])
+        {
+            if (keys[j].key < bestscale)
+            {
+                bestscale = keys[j].key;
+                best = j;
+            }
+        }
+
+        next[prev[best]] = next[best];
+        prev[next[best]] = prev[best];
+        order[i] = best;
+    }
+
+    free(next);
+    free(prev);
+}
+
+// Scales like those of a crowd of monsters: many are equal, from
+// sprites at the same distance.
+
+static void MakeKeys(sortkey_t *keys, int count)
+{
+    int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        keys[i].key = (Random() % (count / 4 + 1)) << (FRACBITS - 4);
+        keys[i].index = i;
+    }
+}
+
+static double Milliseconds(clock_t start)
+{
+    return (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char *argv[])
+{
+    sortkey_t *original, *keys, *scratch;
+    int *order;
+    clock_t start;
+    double selection_ms, merge_ms;
+    int count, repeats, r, i;
+
+    original = malloc(MAX_SPRITES * sizeof(sortkey_t));
+    keys = malloc(MAX_SPRITES * sizeof(sortkey_t));
+    scratch = malloc(MAX_SPRITES * sizeof(sortkey_t));
+    order = malloc(MAX_SPRITES * sizeof(int));
+
+    printf("%8s %14s %14s %9s\n",
+           "sprites", "selection ms", "merge ms", "speedup");
+
+    for (count = MIN_SPRITES; count <= MAX_SPRITES; count *= 2)
+    {
+        MakeKeys(original, count);
+
+        // Check that the order is identical to vanilla.
+
+        SelectionSort(original, order, count);
+        memcpy(keys, original, count * sizeof(sortkey_t));
+        R_StableSortKeys(keys, scratch, count);
+
+        for (i = 0; i < count; ++i)
+        {
+            if (keys[i].index != order[i])
+            {
+                fprintf(stderr, "%i sprites: order differs at %i\n",
+                        count, i);
+                return 1;
+            }
+        }
+
+        // Do roughly the same amount of work at each size.
+
+        repeats = (MAX_SPRITES / count) * (MAX_SPRITES / count);
+
+        if (repeats > 1000)
+        {
+            repeats = 1000;
+        }
+
+        start = clock();
+
+        for (r = 0; r < repeats; ++r)
+        {
+            SelectionSort(original, order, count);
+        }
+
+        selection_ms = Milliseconds(start) / repeats;
+
+        start = clock();
+
+        for (r = 0; r < repeats * 100; ++r)
+        {
+            memcpy(keys, original, count * sizeof(sortkey_t));
+            R_StableSortKeys(keys, scratch, count);
+        }
+
+        merge_ms = Milliseconds(start) / (repeats * 100);
+
+        printf("%8i %14.4f %14.4f %8.1fx\n", count, selection_ms, merge_ms,
+               merge_ms > 0 ? selection_ms / merge_ms : 0.0);
+    }
+
+    free(original);
+    free(keys);
+    free(scratch);
+    free(order);
+
+    return 0;
+}
+
+#endif
+
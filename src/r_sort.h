@@ -0,0 +1,38 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Stable sorting, used to put vissprites in drawing order.
+//
+
+
+#ifndef __R_SORT__
+#define __R_SORT__
+
+#include "m_fixed.h"
+
+typedef struct
+{
+    fixed_t key;
+    int index;
+} sortkey_t;
+
+// Sort count keys into ascending order. Keys that compare equal stay
+// in the order they were given in, which is the order the vanilla
+// selection sort in R_SortVisSprites picks them out in. scratch must
+// have room for count keys.
+
+void R_StableSortKeys(sortkey_t *keys, sortkey_t *scratch, int count);
+
+#endif
+
@@ -29,8 +29,10 @@
 #include "p_local.h"
 #include "w_wad.h"
 
+#include "m_bbox.h"
 #include "m_cheat.h"
 #include "m_controls.h"
+#include "m_linegrid.h"
 #include "i_system.h"
 #include "i_timer.h"
 
@@ -492,6 +494,18 @@ void AM_clearMarks(void)
     markpointnum = 0;
 }
 
+//
+// Bounding box of a line, for the automap line grid.
+//
+static boolean AM_lineBox(int i, fixed_t *box)
+{
+    box[BOXTOP] = lines[i].bbox[BOXTOP];
+    box[BOXBOTTOM] = lines[i].bbox[BOXBOTTOM];
+    box[BOXLEFT] = lines[i].bbox[BOXLEFT];
+    box[BOXRIGHT] = lines[i].bbox[BOXRIGHT];
+    return true;
+}
+
 //
 // should be called at the start of every level
 // right now, i figure it out myself
@@ -513,6 +527,16 @@ void AM_LevelInit(void)
     scale_ftom = FixedDiv(FRACUNIT, scale_mtof);
 }
 
+//
+// Index the lines, so that only those near the window are drawn.
+// Called by P_SetupLevel, since the automap can be left up while
+// another level loads.
+//
+void AM_InitLineGrid(void)
+{
+    M_BuildLineGrid(numlines, AM_lineBox);
+}
+
 
 
 
@@ -1138,11 +1162,22 @@ AM_drawMline
 void AM_drawWalls(void)
 {
     int i;
+    int n, count;
+    const int *visible;
+    fixed_t box[4];
     line_t* line;
     static mline_t l;
 
-    for(i = 0; i < numlines; i++)
+    // Only lines that can touch the window need to be clipped.
+    box[BOXTOP] = m_y2;
+    box[BOXBOTTOM] = m_y;
+    box[BOXLEFT] = m_x;
+    box[BOXRIGHT] = m_x2;
+    count = M_FindGridLines(numlines, box, &visible);
+
+    for(n = 0; n < count; n++)
     {
+        i = visible[n];
         line = &lines[i];
 
         l.a.x = line->v1->x;
@@ -1351,8 +1386,14 @@ void AM_drawThings(void)
                 radius = (16<<FRACBITS);
             }
 
-            AM_drawLineCharacter (thintriangle_guy, arrlen(thintriangle_guy),
-                radius, t->angle, colors, t->x, t->y);
+            // Skip things too far outside the window for any part of
+            // their triangles to show.
+            if(t->x >= m_x - 2*radius && t->x <= m_x2 + 2*radius
+            && t->y >= m_y - 2*radius && t->y <= m_y2 + 2*radius)
+            {
+                AM_drawLineCharacter (thintriangle_guy, arrlen(thintriangle_guy),
+                    radius, t->angle, colors, t->x, t->y);
+            }
 
             t = t->snext;
         }
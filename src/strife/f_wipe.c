@@ -42,28 +42,6 @@ static byte*	wipe_scr_end;
 static byte*	wipe_scr;
 
 
-void
-wipe_shittyColMajorXform
-( short*	array,
-  int		width,
-  int		height )
-{
-    int		x;
-    int		y;
-    short*	dest;
-
-    dest = (short*) Z_Malloc(width*height*2, PU_STATIC, 0);
-
-    for(y=0;y<height;y++)
-	for(x=0;x<width;x++)
-	    dest[x*height+y] = array[y*width+x];
-
-    memcpy(array, dest, width*height*2);
-
-    Z_Free(dest);
-
-}
-
 // haleyjd 08/26/10: [STRIFE] Verified unmodified.
 int
 wipe_initColorXForm
@@ -119,7 +97,22 @@ wipe_exitColorXForm
 }
 
 
-static int*	y;
+//
+// The melt is done in place on the screen, straight from the
+// row-major start and end screens. Adjacent columns that start at
+// the same height melt in step for the whole wipe, so they are kept
+// together in one descriptor and each row of them is moved at once.
+//
+
+typedef struct
+{
+    int		x;	// first column, in pairs of pixels
+    int		count;	// number of column pairs
+    int		y;	// y<0 => not ready to scroll yet
+} meltspan_t;
+
+static meltspan_t	meltspans[SCREENWIDTH/2];
+static int		nummeltspans;
 
 int
 wipe_initMelt
@@ -127,19 +120,15 @@ wipe_initMelt
   int	height,
   int	ticks )
 {
-    int i, r;
+    int		y[SCREENWIDTH];
+    int		i, r;
+    meltspan_t*	span;
     
     // copy start screen to main screen
     memcpy(wipe_scr, wipe_scr_start, width*height);
     
-    // makes this wipe faster (in theory)
-    // to have stuff in column-major format
-    wipe_shittyColMajorXform((short*)wipe_scr_start, width/2, height);
-    wipe_shittyColMajorXform((short*)wipe_scr_end, width/2, height);
-    
     // setup initial column positions
     // (y<0 => not ready to scroll yet)
-    y = (int *) Z_Malloc(width*sizeof(int), PU_STATIC, 0);
     y[0] = -(M_Random()%16);
     for (i=1;i<width;i++)
     {
@@ -149,6 +138,25 @@ wipe_initMelt
 	else if (y[i] == -16) y[i] = -15;
     }
 
+    // only the first width/2 positions are used, one for each
+    // pair of pixels
+    nummeltspans = 0;
+    span = NULL;
+
+    for (i=0;i<width/2;i++)
+    {
+	if (span != NULL && span->y == y[i])
+	{
+	    span->count++;
+	    continue;
+	}
+
+	span = &meltspans[nummeltspans++];
+	span->x = i;
+	span->count = 1;
+	span->y = y[i];
+    }
+
     return 0;
 }
 
@@ -161,46 +169,89 @@ wipe_doMelt
     int		i;
     int		j;
     int		dy;
-    int		idx;
-    
-    short*	s;
-    short*	d;
+    int		row;
+    int		runstart;
+    int		runend;
+    int		top[SCREENWIDTH/2];
+    meltspan_t*	span;
+    byte*	run;
+    byte*	s;
+    byte*	d;
     boolean	done = true;
 
-    width/=2;
-
-    while (ticks--)
+    // Advance every span through all the ticks first, remembering
+    // the highest row that each one changes.
+    for (i=0;i<nummeltspans;i++)
     {
-	for (i=0;i<width;i++)
+	span = &meltspans[i];
+	top[i] = height;
+
+	for (j=ticks;j;j--)
 	{
-	    if (y[i]<0)
+	    if (span->y<0)
 	    {
-		y[i]++; done = false;
+		span->y++; done = false;
 	    }
-	    else if (y[i] < height)
+	    else if (span->y < height)
 	    {
-		dy = (y[i] < 16) ? y[i]+1 : 8;
-		if (y[i]+dy >= height) dy = height - y[i];
-		s = &((short *)wipe_scr_end)[i*height+y[i]];
-		d = &((short *)wipe_scr)[y[i]*width+i];
-		idx = 0;
-		for (j=dy;j;j--)
-		{
-		    d[idx] = *(s++);
-		    idx += width;
-		}
-		y[i] += dy;
-		s = &((short *)wipe_scr_start)[i*height];
-		d = &((short *)wipe_scr)[y[i]*width+i];
-		idx = 0;
-		for (j=height-y[i];j;j--)
+		if (top[i] == height)
+		    top[i] = span->y;
+		dy = (span->y < 16) ? span->y+1 : 8;
+		if (span->y+dy >= height) dy = height - span->y;
+		span->y += dy;
+		done = false;
+	    }
+	}
+    }
+
+    // Then redraw the screen a row at a time: above its position a
+    // span shows the end screen, below it the start screen shifted
+    // down. Rows above where the span started this call are left
+    // alone, as the column-at-a-time version did. Neighbouring spans
+    // that take this row from the same source row are moved together.
+    d = wipe_scr;
+
+    for (row=0;row<height;row++)
+    {
+	run = NULL;
+	runstart = runend = 0;
+
+	for (i=0;i<=nummeltspans;i++)
+	{
+	    s = NULL;
+
+	    if (i < nummeltspans && row >= top[i])
+	    {
+		span = &meltspans[i];
+
+		if (row < span->y)
+		    s = wipe_scr_end + row*width;
+		else
+		    s = wipe_scr_start + (row-span->y)*width;
+
+		if (s == run && span->x == runend)
 		{
-		    d[idx] = *(s++);
-		    idx += width;
+		    runend += span->count;
+		    continue;
 		}
-		done = false;
+	    }
+
+	    if (run != NULL)
+	    {
+		memcpy(d + runstart*2, run + runstart*2,
+		       (runend-runstart)*2);
+	    }
+
+	    run = s;
+
+	    if (s != NULL)
+	    {
+		runstart = span->x;
+		runend = span->x + span->count;
 	    }
 	}
+
+	d += width;
     }
 
     return done;
@@ -213,9 +264,6 @@ wipe_exitMelt
   int	height,
   int	ticks )
 {
-    Z_Free(y);
-    Z_Free(wipe_scr_start);
-    Z_Free(wipe_scr_end);
     return 0;
 }
 
@@ -227,7 +275,9 @@ wipe_StartScreen
   int	width,
   int	height )
 {
-    wipe_scr_start = Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);
+    // The screen copies are kept from one wipe to the next.
+    if (wipe_scr_start == NULL)
+	wipe_scr_start = Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);
     I_ReadScreen(wipe_scr_start);
     return 0;
 }
@@ -240,7 +290,8 @@ wipe_EndScreen
   int	width,
   int	height )
 {
-    wipe_scr_end = Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);
+    if (wipe_scr_end == NULL)
+	wipe_scr_end = Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);
     I_ReadScreen(wipe_scr_end);
     V_DrawBlock(x, y, width, height, wipe_scr_start); // restore start scr.
     return 0;
@@ -268,7 +319,8 @@ wipe_ScreenWipe
     {
 	go = 1;
         // haleyjd 20110629 [STRIFE]: We *must* use a temp buffer here.
-	wipe_scr = (byte *) Z_Malloc(width*height, PU_STATIC, 0); // DEBUG
+	if (wipe_scr == NULL)
+	    wipe_scr = (byte *) Z_Malloc(width*height, PU_STATIC, 0); // DEBUG
 	//wipe_scr = I_VideoBuffer;
 	(*wipes[wipeno*3])(width, height, ticks);
     }
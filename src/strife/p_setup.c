@@ -40,6 +40,8 @@
 
 #include "doomstat.h"
 
+#include "am_map.h"
+
 
 void	P_SpawnMapThing (mapthing_t*	mthing);
 
@@ -839,6 +841,8 @@ P_SetupLevel
     // build subsector connect matrix
     // UNUSED P_ConnectSubsectors ();
 
+    AM_InitLineGrid ();
+
     // preload graphics
     if (precache)
         R_PrecacheLevel ();
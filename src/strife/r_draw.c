@@ -29,6 +29,7 @@
 #include "w_wad.h"
 
 #include "r_local.h"
+#include "r_simd.h"
 
 // Needs access to LFB (guess what).
 #include "v_video.h"
@@ -150,6 +151,34 @@ void R_DrawColumn (void)
 } 
 
 
+//
+// R_DrawColumnVector
+// Same as R_DrawColumn, using the SSE2/AVX2/NEON
+//  kernel picked by R_InitDrawKernels.
+//
+void R_DrawColumnVector (void)
+{
+    int			count;
+
+    count = dc_yh - dc_yl;
+
+    if (count < 0)
+	return;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= SCREENWIDTH
+	|| dc_yl < 0
+	|| dc_yh >= SCREENHEIGHT)
+	I_Error ("R_DrawColumnVector: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+    drawkernels->column(ylookup[dc_yl] + columnofs[dc_x],
+			dc_source, dc_colormap,
+			dc_texturemid + (dc_yl-centery)*dc_iscale,
+			dc_iscale, count + 1);
+}
+
+
 
 // UNUSED.
 // Loop unrolled.
@@ -638,6 +667,37 @@ void R_DrawSpan (void)
 }
 
 
+//
+// R_DrawSpanVector
+// Same as R_DrawSpan, using the SSE2/AVX2/NEON
+//  kernel picked by R_InitDrawKernels.
+//
+void R_DrawSpanVector (void)
+{
+    unsigned int position, step;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=SCREENWIDTH
+	|| (unsigned)ds_y>SCREENHEIGHT)
+    {
+	I_Error( "R_DrawSpanVector: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+
+    drawkernels->packedspan(ylookup[ds_y] + columnofs[ds_x1],
+			    ds_source, ds_colormap,
+			    position, step, ds_x2 - ds_x1 + 1);
+}
+
+
 
 // UNUSED.
 // Loop unrolled by 4.
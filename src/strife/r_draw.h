@@ -40,6 +40,9 @@ extern byte*		dc_source;
 void 	R_DrawColumn (void);
 void 	R_DrawColumnLow (void);
 
+// R_DrawColumn using the vector kernels from r_simd.c.
+void	R_DrawColumnVector (void);
+
 // The Spectre/Invisibility effect.
 //void 	R_DrawFuzzColumn (void);
 //void 	R_DrawFuzzColumnLow (void);
@@ -84,6 +87,9 @@ extern char *back_flat; // haleyjd 08/29/10: [STRIFE]
 // No Sepctre effect needed.
 void 	R_DrawSpan (void);
 
+// R_DrawSpan using the vector kernels from r_simd.c.
+void	R_DrawSpanVector (void);
+
 // Low resolution mode, 160x200?
 void 	R_DrawSpanLow (void);
 
@@ -34,6 +34,7 @@
 #include "m_menu.h"
 
 #include "r_local.h"
+#include "r_simd.h"
 #include "r_sky.h"
 
 
@@ -707,6 +708,13 @@ void R_ExecuteSetViewSize (void)
 	fuzzcolfunc = R_DrawTLColumn;   // villsa [STRIFE]
 	transcolfunc = R_DrawTranslatedColumn;
 	spanfunc = R_DrawSpan;
+
+	// Use the vector versions if the CPU can.
+	if (drawkernels != NULL)
+	{
+	    colfunc = basecolfunc = R_DrawColumnVector;
+	    spanfunc = R_DrawSpanVector;
+	}
     }
     // villsa [STRIFE] unused detail stuff
     /*else
@@ -810,6 +818,8 @@ void R_Init (void)
     else
         D_IntroTick();
 
+    R_InitDrawKernels ();
+
     framecount = 0;
 }
 
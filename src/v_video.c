@@ -133,6 +133,349 @@ void V_SetPatchClipCallback(vpatchclipfunc_t func)
     patchclip_callback = func;
 }
 
+//
+// Patch cache.
+//
+// The patches drawn by V_DrawPatch - the status bar, fonts, menus and
+// intermission screens - are drawn again and again. Rather than walk
+// the posts of each column every time, a patch is converted once into
+// a list of horizontal runs of opaque pixels, which can each be drawn
+// with a memcpy. The list is kept for the lump that the patch came
+// from, and a hash table of addresses finds the lump for a patch; an
+// address stops matching once its lump has been released and the
+// memory reused, and is then looked up again.
+//
+
+#define PATCHHASH_MINSIZE 256
+
+typedef struct
+{
+    int offset;                 // from the top left of the patch
+    int length;
+    const pixel_t *pixels;
+} patchrun_t;
+
+typedef struct
+{
+    int numruns;
+    patchrun_t *runs;
+} compiledpatch_t;
+
+typedef struct patchaddr_s patchaddr_t;
+
+struct patchaddr_s
+{
+    const patch_t *patch;
+    lumpindex_t lump;           // -1 if not lump data
+    patchaddr_t *next;
+};
+
+static patchaddr_t **patchhash = NULL;
+static unsigned int patchhashsize = 0;
+static unsigned int numpatchaddrs = 0;
+
+// The runs for each lump, once drawn as a patch.
+
+static compiledpatch_t **lumppatches = NULL;
+static unsigned int numlumppatches = 0;
+
+// Marks a lump that is too big to be converted.
+
+static compiledpatch_t uncompilable;
+
+// Where patches are drawn out before being split into runs, and which
+// of those pixels are opaque.
+
+static pixel_t patchpixels[SCREENWIDTH * SCREENHEIGHT];
+static byte patchopaque[SCREENWIDTH * SCREENHEIGHT];
+
+// Convert a patch into runs. Returns NULL if the patch is too big to
+// be drawn onto the screen in one piece.
+//
+// The runs are not kept in the zone: allocating from it could purge
+// the patch itself, which the caller may still be holding as
+// PU_CACHE.
+
+static compiledpatch_t *CompilePatch(const patch_t *patch)
+{
+    const column_t *column;
+    const byte *source;
+    compiledpatch_t *compiled;
+    patchrun_t *run;
+    pixel_t *pixels;
+    int width, height;
+    int numruns, numpixels;
+    int x, y, i, count;
+
+    width = SHORT(patch->width);
+
+    if (width <= 0 || width > SCREENWIDTH)
+    {
+        return NULL;
+    }
+
+    // Posts can reach below the stated height of the patch; draw out
+    // everything, in the same order as V_DrawPatch would, so that
+    // overlapping posts come out the same.
+
+    height = 0;
+
+    for (x = 0; x < width; ++x)
+    {
+        column = (const column_t *)
+                 ((const byte *) patch + LONG(patch->columnofs[x]));
+
+        while (column->topdelta != 0xff)
+        {
+            if (column->topdelta + column->length > SCREENHEIGHT)
+            {
+                return NULL;
+            }
+
+            if (column->topdelta + column->length > height)
+            {
+                height = column->topdelta + column->length;
+            }
+
+            column = (const column_t *)
+                     ((const byte *) column + column->length + 4);
+        }
+    }
+
+    // Only the patch's own rectangle is used.
+
+    for (y = 0; y < height; ++y)
+    {
+        memset(patchopaque + y * SCREENWIDTH, 0, width);
+    }
+
+    for (x = 0; x < width; ++x)
+    {
+        column = (const column_t *)
+                 ((const byte *) patch + LONG(patch->columnofs[x]));
+
+        while (column->topdelta != 0xff)
+        {
+            source = (const byte *) column + 3;
+            i = column->topdelta * SCREENWIDTH + x;
+
+            for (count = column->length; count > 0; --count)
+            {
+                patchpixels[i] = *source++;
+                patchopaque[i] = 1;
+                i += SCREENWIDTH;
+            }
+
+            column = (const column_t *)
+                     ((const byte *) column + column->length + 4);
+        }
+    }
+
+    // Count the runs, so that they can all go in one block.
+
+    numruns = 0;
+    numpixels = 0;
+
+    for (y = 0; y < height; ++y)
+    {
+        for (x = 0; x < width; ++x)
+        {
+            i = y * SCREENWIDTH + x;
+
+            if (patchopaque[i])
+            {
+                ++numpixels;
+
+                if (x == 0 || !patchopaque[i - 1])
+                {
+                    ++numruns;
+                }
+            }
+        }
+    }
+
+    compiled = malloc(sizeof(compiledpatch_t)
+                    + numruns * sizeof(patchrun_t)
+                    + numpixels * sizeof(pixel_t));
+
+    if (compiled == NULL)
+    {
+        I_Error("CompilePatch: Failed to allocate %i runs", numruns);
+    }
+
+    compiled->numruns = numruns;
+    compiled->runs = (patchrun_t *) (compiled + 1);
+    pixels = (pixel_t *) (compiled->runs + numruns);
+    run = compiled->runs;
+
+    for (y = 0; y < height; ++y)
+    {
+        for (x = 0; x < width; ++x)
+        {
+            i = y * SCREENWIDTH + x;
+
+            if (!patchopaque[i])
+            {
+                continue;
+            }
+
+            if (x == 0 || !patchopaque[i - 1])
+            {
+                run->offset = i;
+                run->length = 0;
+                run->pixels = pixels;
+                ++run;
+            }
+
+            run[-1].length++;
+            *pixels++ = patchpixels[i];
+        }
+    }
+
+    return compiled;
+}
+
+static unsigned int PatchHashKey(const patch_t *patch)
+{
+    uintptr_t x = (uintptr_t) patch >> 3;
+
+    // Fold the higher bits down, since the table is indexed by the
+    // low bits.
+
+    return (unsigned int) (x ^ (x >> 11) ^ (x >> 23)) & (patchhashsize - 1);
+}
+
+// Double the size of the address table, to keep the chains short.
+
+static void GrowPatchHash(void)
+{
+    patchaddr_t **oldhash;
+    patchaddr_t *addr, *next;
+    unsigned int oldsize;
+    unsigned int i, key;
+
+    oldhash = patchhash;
+    oldsize = patchhashsize;
+
+    patchhashsize = oldsize == 0 ? PATCHHASH_MINSIZE : oldsize * 2;
+    patchhash = calloc(patchhashsize, sizeof(*patchhash));
+
+    if (patchhash == NULL)
+    {
+        I_Error("GrowPatchHash: Failed to allocate %u entries",
+                patchhashsize);
+    }
+
+    for (i = 0; i < oldsize; ++i)
+    {
+        for (addr = oldhash[i]; addr != NULL; addr = next)
+        {
+            next = addr->next;
+            key = PatchHashKey(addr->patch);
+            addr->next = patchhash[key];
+            patchhash[key] = addr;
+        }
+    }
+
+    free(oldhash);
+}
+
+// Find the lump that a patch is the data of, or -1. The answer for
+// each address is remembered, including for patches that are not lump
+// data, so that the lumps only have to be searched for new addresses
+// and for those whose lump has since moved.
+
+static lumpindex_t PatchLump(const patch_t *patch)
+{
+    patchaddr_t *addr;
+    unsigned int key;
+
+    if (numpatchaddrs >= patchhashsize)
+    {
+        GrowPatchHash();
+    }
+
+    key = PatchHashKey(patch);
+
+    for (addr = patchhash[key]; addr != NULL; addr = addr->next)
+    {
+        if (addr->patch == patch)
+        {
+            if (addr->lump >= 0 && !W_LumpDataAt(addr->lump, patch))
+            {
+                addr->lump = W_LumpNumForData(patch);
+            }
+
+            return addr->lump;
+        }
+    }
+
+    addr = malloc(sizeof(*addr));
+
+    if (addr == NULL)
+    {
+        I_Error("PatchLump: Failed to allocate an entry");
+    }
+
+    addr->patch = patch;
+    addr->lump = W_LumpNumForData(patch);
+    addr->next = patchhash[key];
+    patchhash[key] = addr;
+    ++numpatchaddrs;
+
+    return addr->lump;
+}
+
+// Find the runs for a patch, converting it if its lump has not been
+// drawn before. Returns NULL if the patch can't be cached.
+
+static compiledpatch_t *CachedPatch(const patch_t *patch)
+{
+    compiledpatch_t **newpatches;
+    compiledpatch_t *compiled;
+    lumpindex_t lump;
+
+    // Only lumps are cached: anything else may change at any time.
+
+    lump = PatchLump(patch);
+
+    if (lump < 0)
+    {
+        return NULL;
+    }
+
+    if ((unsigned int) lump >= numlumppatches)
+    {
+        newpatches = realloc(lumppatches, numlumps * sizeof(*lumppatches));
+
+        if (newpatches == NULL)
+        {
+            I_Error("CachedPatch: Failed to allocate %u entries", numlumps);
+        }
+
+        memset(newpatches + numlumppatches, 0,
+               (numlumps - numlumppatches) * sizeof(*lumppatches));
+        lumppatches = newpatches;
+        numlumppatches = numlumps;
+    }
+
+    compiled = lumppatches[lump];
+
+    if (compiled == NULL)
+    {
+        compiled = CompilePatch(patch);
+
+        if (compiled == NULL)
+        {
+            compiled = &uncompilable;
+        }
+
+        lumppatches[lump] = compiled;
+    }
+
+    return compiled == &uncompilable ? NULL : compiled;
+}
+
 //
 // V_DrawPatch
 // Masks a column based masked pic to the screen. 
@@ -146,6 +489,9 @@ void V_DrawPatch(int x, int y, patch_t *patch)
     pixel_t *desttop;
     pixel_t *dest;
     byte *source;
+    pixel_t *screenend;
+    compiledpatch_t *compiled;
+    patchrun_t *run;
     int w;
 
     y -= SHORT(patch->topoffset);
@@ -175,6 +521,32 @@ void V_DrawPatch(int x, int y, patch_t *patch)
 
     w = SHORT(patch->width);
 
+    compiled = CachedPatch(patch);
+
+    if (compiled != NULL)
+    {
+        // Posts can reach below the height of the patch, and so off
+        // the bottom of the screen; the runs are in order from top to
+        // bottom, so stop at the first of those.
+
+        screenend = dest_screen + SCREENWIDTH * SCREENHEIGHT;
+        run = compiled->runs;
+
+        for (count = compiled->numruns; count > 0; --count, ++run)
+        {
+            dest = desttop + run->offset;
+
+            if (dest >= screenend)
+            {
+                break;
+            }
+
+            memcpy(dest, run->pixels, run->length * sizeof(pixel_t));
+        }
+
+        return;
+    }
+
     for ( ; col<w ; x++, col++, desttop++)
     {
         column = (column_t *)((byte *)patch + LONG(patch->columnofs[col]));
@@ -91,6 +91,18 @@ void V_RestoreBuffer(void);
 
 void V_ScreenShot(const char *format);
 
+// Save a screen buffer to a file, using the given palette.
+
+void WritePCXfile(char *filename, pixel_t *data,
+                  int width, int height,
+                  byte *palette);
+
+#ifdef HAVE_LIBPNG
+void WritePNGfile(char *filename, pixel_t *data,
+                  int width, int height,
+                  byte *palette);
+#endif
+
 // Load the lookup table for translucency calculations from the TINTTAB
 // lump.
 
@@ -91,3 +91,11 @@ size_t W_Read(wad_file_t *wad, unsigned int offset,
     return wad->file_class->Read(wad, offset, buffer, buffer_len);
 }
 
+void W_Prefetch(wad_file_t *wad, unsigned int offset, size_t len)
+{
+    if (wad->mapped != NULL && wad->file_class->Prefetch != NULL)
+    {
+        wad->file_class->Prefetch(wad, offset, len);
+    }
+}
+
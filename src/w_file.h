@@ -37,6 +37,12 @@ typedef struct
     // provided buffer.  Returns the number of bytes read.
     size_t (*Read)(wad_file_t *file, unsigned int offset,
                    void *buffer, size_t buffer_len);
+
+    // Bring the specified part of a memory-mapped file into memory
+    // ahead of use.  May be called from any thread.  NULL if the
+    // class does not support it.
+    void (*Prefetch)(wad_file_t *file, unsigned int offset,
+                     size_t len);
 } wad_file_class_t;
 
 struct _wad_file_s
@@ -71,4 +77,10 @@ void W_CloseFile(wad_file_t *wad);
 size_t W_Read(wad_file_t *wad, unsigned int offset,
               void *buffer, size_t buffer_len);
 
+// Bring part of a memory-mapped file into memory, so that it is
+// ready by the time it is used.  Does nothing if the file is not
+// mapped.  May be called from any thread.
+
+void W_Prefetch(wad_file_t *wad, unsigned int offset, size_t len);
+
 #endif /* #ifndef __W_FILE__ */
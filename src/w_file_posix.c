@@ -157,12 +157,46 @@ size_t W_POSIX_Read(wad_file_t *wad, unsigned int offset,
     return bytes_read;
 }
 
+// Ask the kernel to start reading the range in, then touch each page
+// so that it is resident by the time we return.
+
+static void W_POSIX_Prefetch(wad_file_t *wad, unsigned int offset,
+                             size_t len)
+{
+    volatile byte *page;
+    unsigned int start;
+    long pagesize;
+    byte *end;
+
+    if (len == 0)
+    {
+        return;
+    }
+
+    pagesize = sysconf(_SC_PAGESIZE);
+
+    if (pagesize <= 0)
+    {
+        pagesize = 4096;
+    }
+
+    start = offset - offset % pagesize;
+    madvise(wad->mapped + start, offset + len - start, MADV_WILLNEED);
+
+    end = wad->mapped + offset + len;
+
+    for (page = wad->mapped + start; page < end; page += pagesize)
+    {
+        (void) *page;
+    }
+}
 
 wad_file_class_t posix_wad_file = 
 {
     W_POSIX_OpenFile,
     W_POSIX_CloseFile,
     W_POSIX_Read,
+    W_POSIX_Prefetch,
 };
 
 
@@ -192,6 +192,7 @@ wad_file_class_t win32_wad_file =
     W_Win32_OpenFile,
     W_Win32_CloseFile,
     W_Win32_Read,
+    NULL,
 };
 
 
@@ -469,6 +469,77 @@ void W_ReleaseLumpName(const char *name)
     W_ReleaseLumpNum(W_GetNumForName(name));
 }
 
+//
+// W_LumpDataAt
+//
+// Returns true if the data of the given lump is in memory at the
+// given address, as returned by W_CacheLumpNum.  This stops being
+// true once the lump has been released and purged from the cache.
+//
+boolean W_LumpDataAt(lumpindex_t lumpnum, const void *data)
+{
+    lumpinfo_t *lump;
+
+    if ((unsigned)lumpnum >= numlumps)
+    {
+        return false;
+    }
+
+    lump = lumpinfo[lumpnum];
+
+    if (lump->wad_file->mapped != NULL)
+    {
+        return data == lump->wad_file->mapped + lump->position;
+    }
+    else
+    {
+        return data == lump->cache;
+    }
+}
+
+//
+// W_LumpNumForData
+//
+// Find the lump whose data is in memory at the given address, or
+// returns -1 if the address does not hold any lump.
+//
+lumpindex_t W_LumpNumForData(const void *data)
+{
+    lumpindex_t i;
+
+    for (i = numlumps - 1; i >= 0; --i)
+    {
+        if (W_LumpDataAt(i, data))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+//
+// W_PrefetchLump
+//
+// If the lump is in a memory-mapped file, make sure it is paged in,
+// so that the first use of it does not have to wait for the disk.
+// Unlike the rest of this file, this may be called from any thread.
+//
+
+void W_PrefetchLump(lumpindex_t lumpnum)
+{
+    lumpinfo_t *lump;
+
+    if ((unsigned)lumpnum >= numlumps)
+    {
+        return;
+    }
+
+    lump = lumpinfo[lumpnum];
+
+    W_Prefetch(lump->wad_file, lump->position, lump->size);
+}
+
 #if 0
 
 //
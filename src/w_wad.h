@@ -72,6 +72,11 @@ extern unsigned int W_LumpNameHash(const char *s);
 void W_ReleaseLumpNum(lumpindex_t lump);
 void W_ReleaseLumpName(const char *name);
 
+void W_PrefetchLump(lumpindex_t lump);
+
+boolean W_LumpDataAt(lumpindex_t lump, const void *data);
+lumpindex_t W_LumpNumForData(const void *data);
+
 const char *W_WadNameForLump(const lumpinfo_t *lump);
 boolean W_IsIWADLump(const lumpinfo_t *lump);
 
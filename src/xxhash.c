@@ -0,0 +1,229 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     XXH64, a fast non-cryptographic hash, written from Yann Collet's
+//     description of the algorithm. It gives the same values as the
+//     reference implementation.
+//
+
+#include <string.h>
+
+#include "xxhash.h"
+
+#define PRIME64_1 UINT64_C(0x9e3779b185ebca87)
+#define PRIME64_2 UINT64_C(0xc2b2ae3d27d4eb4f)
+#define PRIME64_3 UINT64_C(0x165667b19e3779f9)
+#define PRIME64_4 UINT64_C(0x85ebca77c2b2ae63)
+#define PRIME64_5 UINT64_C(0x27d4eb2f165667c5)
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+// Input is read as little-endian words.
+
+static uint64_t Read64(const byte *p)
+{
+    return (uint64_t) p[0]         | ((uint64_t) p[1] << 8)
+         | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24)
+         | ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40)
+         | ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+static uint32_t Read32(const byte *p)
+{
+    return (uint32_t) p[0]         | ((uint32_t) p[1] << 8)
+         | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint64_t Round(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = ROTL64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static uint64_t MergeRound(uint64_t acc, uint64_t val)
+{
+    acc ^= Round(0, val);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t XXH64(const void *data, size_t len, uint64_t seed)
+{
+    const byte *p = data;
+    const byte *end = p + len;
+    uint64_t v1, v2, v3, v4;
+    uint64_t h;
+
+    if (len >= 32)
+    {
+        v1 = seed + PRIME64_1 + PRIME64_2;
+        v2 = seed + PRIME64_2;
+        v3 = seed;
+        v4 = seed - PRIME64_1;
+
+        // Four independent lanes, so that the multiplies can overlap.
+
+        while (end - p >= 32)
+        {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        }
+
+        h = ROTL64(v1, 1) + ROTL64(v2, 7) + ROTL64(v3, 12) + ROTL64(v4, 18);
+        h = MergeRound(h, v1);
+        h = MergeRound(h, v2);
+        h = MergeRound(h, v3);
+        h = MergeRound(h, v4);
+    }
+    else
+    {
+        h = seed + PRIME64_5;
+    }
+
+    h += (uint64_t) len;
+
+    while (end - p >= 8)
+    {
+        h ^= Round(0, Read64(p));
+        h = ROTL64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+    }
+
+    if (end - p >= 4)
+    {
+        h ^= (uint64_t) Read32(p) * PRIME64_1;
+        h = ROTL64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+
+    while (p < end)
+    {
+        h ^= *p * PRIME64_5;
+        h = ROTL64(h, 11) * PRIME64_1;
+        ++p;
+    }
+
+    // Avalanche, so that every input bit affects every output bit.
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+#ifdef TEST
+
+// Test: checks XXH64 against values from the reference implementation,
+// then checks that changing any one bit of any of a sample of pixels
+// of a screen-sized buffer changes the hash, as -framehashes needs.
+
+#include <stdio.h>
+
+#define TEST_SIZE (320 * 200)
+
+static const struct
+{
+    const char *input;
+    uint64_t seed;
+    uint64_t hash;
+} known_hashes[] =
+{
+    { "",    0, UINT64_C(0xef46db3751d8e999) },
+    { "a",   0, UINT64_C(0xd24ec4f1a98c6e5b) },
+    { "abc", 0, UINT64_C(0x44bc2cf5ad770999) },
+};
+
+static byte buffer[TEST_SIZE];
+
+int main(int argc, char *argv[])
+{
+    unsigned int seed = 1;
+    uint64_t base, hash;
+    int failures = 0;
+    int i, pos, bit;
+
+    for (i = 0; i < arrlen(known_hashes); ++i)
+    {
+        hash = XXH64(known_hashes[i].input, strlen(known_hashes[i].input),
+                     known_hashes[i].seed);
+
+        if (hash != known_hashes[i].hash)
+        {
+            printf("XXH64(\"%s\") is %016llx, expected %016llx\n",
+                   known_hashes[i].input, (unsigned long long) hash,
+                   (unsigned long long) known_hashes[i].hash);
+            ++failures;
+        }
+    }
+
+    for (i = 0; i < TEST_SIZE; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        buffer[i] = seed >> 16;
+    }
+
+    base = XXH64(buffer, TEST_SIZE, 0);
+
+    // The first 64 pixels cover each position in each lane, then every
+    // 97th pixel after that the rest of the screen.
+
+    for (pos = 0; pos < TEST_SIZE; pos += pos < 64 ? 1 : 97)
+    {
+        for (bit = 0; bit < 8; ++bit)
+        {
+            buffer[pos] ^= 1 << bit;
+            hash = XXH64(buffer, TEST_SIZE, 0);
+            buffer[pos] ^= 1 << bit;
+
+            if (hash == base)
+            {
+                printf("Flipping bit %i of pixel %i doesn't change "
+                       "the hash\n", bit, pos);
+                ++failures;
+            }
+        }
+    }
+
+    // Two changes that cancelled out before.
+
+    buffer[7] ^= 0x80;
+    buffer[15] ^= 0x80;
+    hash = XXH64(buffer, TEST_SIZE, 0);
+    buffer[7] ^= 0x80;
+    buffer[15] ^= 0x80;
+
+    if (hash == base)
+    {
+        printf("Flipping bit 7 of pixels 7 and 15 doesn't change "
+               "the hash\n");
+        ++failures;
+    }
+
+    if (failures > 0)
+    {
+        printf("%i failures\n", failures);
+        return 1;
+    }
+
+    printf("All hashes OK\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,27 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     XXH64, a fast non-cryptographic hash.
+//
+
+#ifndef __XXHASH_H__
+#define __XXHASH_H__
+
+#include <stddef.h>
+
+#include "doomtype.h"
+
+uint64_t XXH64(const void *data, size_t len, uint64_t seed);
+
+#endif /* #ifndef __XXHASH_H__ */
@@ -45,6 +45,9 @@ struct memblock_s
  
 static memblock_t *allocated_blocks[PU_NUM_TAGS];
 
+static zone_purge_hook_t purge_hooks[MAX_PURGE_HOOKS];
+static int num_purge_hooks;
+
 #ifdef TESTING
 
 static int test_malloced = 0;
@@ -169,6 +172,7 @@ static boolean ClearCache(int size)
     memblock_t *block;
     memblock_t *next_block;
     int remaining;
+    int i;
 
     block = allocated_blocks[PU_CACHE];
 
@@ -190,6 +194,14 @@ static boolean ClearCache(int size)
 
     //printf("out of memory; cleaning out the cache: %i\n", test_malloced);
 
+    // Anyone still holding pointers into the cache gets a chance
+    // to finish with them first.
+
+    for (i = 0; i < num_purge_hooks; ++i)
+    {
+        purge_hooks[i]();
+    }
+
     // Search backwards through the list freeing blocks until we have
     // freed the amount of memory required.
 
@@ -479,6 +491,20 @@ void Z_ChangeUser(void *ptr, void **user)
     *user = ptr;
 }
 
+int Z_GetTag(void *ptr)
+{
+    memblock_t*	block;
+
+    block = (memblock_t *) ((byte *)ptr - sizeof(memblock_t));
+
+    if (block->id != ZONEID)
+    {
+        I_Error("Z_GetTag: Tried to get tag of invalid block!");
+    }
+
+    return block->tag;
+}
+
 
 //
 // Z_FreeMemory
@@ -496,3 +522,16 @@ unsigned int Z_ZoneSize(void)
     return 0;
 }
 
+// Hooks are called in the order they were added.
+
+void Z_AddPurgeHook(zone_purge_hook_t func)
+{
+    if (num_purge_hooks >= MAX_PURGE_HOOKS)
+    {
+        I_Error("Z_AddPurgeHook: Too many purge hooks");
+    }
+
+    purge_hooks[num_purge_hooks] = func;
+    ++num_purge_hooks;
+}
+
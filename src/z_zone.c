@@ -67,6 +67,8 @@ typedef struct
 static memzone_t *mainzone;
 static boolean zero_on_free;
 static boolean scan_on_free;
+static zone_purge_hook_t purge_hooks[MAX_PURGE_HOOKS];
+static int num_purge_hooks;
 
 
 //
@@ -238,6 +240,20 @@ void Z_Free (void* ptr)
 
 
 
+//
+// Z_CallPurgeHooks
+//
+static void Z_CallPurgeHooks(void)
+{
+    int i;
+
+    for (i = 0; i < num_purge_hooks; ++i)
+    {
+        purge_hooks[i]();
+    }
+}
+
+
 //
 // Z_Malloc
 // You can pass a NULL user if the tag is < PU_PURGELEVEL.
@@ -296,6 +312,11 @@ Z_Malloc
             }
             else
             {
+                // Anyone still holding pointers into purgable blocks
+                // gets a chance to finish with them first.
+
+                Z_CallPurgeHooks();
+
                 // free the rover block (adding the size to base)
 
                 // the rover can be the base block
@@ -522,6 +543,20 @@ void Z_ChangeUser(void *ptr, void **user)
     *user = ptr;
 }
 
+int Z_GetTag(void *ptr)
+{
+    memblock_t*	block;
+
+    block = (memblock_t *) ((byte *)ptr - sizeof(memblock_t));
+
+    if (block->id != ZONEID)
+    {
+        I_Error("Z_GetTag: Tried to get tag of invalid block!");
+    }
+
+    return block->tag;
+}
+
 
 
 //
@@ -550,3 +585,18 @@ unsigned int Z_ZoneSize(void)
     return mainzone->size;
 }
 
+//
+// Z_AddPurgeHook
+// Hooks are called in the order they were added.
+//
+void Z_AddPurgeHook(zone_purge_hook_t func)
+{
+    if (num_purge_hooks >= MAX_PURGE_HOOKS)
+    {
+        I_Error("Z_AddPurgeHook: Too many purge hooks");
+    }
+
+    purge_hooks[num_purge_hooks] = func;
+    ++num_purge_hooks;
+}
+
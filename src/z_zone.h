@@ -49,6 +49,14 @@ enum
     PU_NUM_TAGS
 };
         
+// Called just before a purgable block is thrown out to make room
+// for a new allocation.
+
+typedef void (*zone_purge_hook_t)(void);
+
+// Most purge hooks that can be added with Z_AddPurgeHook.
+
+#define MAX_PURGE_HOOKS 4
 
 void	Z_Init (void);
 void*	Z_Malloc (int size, int tag, void *ptr);
@@ -59,8 +67,10 @@ void    Z_FileDumpHeap (FILE *f);
 void    Z_CheckHeap (void);
 void    Z_ChangeTag2 (void *ptr, int tag, const char *file, int line);
 void    Z_ChangeUser(void *ptr, void **user);
+int     Z_GetTag(void *ptr);
 int     Z_FreeMemory (void);
 unsigned int Z_ZoneSize(void);
+void    Z_AddPurgeHook(zone_purge_hook_t func);
 
 //
 // This is used to get the local FILE:LINE info from CPP